@@ -96,7 +96,11 @@ void priv_ProfilesDialog__show_cb(AppDialogEvent * event){
 
     gtk_box_pack_start(GTK_BOX(elements->primary_pane), elements->content_pane,     TRUE, FALSE, 0);
 
-    EventQueue__insert(dialog->queue, dialog, _priv_ProfilesDialog__load_profiles,dialog);
+    QueueEvent * evt = QueueEvent__create(dialog, _priv_ProfilesDialog__load_profiles, dialog);
+    QueueEvent__set_name(evt, "load-profiles");
+    QueueEvent__set_priority(evt, EVENTQUEUE_PRIORITY_INTERACTIVE);
+    QueueEvent__set_pool(evt, dialog->pool);
+    EventQueue__insert_event(dialog->queue, evt);
 }
 
 void ProfilesDialog__set_device(ProfilesDialog * self, OnvifMgrDeviceRow * device){
@@ -107,13 +111,14 @@ OnvifMgrDeviceRow * ProfilesDialog__get_device(ProfilesDialog * self){
     return self->device;
 }
 
-ProfilesDialog * ProfilesDialog__create(EventQueue * queue, void (* clicked)  (ProfilesDialog * dialog, OnvifProfile * profile)){
+ProfilesDialog * ProfilesDialog__create(EventQueue * queue, int pool, void (* clicked)  (ProfilesDialog * dialog, OnvifProfile * profile)){
     ProfilesDialog * dialog = malloc(sizeof(ProfilesDialog));
     DialogElements * elements = malloc(sizeof(DialogElements));
     elements->content_pane = NULL;
 
     dialog->elements = elements;
     dialog->queue = queue;
+    dialog->pool = pool;
     dialog->device = NULL;
     dialog->profile_selected = clicked;
     C_TRACE("create");
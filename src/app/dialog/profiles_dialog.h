@@ -12,13 +12,14 @@ typedef struct _ProfilesDialog ProfilesDialog;
 typedef struct _ProfilesDialog {
     AppDialog parent;
     EventQueue * queue;
+    int pool; //Profiles are fetched from the camera on this worker pool
     OnvifMgrDeviceRow * device;
     void (*profile_selected)(ProfilesDialog * dialog, OnvifProfile * profile);
     void * user_data;
     void * elements;
 } ProfilesDialog;
 
-ProfilesDialog * ProfilesDialog__create(EventQueue * queue, void (* clicked)  (ProfilesDialog * dialog, OnvifProfile * profile));
+ProfilesDialog * ProfilesDialog__create(EventQueue * queue, int pool, void (* clicked)  (ProfilesDialog * dialog, OnvifProfile * profile));
 void ProfilesDialog__set_device(ProfilesDialog * self, OnvifMgrDeviceRow * device);
 OnvifMgrDeviceRow * ProfilesDialog__get_device(ProfilesDialog * self);
 
@@ -2,16 +2,27 @@
 #include "gui_utils.h"
 #include "clogger.h"
 
-typedef struct {
-    GtkWidget * image;
-    GtkWidget * handle;
-} ImageGUIUpdate;
+typedef enum {
+    GUI_UPDATE_IMAGE,
+    GUI_UPDATE_LABEL,
+    GUI_UPDATE_SPINNER
+} GUIUpdateType;
 
-typedef struct {
-    GtkWidget * label;
+//Update pushed by any thread and applied on the main thread by the next batch
+typedef struct _GUIUpdate {
+    struct _GUIUpdate * next;
+    GUIUpdateType type;
+    GtkWidget * widget; //Updates of the same type on the same widget collapse into the latest one
+    GtkWidget * image;
     char * text;
-} GUILabelUpdate;
+} GUIUpdate;
 
+//Lock-free stack of pending updates, newest first. Workers push, only the main thread takes the whole list.
+static GUIUpdate * gui_batch_head = NULL;
+//Set by the first update following a drain, which is the only one scheduling an idle
+static gint gui_batch_scheduled = 0;
+static GdkFrameClock * gui_batch_clock = NULL;
+static gulong gui_batch_handler = 0;
 
 void gui_widget_destroy(GtkWidget * widget, gpointer user_data){
     gtk_widget_destroy(widget);
@@ -21,51 +32,185 @@ void gui_container_remove(GtkWidget * widget, gpointer user_data){
     gtk_container_remove(GTK_CONTAINER(user_data),widget);
 }
 
-gboolean * gui_update_widget_image_priv(void * user_data){
-    ImageGUIUpdate * iguiu = (ImageGUIUpdate *) user_data;
-
-    if(GTK_IS_WIDGET(iguiu->handle)){
-        gtk_container_foreach (GTK_CONTAINER (iguiu->handle), (GtkCallback)gui_widget_destroy, NULL);
-        if(GTK_IS_WIDGET(iguiu->image)){
-            gtk_container_add (GTK_CONTAINER (iguiu->handle), iguiu->image);
-            gtk_widget_show (iguiu->image);
-            if(GTK_IS_SPINNER(iguiu->image)){
-                gtk_spinner_start (GTK_SPINNER (iguiu->image));
+void gui_update_widget_image_priv(GtkWidget * image, GtkWidget * handle){
+    if(GTK_IS_WIDGET(handle)){
+        gtk_container_foreach (GTK_CONTAINER (handle), (GtkCallback)gui_widget_destroy, NULL);
+        if(GTK_IS_WIDGET(image)){
+            gtk_container_add (GTK_CONTAINER (handle), image);
+            gtk_widget_show (image);
+            if(GTK_IS_SPINNER(image)){
+                gtk_spinner_start (GTK_SPINNER (image));
             }
         }
     } else {
         C_WARN("gui_update_widget_image_priv - invalid handle");
     }
+}
 
-    free(iguiu);
-    return FALSE;
+void gui_batch_free(GUIUpdate * update){
+    free(update->text);
+    free(update);
 }
 
-void gui_update_widget_image(GtkWidget * image, GtkWidget * handle){
-    if(!G_IS_OBJECT(image) || !G_IS_OBJECT(handle)) return;
-    ImageGUIUpdate * iguiu = malloc(sizeof(ImageGUIUpdate));
-    iguiu->image = image;
-    iguiu->handle = handle;
-    gdk_threads_add_idle(G_SOURCE_FUNC(gui_update_widget_image_priv),iguiu);
+//Releases an update replaced by a newer one. Its image was never added, unless the same one is still pending.
+void gui_batch_discard(GUIUpdate * update, GUIUpdate * latest){
+    if(update->type == GUI_UPDATE_IMAGE && update->image != latest->image 
+        && G_IS_OBJECT(update->image) && g_object_is_floating(update->image)){
+        g_object_ref_sink(update->image);
+        g_object_unref(update->image);
+    }
+    gui_batch_free(update);
+}
+
+void gui_batch_apply(GUIUpdate * update){
+    switch(update->type){
+        case GUI_UPDATE_IMAGE:
+            gui_update_widget_image_priv(update->image, update->widget);
+            break;
+        case GUI_UPDATE_LABEL:
+            if(GTK_IS_LABEL(update->widget)){
+                gtk_label_set_text(GTK_LABEL(update->widget),update->text);
+            }
+            break;
+        case GUI_UPDATE_SPINNER:
+            if(GTK_IS_SPINNER(update->widget)){
+                gtk_spinner_start (GTK_SPINNER (update->widget));
+            }
+            break;
+    }
 }
 
-gboolean * gui_set_label_text_priv (void * user_data){
-    GUILabelUpdate * update = (GUILabelUpdate *) user_data;
-    gtk_label_set_text(GTK_LABEL(update->label),update->text);
+void gui_batch_drain(){
+    GUIUpdate * head;
+    GUIUpdate * update;
+    GUIUpdate * latest;
+    GUIUpdate * ordered = NULL;
+    GHashTable * kept;
+    int count = 0;
+    int applied = 0;
 
-    free(update->text);
-    free(update);
+    //Cleared before taking the list, so an update pushed meanwhile schedules the next drain
+    g_atomic_int_set(&gui_batch_scheduled, 0);
+    do {
+        head = g_atomic_pointer_get(&gui_batch_head);
+    } while(head && !g_atomic_pointer_compare_and_exchange(&gui_batch_head, head, NULL));
+
+    if(!head){
+        return;
+    }
+
+    //Walking newest first, the first update seen for a widget and type is the one kept.
+    //Widgets are at least 4 bytes aligned, so adding the type to the address gives a distinct key per type.
+    kept = g_hash_table_new(g_direct_hash, g_direct_equal);
+    while(head){
+        update = head;
+        head = head->next;
+        count++;
+
+        gpointer key = (char *) update->widget + update->type;
+        latest = g_hash_table_lookup(kept, key);
+        if(latest){
+            gui_batch_discard(update, latest);
+            continue;
+        }
+        g_hash_table_insert(kept, key, update);
+        //Prepending restores the order updates were pushed in
+        update->next = ordered;
+        ordered = update;
+    }
+    g_hash_table_destroy(kept);
+
+    while(ordered){
+        update = ordered;
+        ordered = ordered->next;
+        gui_batch_apply(update);
+        gui_batch_free(update);
+        applied++;
+    }
 
+    C_TRACE("gui_batch_drain - applied %d of %d updates", applied, count);
+}
+
+void gui_batch_frame_update_cb(GdkFrameClock * clock, gpointer user_data){
+    gui_batch_drain();
+}
+
+gboolean * gui_batch_request (void * user_data){
+    if(gui_batch_clock){
+        //Applied during the next frame, along with whatever else got pushed until then
+        gdk_frame_clock_request_phase(gui_batch_clock, GDK_FRAME_CLOCK_PHASE_UPDATE);
+    } else {
+        gui_batch_drain();
+    }
     return FALSE;
 }
 
+void gui_batch_push(GUIUpdate * update){
+    GUIUpdate * head;
+    do {
+        head = g_atomic_pointer_get(&gui_batch_head);
+        update->next = head;
+    } while(!g_atomic_pointer_compare_and_exchange(&gui_batch_head, head, update));
+
+    if(g_atomic_int_compare_and_exchange(&gui_batch_scheduled, 0, 1)){
+        gdk_threads_add_idle(G_SOURCE_FUNC(gui_batch_request),NULL);
+    }
+}
+
+GUIUpdate * gui_batch_new(GUIUpdateType type, GtkWidget * widget){
+    GUIUpdate * update = malloc(sizeof(GUIUpdate));
+    update->next = NULL;
+    update->type = type;
+    update->widget = widget;
+    update->image = NULL;
+    update->text = NULL;
+    return update;
+}
+
+void gui_batch_unrealize_cb(GtkWidget * widget, gpointer user_data){
+    gui_batch_detach();
+}
+
+void gui_batch_attach(GtkWidget * toplevel){
+    GdkFrameClock * clock = gtk_widget_get_frame_clock(toplevel);
+    if(!clock){
+        C_WARN("gui_batch_attach - widget isn't realized, updates are applied from idle callbacks");
+        return;
+    }
+
+    gui_batch_detach();
+    gui_batch_clock = g_object_ref(clock);
+    gui_batch_handler = g_signal_connect (clock, "update", G_CALLBACK (gui_batch_frame_update_cb), NULL);
+    g_signal_connect (toplevel, "unrealize", G_CALLBACK (gui_batch_unrealize_cb), NULL);
+}
+
+void gui_batch_detach(){
+    if(!gui_batch_clock){
+        return;
+    }
+
+    g_signal_handler_disconnect(gui_batch_clock, gui_batch_handler);
+    g_object_unref(gui_batch_clock);
+    gui_batch_clock = NULL;
+    gui_batch_handler = 0;
+    //A frame may have been requested from the detached clock, pending updates are handed to an idle instead
+    g_atomic_int_set(&gui_batch_scheduled, 1);
+    gdk_threads_add_idle(G_SOURCE_FUNC(gui_batch_request),NULL);
+}
+
+void gui_update_widget_image(GtkWidget * image, GtkWidget * handle){
+    if(!G_IS_OBJECT(image) || !G_IS_OBJECT(handle)) return;
+    GUIUpdate * update = gui_batch_new(GUI_UPDATE_IMAGE, handle);
+    update->image = image;
+    gui_batch_push(update);
+}
+
 void gui_set_label_text (GtkWidget * widget, char * value){
-    if(!G_IS_OBJECT(widget) || !G_IS_OBJECT(widget)) return;
-    GUILabelUpdate * iguiu = malloc(sizeof(GUILabelUpdate));
-    iguiu->text = malloc(strlen(value)+1);
-    strcpy(iguiu->text,value);
-    iguiu->label = widget;
-    gdk_threads_add_idle(G_SOURCE_FUNC(gui_set_label_text_priv),iguiu);
+    if(!G_IS_OBJECT(widget)) return;
+    GUIUpdate * update = gui_batch_new(GUI_UPDATE_LABEL, widget);
+    update->text = malloc(strlen(value)+1);
+    strcpy(update->text,value);
+    gui_batch_push(update);
 }
 
 gboolean * gui_widget_destroy_cb (void * user_data){
@@ -80,15 +225,8 @@ void safely_destroy_widget(GtkWidget * widget){
     gdk_threads_add_idle(G_SOURCE_FUNC(gui_widget_destroy_cb),widget);
 }
 
-void idle_start_spinner(void * user_data){
-    GtkWidget * widget = (GtkWidget *) user_data;
-    if(GTK_IS_SPINNER(widget)){
-        gtk_spinner_start (GTK_SPINNER (widget));
-    }
-}
-
 void safely_start_spinner(GtkWidget * widget){
-    gdk_threads_add_idle(G_SOURCE_FUNC(idle_start_spinner),widget);
+    gui_batch_push(gui_batch_new(GUI_UPDATE_SPINNER, widget));
 }
 
 GtkCssProvider * gui_widget_set_css(GtkWidget * widget, char * css, GtkCssProvider * cssProvider){
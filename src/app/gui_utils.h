@@ -7,6 +7,11 @@
 
 void gui_widget_destroy(GtkWidget * widget, gpointer user_data);
 void gui_container_remove(GtkWidget * widget, gpointer user_data);
+//Image, label and spinner updates can be called from any thread. They are batched and applied on the main thread
+//once per frame of the attached toplevel, only the latest update of a given widget is applied.
+void gui_batch_attach(GtkWidget * toplevel);
+//Updates are applied from idle callbacks until a toplevel is attached again
+void gui_batch_detach();
 void gui_update_widget_image(GtkWidget * image, GtkWidget * handle);
 void gui_set_label_text (GtkWidget * widget, char * value);
 GtkWidget * add_label_entry(GtkWidget * grid, int row, char* lbl);
@@ -18,6 +18,13 @@ extern char _binary_save_png_size[];
 extern char _binary_save_png_start[];
 extern char _binary_save_png_end[];
 
+//Stream size of a profile, learned once it played
+typedef struct {
+    OnvifProfile * profile;
+    int width;
+    int height;
+} OnvifMgrProfileInfo;
+
 enum {
   PROFILE_CLICKED,
   PROFILE_CHANGED,
@@ -28,6 +35,9 @@ typedef struct {
     OnvifApp * app;
     OnvifDevice * device;
     OnvifProfile * profile;
+    OnvifMgrProfileInfo * profiles;
+    int profile_count;
+    gboolean profile_locked;
 
     gboolean owned;
     gboolean init;
@@ -211,6 +221,9 @@ OnvifMgrDeviceRow__init (OnvifMgrDeviceRow * self)
     OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
     priv->device = NULL;  
     priv->profile = NULL;
+    priv->profiles = NULL;
+    priv->profile_count = 0;
+    priv->profile_locked = FALSE;
     priv->owned = TRUE;
     
     g_signal_connect (self, "notify::parent", G_CALLBACK (OnvifMgrDeviceRow_change_parent), NULL);
@@ -238,10 +251,16 @@ OnvifMgrDeviceRow__destroy (GtkWidget *object)
     OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (ONVIFMGR_DEVICEROW(object));
     OnvifDevice__destroy(priv->device);
     OnvifProfile__destroy(priv->profile);
+    for(int i=0;i<priv->profile_count;i++){
+        OnvifProfile__destroy(priv->profiles[i].profile);
+    }
+    free(priv->profiles);
 
     //GTK may call destroy multiple times. Setting pointer to null to avoid segmentation fault
     priv->device = NULL;
     priv->profile = NULL;
+    priv->profiles = NULL;
+    priv->profile_count = 0;
 
     if (GTK_WIDGET_CLASS (OnvifMgrDeviceRow__parent_class)->destroy)
         (* GTK_WIDGET_CLASS (OnvifMgrDeviceRow__parent_class)->destroy) (object);
@@ -355,6 +374,13 @@ void OnvifMgrDeviceRow__set_name(OnvifMgrDeviceRow * self, char * name){
     }
 }
 
+const char * OnvifMgrDeviceRow__get_name(OnvifMgrDeviceRow * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self),NULL);
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    return gtk_label_get_text(GTK_LABEL(priv->lbl_name));
+}
+
 void OnvifMgrDeviceRow__set_hardware(OnvifMgrDeviceRow * self, char * hardware){
     g_return_if_fail (self != NULL);
     g_return_if_fail (ONVIFMGR_IS_DEVICEROW (self));
@@ -409,6 +435,80 @@ OnvifProfile * OnvifMgrDeviceRow__get_profile(OnvifMgrDeviceRow * self){
     return priv->profile;
 }
 
+void OnvifMgrDeviceRow__set_profiles(OnvifMgrDeviceRow * self, OnvifProfiles * profiles){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (ONVIFMGR_IS_DEVICEROW (self));
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+
+    //Only fetched once per device, sizes learned so far stay valid
+    if(priv->profiles || !profiles){
+        return;
+    }
+
+    int count = OnvifProfiles__get_size(profiles);
+    priv->profiles = malloc(sizeof(OnvifMgrProfileInfo) * (count > 0 ? count : 1));
+    for(int i=0;i<count;i++){
+        priv->profiles[i].profile = OnvifProfile__copy(OnvifProfiles__get_profile(profiles,i));
+        priv->profiles[i].width = 0;
+        priv->profiles[i].height = 0;
+    }
+    priv->profile_count = count;
+}
+
+int OnvifMgrDeviceRow__get_profile_count(OnvifMgrDeviceRow * self){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self),0);
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    return priv->profile_count;
+}
+
+OnvifProfile * OnvifMgrDeviceRow__get_profile_at(OnvifMgrDeviceRow * self, int index){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self),NULL);
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    if(index < 0 || index >= priv->profile_count){
+        return NULL;
+    }
+    return priv->profiles[index].profile;
+}
+
+void OnvifMgrDeviceRow__set_profile_size(OnvifMgrDeviceRow * self, int index, int width, int height){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (ONVIFMGR_IS_DEVICEROW (self));
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    if(index < 0 || index >= priv->profile_count){
+        return;
+    }
+    priv->profiles[index].width = width;
+    priv->profiles[index].height = height;
+}
+
+gboolean OnvifMgrDeviceRow__get_profile_size(OnvifMgrDeviceRow * self, int index, int * width, int * height){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self),FALSE);
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    if(index < 0 || index >= priv->profile_count || priv->profiles[index].width <= 0){
+        return FALSE;
+    }
+    *width = priv->profiles[index].width;
+    *height = priv->profiles[index].height;
+    return TRUE;
+}
+
+void OnvifMgrDeviceRow__set_profile_locked(OnvifMgrDeviceRow * self, gboolean locked){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (ONVIFMGR_IS_DEVICEROW (self));
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    priv->profile_locked = locked;
+}
+
+gboolean OnvifMgrDeviceRow__is_profile_locked(OnvifMgrDeviceRow * self){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self),FALSE);
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    return priv->profile_locked;
+}
+
 gboolean OnvifMgrDeviceRow__is_selected(OnvifMgrDeviceRow * self){
     g_return_val_if_fail (self != NULL, FALSE);
     g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self),FALSE);
@@ -416,28 +516,51 @@ gboolean OnvifMgrDeviceRow__is_selected(OnvifMgrDeviceRow * self){
 }
 
 void OnvifMgrDeviceRow__load_thumbnail(OnvifMgrDeviceRow * self){
-    g_return_if_fail (self != NULL);
-    g_return_if_fail (ONVIFMGR_IS_DEVICEROW (self));
-    C_TRACE("OnvifMgrDeviceRow__load_thumbnail");
-    GtkWidget *image = NULL;
-    GError * error = NULL;
+    OnvifMgrDeviceRow__show_snapshot(self,OnvifMgrDeviceRow__fetch_snapshot(self));
+}
+
+OnvifSnapshot * OnvifMgrDeviceRow__fetch_snapshot(OnvifMgrDeviceRow * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (ONVIFMGR_IS_DEVICEROW (self), NULL);
+    C_TRACE("OnvifMgrDeviceRow__fetch_snapshot");
     OnvifSnapshot * snapshot = NULL;
 
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(self)){
-        C_TRAIL("OnvifMgrDeviceRow__load_thumbnail - invalid device");
-        return;
+        C_TRAIL("OnvifMgrDeviceRow__fetch_snapshot - invalid device");
+        return NULL;
     }
-    
-    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
 
-    OnvifErrorTypes oerror = OnvifDevice__get_last_error(priv->device);
-    if(oerror == ONVIF_ERROR_NONE){
+    //Called from a queue task, don't start the download once it is cancelled
+    if(QueueEvent__is_cancelled(QueueEvent__get_current())){
+        C_TRAIL("OnvifMgrDeviceRow__fetch_snapshot - cancelled");
+        return NULL;
+    }
+
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+    if(OnvifDevice__get_last_error(priv->device) == ONVIF_ERROR_NONE){
         OnvifMediaService * media_service = OnvifDevice__get_media_service(priv->device);
         snapshot = OnvifMediaService__getSnapshot(media_service,OnvifProfile__get_index(priv->profile));
         if(!snapshot){
-            C_ERROR("_priv_Device__load_thumbnail- Error retrieve snapshot.");
-            goto warning;
+            C_ERROR("OnvifMgrDeviceRow__fetch_snapshot - Error retrieve snapshot.");
         }
+    }
+    return snapshot;
+}
+
+void OnvifMgrDeviceRow__show_snapshot(OnvifMgrDeviceRow * self, OnvifSnapshot * snapshot){
+    GtkWidget *image = NULL;
+    GError * error = NULL;
+
+    if(!ONVIFMGR_IS_DEVICEROW (self) || !ONVIFMGR_DEVICEROWROW_HAS_OWNER(self)){
+        C_TRAIL("OnvifMgrDeviceRow__show_snapshot - invalid device");
+        goto exit;
+    }
+    C_TRACE("OnvifMgrDeviceRow__show_snapshot");
+
+    OnvifMgrDeviceRowPrivate *priv = OnvifMgrDeviceRow__get_instance_private (self);
+
+    OnvifErrorTypes oerror = OnvifDevice__get_last_error(priv->device);
+    if(snapshot){
         image = GtkBinaryImage__new((unsigned char *)OnvifSnapshot__get_buffer(snapshot),OnvifSnapshot__get_size(snapshot), -1, 40, error);
     } else if(oerror == ONVIF_ERROR_NOT_AUTHORIZED){
         image = GtkStyledImage__new((unsigned char *)_binary_locked_icon_png_start,_binary_locked_icon_png_end - _binary_locked_icon_png_start, 40, 40, error);
@@ -447,7 +570,7 @@ void OnvifMgrDeviceRow__load_thumbnail(OnvifMgrDeviceRow * self){
 
     //Check is device is still valid. (User performed scan before snapshot finished)
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(self)){
-        C_TRAIL("OnvifMgrDeviceRow__load_thumbnail - invalid device");
+        C_TRAIL("OnvifMgrDeviceRow__show_snapshot - invalid device");
         goto exit;
     }
 
@@ -467,7 +590,7 @@ void OnvifMgrDeviceRow__load_thumbnail(OnvifMgrDeviceRow * self){
 warning:
     //Check is device is still valid. (User performed scan before snapshot finished)
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(self)){
-        C_TRAIL("OnvifMgrDeviceRow__load_thumbnail - invalid device");
+        C_TRAIL("OnvifMgrDeviceRow__show_snapshot - invalid device");
         goto exit;
     }
 
@@ -492,13 +615,13 @@ warning:
     if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(self)){
         gui_update_widget_image(image,priv->image_handle);
     } else {
-        C_TRAIL("OnvifMgrDeviceRow__load_thumbnail - invalid device");
+        C_TRAIL("OnvifMgrDeviceRow__show_snapshot - invalid device");
     }
 
 exit:
     OnvifSnapshot__destroy(snapshot);
 
-    C_TRACE("OnvifMgrDeviceRow__load_thumbnail done.");
+    C_TRACE("OnvifMgrDeviceRow__show_snapshot done.");
 } 
 
 void OnvifMgrDeviceRow__set_thumbnail(OnvifMgrDeviceRow * self, GtkWidget * image){
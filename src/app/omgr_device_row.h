@@ -40,13 +40,28 @@ OnvifApp * OnvifMgrDeviceRow__get_app(OnvifMgrDeviceRow * self);
 void OnvifMgrDeviceRow__set_device(OnvifMgrDeviceRow * self, OnvifDevice * device);
 OnvifDevice * OnvifMgrDeviceRow__get_device(OnvifMgrDeviceRow * self);
 void OnvifMgrDeviceRow__set_name(OnvifMgrDeviceRow * self, char * name);
+const char * OnvifMgrDeviceRow__get_name(OnvifMgrDeviceRow * self);
 void OnvifMgrDeviceRow__set_hardware(OnvifMgrDeviceRow * self, char * hardware);
 void OnvifMgrDeviceRow__set_location(OnvifMgrDeviceRow * self, char * location);
 void OnvifMgrDeviceRow__set_profile(OnvifMgrDeviceRow * self, OnvifProfile * profile);
 OnvifProfile * OnvifMgrDeviceRow__get_profile(OnvifMgrDeviceRow * self);
+//Keeps a copy of the device's profiles, used for automatic profile selection
+void OnvifMgrDeviceRow__set_profiles(OnvifMgrDeviceRow * self, OnvifProfiles * profiles);
+int OnvifMgrDeviceRow__get_profile_count(OnvifMgrDeviceRow * self);
+OnvifProfile * OnvifMgrDeviceRow__get_profile_at(OnvifMgrDeviceRow * self, int index);
+//The media service doesn't expose the encoder resolution, it is recorded from the decoded stream
+void OnvifMgrDeviceRow__set_profile_size(OnvifMgrDeviceRow * self, int index, int width, int height);
+gboolean OnvifMgrDeviceRow__get_profile_size(OnvifMgrDeviceRow * self, int index, int * width, int * height);
+//A profile picked by hand isn't changed by the automatic selection
+void OnvifMgrDeviceRow__set_profile_locked(OnvifMgrDeviceRow * self, gboolean locked);
+gboolean OnvifMgrDeviceRow__is_profile_locked(OnvifMgrDeviceRow * self);
 gboolean OnvifMgrDeviceRow__is_selected(OnvifMgrDeviceRow * self);
 
 void OnvifMgrDeviceRow__load_thumbnail(OnvifMgrDeviceRow * self);
+//Network half of load_thumbnail. Returns NULL if the device isn't reachable or authorized.
+OnvifSnapshot * OnvifMgrDeviceRow__fetch_snapshot(OnvifMgrDeviceRow * self);
+//Decodes and displays the snapshot, or the locked/warning icon if NULL. Takes ownership of the snapshot.
+void OnvifMgrDeviceRow__show_snapshot(OnvifMgrDeviceRow * self, OnvifSnapshot * snapshot);
 void OnvifMgrDeviceRow__set_thumbnail(OnvifMgrDeviceRow * self, GtkWidget * image);
 void OnvifMgrDeviceRow__set_initialized(OnvifMgrDeviceRow * self);
 gboolean OnvifMgrDeviceRow__is_initialized(OnvifMgrDeviceRow * self);
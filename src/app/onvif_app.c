@@ -5,6 +5,10 @@
 #include "dialog/profiles_dialog.h"
 #include "onvif_details.h"
 #include "onvif_nvt.h"
+#include "onvif_grid.h"
+#include "onvif_prefetch.h"
+#include "onvif_autoprofile.h"
+#include "onvif_stream_monitor.h"
 #include "settings/app_settings.h"
 #include "task_manager.h"
 #include "clogger.h"
@@ -12,6 +16,29 @@
 #include "gtkstyledimage.h"
 #include "discoverer.h"
 #include "onvif_app_shutdown.h"
+#include "queue_source.h"
+
+//Stream retries back off from 2s up to 32s
+#define ONVIFAPP_RETRY_DELAY_MS 2000
+#define ONVIFAPP_RETRY_MAX_SHIFT 4
+//Time given to running tasks to finish on exit before they are reported
+#define ONVIFAPP_SHUTDOWN_TIMEOUT_MS 3000
+//Set to a number of seconds to periodically log the queue wait and run time statistics (collected for the task manager)
+#define ONVIFAPP_QUEUE_STATS_ENV "ONVIFMGR_QUEUE_STATS"
+//Stream pipelines are reset and reused on stop. Set to 0 to rebuild them every time instead (e.g. a decoder misbehaving on reuse).
+#define ONVIFAPP_PIPELINE_RECYCLE_ENV "ONVIFMGR_PIPELINE_RECYCLE"
+//Workers blocked on camera requests. Kept apart from the default pool so slow cameras don't hold up decoding and UI work.
+#define ONVIFAPP_NETWORK_POOL_MIN 2
+#define ONVIFAPP_NETWORK_POOL_MAX 8
+//Discovery blocks for the whole scan timeout, a single dedicated worker is enough
+#define ONVIFAPP_DISCOVERY_POOL_SIZE 1
+//Camera requests running longer than this are cancelled and their worker replaced by the queue watchdog
+#define ONVIFAPP_NETWORK_DEADLINE_MS 20000
+#define ONVIFAPP_WATCHDOG_INTERVAL_MS 1000
+//Bounds on queued work, so a flapping camera or repeated scans can't grow the queue without limit.
+//Excess events are rejected, their cleanup releases what they hold.
+#define ONVIFAPP_QUEUE_CAPACITY 4096
+#define ONVIFAPP_SCOPE_CAPACITY 32
 
 extern char _binary_tower_png_size[];
 extern char _binary_tower_png_start[];
@@ -43,9 +70,36 @@ typedef struct {
     TaskMgr * taskmgr;
 
     EventQueue * queue;
+    int network_pool;
+    int discovery_pool;
+    GSource * completion_source; //Runs task continuations on the main thread
     GstRtspPlayer * player;
+    int retry_count; //Consecutive stream retries, used for backoff
+    OnvifGrid * grid; //Multi camera view, each tile with its own player
+    OnvifPrefetch * prefetch; //Standby sessions of the devices likely to be selected next
+    OnvifAutoProfile * autoprofile;
+    OnvifStreamMonitor * monitor; //Steps the selected device down on sustained loss or decoder lag
+    GtkWidget * nvt;
 } OnvifAppPrivate;
 
+//Stream tasks are bound to the player displayed when they were queued, a prefetched one may be swapped in meanwhile
+typedef struct {
+    OnvifMgrDeviceRow * device;
+    GstRtspPlayer * player;
+} StreamTask;
+
+typedef struct {
+    OnvifMgrDeviceRow * device;
+    OnvifSnapshot * snapshot;
+} ThumbnailDecode;
+
+typedef struct {
+    OnvifApp * app;
+    void * scope;
+    const char * name;
+    long long running_ms;
+} HungTaskReport;
+
 static guint signals[LAST_SIGNAL] = { 0 };
 
 static void OnvifApp__ownable_interface_init (COwnableObjectInterface *iface);
@@ -59,10 +113,48 @@ void OnvifApp__cred_dialog_cancel_cb(AppDialogEvent * event);
 static gboolean * OnvifApp__discovery_finished_cb (OnvifApp * self);
 static gboolean * OnvifApp__disocvery_found_server_cb (DiscoveryEvent * event);
 static int OnvifApp__device_already_exist(OnvifApp * app, char * xaddr);
-static void OnvifApp__add_device(OnvifApp * app, OnvifMgrDeviceRow * omgr_device);
+static void OnvifApp__add_devices(OnvifApp * app, OnvifMgrDeviceRow ** devices, int count);
 static void OnvifApp__select_device(OnvifApp * app,  GtkListBoxRow * row);
 static int OnvifApp__reload_device(OnvifMgrDeviceRow * device);
 static void OnvifApp__display_device(OnvifApp * self, OnvifMgrDeviceRow * device);
+static QueueEvent * OnvifApp__create_display_event(OnvifApp * self, OnvifMgrDeviceRow * device);
+
+//cleanup is invoked with user_data if the event is cancelled before being dispatched, or rejected by a full queue
+//name is only used to label the queue statistics
+static QueueEvent * OnvifApp__prepare_record(QueueEvent * evt, int pool, EventQueuePriority priority, gboolean strand, const char * name, void (*cleanup)(void * user_data)){
+    QueueEvent__set_name(evt, name);
+    QueueEvent__set_pool(evt, pool);
+    QueueEvent__set_priority(evt, priority);
+    QueueEvent__set_strand(evt, strand);
+    QueueEvent__set_cleanup_callback(evt, cleanup);
+    return evt;
+}
+
+static EventQueueInsertResult OnvifApp__queue_record(EventQueue * queue, QueueEvent * evt, int pool, EventQueuePriority priority, gboolean strand, const char * name, void (*cleanup)(void * user_data)){
+    return EventQueue__insert_event(queue, OnvifApp__prepare_record(evt, pool, priority, strand, name, cleanup));
+}
+
+static EventQueueInsertResult OnvifApp__queue_event(EventQueue * queue, int pool, EventQueuePriority priority, gboolean strand, void * scope, const char * name, void (*callback)(void * user_data), void * user_data, void (*cleanup)(void * user_data)){
+    return OnvifApp__queue_record(queue, QueueEvent__create(scope, callback, user_data), pool, priority, strand, name, cleanup);
+}
+
+//Written on the main thread only, when a prefetched player is swapped in
+static GstRtspPlayer * OnvifApp__get_player(OnvifAppPrivate * priv){
+    return g_atomic_pointer_get(&priv->player);
+}
+
+void _stream_task_cleanup(void * user_data){
+    StreamTask * task = (StreamTask *) user_data;
+    g_object_unref(task->device);
+    g_object_unref(task->player);
+}
+
+static QueueEvent * OnvifApp__create_stream_event(OnvifMgrDeviceRow * device, GstRtspPlayer * player, void (*callback)(void * user_data)){
+    StreamTask task;
+    task.device = g_object_ref(device);
+    task.player = g_object_ref(player);
+    return QueueEvent__create_copy(device, callback, &task, sizeof(StreamTask));
+}
 
 gboolean * idle_select_device(void * user_data){
     OnvifMgrDeviceRow * device = ONVIFMGR_DEVICEROW(user_data);
@@ -95,25 +187,22 @@ gboolean * idle_hide_dialog_loading (void * user_data){
 
 gboolean * idle_add_device(void * user_data){
     OnvifMgrDeviceRow * dev = ONVIFMGR_DEVICEROW(user_data);
-    OnvifApp__add_device(OnvifMgrDeviceRow__get_app(dev),dev);
+    OnvifApp__add_devices(OnvifMgrDeviceRow__get_app(dev),&dev,1);
     return FALSE;
 }
 
 void _player_retry_stream(void * user_data){
     C_TRACE("_player_retry_stream");
-    OnvifMgrDeviceRow * device = ONVIFMGR_DEVICEROW(user_data);
-    OnvifApp * self = OnvifMgrDeviceRow__get_app(device);
-    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    StreamTask * task = (StreamTask *) user_data;
 
-    //Check if the device is valid and selected
-    if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) && OnvifMgrDeviceRow__is_selected(device)){
-        sleep(2);//Wait to avoid spamming the camera
-        //Check again if the device is valid and selected after waiting
-        if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) && OnvifMgrDeviceRow__is_selected(device)){
-            GstRtspPlayer__retry(priv->player);
+    //Check if the device is still valid and displayed by this player after the backoff delay
+    if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(task->device) && OnvifMgrDeviceRow__is_selected(task->device)){
+        OnvifAppPrivate *priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(task->device));
+        if(task->player == OnvifApp__get_player(priv)){
+            GstRtspPlayer__retry(task->player);
         }
     }
-    g_object_unref(device);
+    _stream_task_cleanup(task);
 }
 
 void _dicovery_found_server_cb (DiscoveryEvent * event) {
@@ -142,9 +231,24 @@ void _start_onvif_discovery(void * user_data){
     gdk_threads_add_idle(G_SOURCE_FUNC(OnvifApp__discovery_finished_cb),self);
 }
 
+void _decode_thumbnail(void * user_data){
+    C_TRACE("_decode_thumbnail");
+    ThumbnailDecode * input = (ThumbnailDecode *) user_data;
+    OnvifMgrDeviceRow__show_snapshot(input->device,input->snapshot);
+    g_object_unref(input->device);
+}
+
+void _decode_thumbnail_cleanup(void * user_data){
+    ThumbnailDecode * input = (ThumbnailDecode *) user_data;
+    OnvifSnapshot__destroy(input->snapshot);
+    g_object_unref(input->device);
+}
+
 void _display_onvif_device(void * user_data){
     C_TRACE("_display_onvif_device");
     OnvifMgrDeviceRow * omgr_device = (OnvifMgrDeviceRow *) user_data;
+    OnvifAppPrivate *priv;
+    ThumbnailDecode decode;
 
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(omgr_device)){
         C_TRAIL("_display_onvif_device - invalid device.");
@@ -160,6 +264,10 @@ void _display_onvif_device(void * user_data){
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(omgr_device)){
         C_TRAIL("_display_onvif_device - invalid device.");
         goto exit;
+    } else if(QueueEvent__is_cancelled(QueueEvent__get_current())){
+        //Rescan cancelled the device's events, skip the remaining requests
+        C_TRAIL("_display_onvif_device - cancelled.");
+        goto exit;
     } else if (OnvifDevice__get_last_error(odev) == ONVIF_ERROR_NOT_AUTHORIZED){
         goto updatethumb;
     }
@@ -167,6 +275,7 @@ void _display_onvif_device(void * user_data){
     /* Display Profile dropdown */
     if(!OnvifMgrDeviceRow__get_profile(omgr_device)){
         OnvifProfiles * profiles = OnvifMediaService__get_profiles(OnvifDevice__get_media_service(odev));
+        OnvifMgrDeviceRow__set_profiles(omgr_device,profiles);
         OnvifMgrDeviceRow__set_profile(omgr_device,OnvifProfiles__get_profile(profiles,0));
         OnvifProfiles__destroy(profiles);
         //We don't care for the initial profile event since the default index is 0.
@@ -177,7 +286,13 @@ void _display_onvif_device(void * user_data){
 
     /* Display row thumbnail. Default to profile index 0 */
 updatethumb:
-    OnvifMgrDeviceRow__load_thumbnail(omgr_device);
+    //Decoding is CPU bound, hand it over to the default pool and free this network worker
+    priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(omgr_device));
+    decode.snapshot = OnvifMgrDeviceRow__fetch_snapshot(omgr_device);
+    decode.device = g_object_ref(omgr_device);
+    OnvifApp__queue_record(priv->queue,
+                            QueueEvent__create_copy(omgr_device, _decode_thumbnail, &decode, sizeof(ThumbnailDecode)),
+                            EVENTQUEUE_DEFAULT_POOL, EVENTQUEUE_PRIORITY_BACKGROUND, FALSE, "thumbnail-decode", _decode_thumbnail_cleanup);
     if(!OnvifMgrDeviceRow__is_initialized(omgr_device)){ //First time initialization
         OnvifMgrDeviceRow__set_initialized(omgr_device);
         //If it was selected while initializing, redispatch select_device
@@ -200,7 +315,7 @@ void _profile_callback (void * user_data){
     
     if(OnvifMgrDeviceRow__is_selected(device)){
         OnvifAppPrivate *priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(device));
-        GstRtspPlayer__stop(priv->player);
+        GstRtspPlayer__stop(OnvifApp__get_player(priv));
     }
     OnvifApp__reload_device(device);
 
@@ -208,8 +323,9 @@ void _profile_callback (void * user_data){
 }
 
 void _play_onvif_stream(void * user_data){
-    ONVIFMGR_DEVICEROW_TRACE("_play_onvif_stream %s",user_data);
-    OnvifMgrDeviceRow * device = ONVIFMGR_DEVICEROW(user_data);
+    StreamTask * task = (StreamTask *) user_data;
+    OnvifMgrDeviceRow * device = task->device;
+    ONVIFMGR_DEVICEROW_TRACE("_play_onvif_stream %s",device);
 
     //Check if device is still valid. (User performed scan before thread started)
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) || !OnvifMgrDeviceRow__is_selected(device)){
@@ -220,6 +336,12 @@ void _play_onvif_stream(void * user_data){
     OnvifDevice * odev = OnvifMgrDeviceRow__get_device(device);
     OnvifApp * app = OnvifMgrDeviceRow__get_app(device);
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+
+    //A prefetched player took over the display since
+    if(task->player != OnvifApp__get_player(priv)){
+        C_TRAIL("_play_onvif_stream - player swapped.");
+        goto exit;
+    }
     
     /* Authentication check */
     OnvifDevice__authenticate(odev);
@@ -232,49 +354,52 @@ void _play_onvif_stream(void * user_data){
         goto exit;
     }
 
-    /* Set the URI to play */
-    char * uri = OnvifMediaService__getStreamUri(OnvifDevice__get_media_service(odev),OnvifProfile__get_index(OnvifMgrDeviceRow__get_profile(device)));
+    OnvifApp__load_stream(device, task->player);
+
+exit:
+    C_TRACE("_play_onvif_stream - done\n");
+    _stream_task_cleanup(task);
+}
+
+gboolean OnvifApp__load_stream(OnvifMgrDeviceRow * device, GstRtspPlayer * player){
+    OnvifDevice * odev = OnvifMgrDeviceRow__get_device(device);
+    OnvifProfile * profile = OnvifMgrDeviceRow__get_profile(device);
+    gboolean ret = FALSE;
+
+    /* Set the URI to play. Devices not displayed yet have no profile selected, default to index 0 */
+    char * uri = OnvifMediaService__getStreamUri(OnvifDevice__get_media_service(odev),profile ? OnvifProfile__get_index(profile) : 0);
     
     if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) && OnvifDevice__get_last_error(odev) == ONVIF_ERROR_NONE){
-        GstRtspPlayer__set_playback_url(priv->player,uri);
-        char * port = OnvifDevice__get_port(OnvifMgrDeviceRow__get_device(device));
-        GstRtspPlayer__set_port_fallback(priv->player,port);
+        GstRtspPlayer__set_playback_url(player,uri);
+        char * port = OnvifDevice__get_port(odev);
+        GstRtspPlayer__set_port_fallback(player,port);
         free(port);
 
-        char * host = OnvifDevice__get_host(OnvifMgrDeviceRow__get_device(device));
-        GstRtspPlayer__set_host_fallback(priv->player,host);
+        char * host = OnvifDevice__get_host(odev);
+        GstRtspPlayer__set_host_fallback(player,host);
         free(host);
         
         OnvifCredentials * ocreds = OnvifDevice__get_credentials(odev);
         char * user = OnvifCredentials__get_username(ocreds);
         char * pass = OnvifCredentials__get_password(ocreds);
-        GstRtspPlayer__set_credentials(priv->player, user, pass);
+        GstRtspPlayer__set_credentials(player, user, pass);
         free(user);
         free(pass);
 
-        GstRtspPlayer__play(priv->player);
+        GstRtspPlayer__play(player);
+        ret = TRUE;
     } else if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(device)) {
-        C_TRAIL("_play_onvif_stream - invalid device.");
+        C_TRAIL("OnvifApp__load_stream - invalid device.");
     }
     free(uri);
-
-exit:
-    C_TRACE("_play_onvif_stream - done\n");
-    g_object_unref(device);
+    return ret;
 }
 
 void _stop_onvif_stream(void * user_data){
     C_TRACE("_stop_onvif_stream");
-    OnvifApp * app = (OnvifApp *) user_data;
-    if(!COwnableObject__has_owner(COWNABLE_OBJECT(app))){
-        goto exit;
-    }
-
-    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
-    GstRtspPlayer__stop(priv->player);
-
-exit:
-    g_object_unref(app);
+    GstRtspPlayer * player = (GstRtspPlayer *) user_data;
+    GstRtspPlayer__stop(player);
+    g_object_unref(player);
 }
 
 void _onvif_authentication_reload(void * user_data){
@@ -285,7 +410,6 @@ void _onvif_authentication_reload(void * user_data){
     //Check device is still valid before adding ref (User performed scan before thread started)
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(device)){
         C_TRAIL("_onvif_authentication_reload - invalid device\n");
-        free(event);
         return;
     }
 
@@ -296,7 +420,13 @@ void _onvif_authentication_reload(void * user_data){
     } else {
         gdk_threads_add_idle(G_SOURCE_FUNC(idle_hide_dialog_loading),priv->cred_dialog);
     }
-    free(event);
+}
+
+//Discarded authentication attempt (rejected, or cancelled with the device's scope). The dialog stays open, its cancel
+//callback still releases the device.
+void _onvif_authentication_cleanup(void * user_data){
+    AppDialogEvent * event = (AppDialogEvent *) user_data;
+    gdk_threads_add_idle(G_SOURCE_FUNC(idle_hide_dialog_loading),event->dialog);
 }
 
 void _onvif_device_add(void * user_data){
@@ -364,11 +494,9 @@ void _onvif_device_add(void * user_data){
     }
 
     gdk_threads_add_idle(G_SOURCE_FUNC(idle_hide_dialog),dialog);
-    goto free;
+    return;
 exit:
     gdk_threads_add_idle(G_SOURCE_FUNC(idle_hide_dialog_loading),dialog);
-free:
-    free(event);
 }
 
 
@@ -382,6 +510,8 @@ static gboolean * OnvifApp__disocvery_found_server_cb (DiscoveryEvent * event) {
 
     ProbMatch * m;
     int i;
+    int count = 0;
+    OnvifMgrDeviceRow * found[server->matches->match_count > 0 ? server->matches->match_count : 1];
   
     C_INFO("Found server - Match count : %i\n",server->matches->match_count);
     for (i = 0 ; i < server->matches->match_count ; ++i) {
@@ -396,12 +526,13 @@ static gboolean * OnvifApp__disocvery_found_server_cb (DiscoveryEvent * event) {
             char * location = onvif_extract_scope("location",m);
             
             GtkWidget * omgr_device = OnvifMgrDeviceRow__new(app,onvif_dev,name,hardware,location);
-            OnvifApp__add_device(app,ONVIFMGR_DEVICEROW(omgr_device));
+            found[count++] = ONVIFMGR_DEVICEROW(omgr_device);
             free(name);
             free(hardware);
             free(location);
         }
     }
+    OnvifApp__add_devices(app,found,count);
 
 exit:
     CObject__destroy((CObject*)event);
@@ -414,7 +545,12 @@ void OnvifApp__cred_dialog_login_cb(AppDialogEvent * event){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(device));
     AppDialog__show_loading((AppDialog*)priv->cred_dialog, "ONVIF Authentication attempt...");
     OnvifDevice__set_credentials(OnvifMgrDeviceRow__get_device(device),CredentialsDialog__get_username((CredentialsDialog*)event->dialog),CredentialsDialog__get_password((CredentialsDialog*)event->dialog));
-    EventQueue__insert(priv->queue, device, _onvif_authentication_reload,AppDialogEvent_copy(event));
+    //The event is copied inline with the queued task
+    if(OnvifApp__queue_record(priv->queue, QueueEvent__create_copy(device, _onvif_authentication_reload, event, sizeof(AppDialogEvent)), priv->network_pool, EVENTQUEUE_PRIORITY_INTERACTIVE, TRUE, "auth-reload", _onvif_authentication_cleanup) == EVENTQUEUE_INSERT_REJECTED){
+        //Right away rather than from the cleanup's idle, the user can submit again
+        C_WARN("Authentication attempt rejected, too many queued tasks");
+        AppDialog__hide_loading((AppDialog*)priv->cred_dialog);
+    }
 }
 
 void OnvifApp__cred_dialog_cancel_cb(AppDialogEvent * event){
@@ -426,8 +562,22 @@ void OnvifApp__player_retry_cb(GstRtspPlayer * player, void * user_data){
     C_TRACE("OnvifApp__player_retry_cb");
     OnvifApp * self = (OnvifApp *) user_data;
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
-    g_object_ref(priv->device);
-    EventQueue__insert(priv->queue, priv->device, _player_retry_stream,priv->device);
+
+    //Exponential backoff to avoid spamming the camera
+    int attempt = g_atomic_int_add(&priv->retry_count,1);
+    int delay = ONVIFAPP_RETRY_DELAY_MS << MIN(attempt,ONVIFAPP_RETRY_MAX_SHIFT);
+    C_DEBUG("Retrying stream in %d ms",delay);
+
+    QueueEvent * evt = OnvifApp__create_stream_event(priv->device, player, _player_retry_stream);
+    QueueEvent__set_name(evt, "stream-retry");
+    QueueEvent__set_pool(evt, priv->network_pool);
+    QueueEvent__set_priority(evt, EVENTQUEUE_PRIORITY_INTERACTIVE);
+    QueueEvent__set_strand(evt, 1);
+    QueueEvent__set_cleanup_callback(evt, _stream_task_cleanup);
+    if(EventQueue__schedule_event(priv->queue, evt, delay) == EVENTQUEUE_INSERT_REJECTED){
+        //The device already has its fill of queued work, likely earlier retries still waiting
+        C_WARN("Stream retry rejected, device queue is full");
+    }
 }
 
 void OnvifApp__player_error_cb(GstRtspPlayer * player, void * user_data){
@@ -449,39 +599,146 @@ void OnvifApp__player_started_cb(GstRtspPlayer * player, void * user_data){
     C_INFO("Stream playing\n");
     OnvifApp * self = (OnvifApp *) user_data;
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    g_atomic_int_set(&priv->retry_count,0);
     if(GTK_IS_SPINNER(priv->player_loading_handle)){
         gtk_spinner_stop (GTK_SPINNER (priv->player_loading_handle));
     }
+    OnvifAutoProfile__stream_started(priv->autoprofile, priv->device, player);
+    OnvifStreamMonitor__stream_started(priv->monitor, priv->device, player);
 }
 
+static void OnvifApp__attach_player(OnvifApp * self, GstRtspPlayer * player){
+    g_signal_connect (G_OBJECT(player), "retry", G_CALLBACK (OnvifApp__player_retry_cb), self);
+    g_signal_connect (G_OBJECT(player), "error", G_CALLBACK (OnvifApp__player_error_cb), self);
+    g_signal_connect (G_OBJECT(player), "stopped", G_CALLBACK (OnvifApp__player_stopped_cb), self);
+    g_signal_connect (G_OBJECT(player), "started", G_CALLBACK (OnvifApp__player_started_cb), self);
+}
+
+//The task manager samples the queue on its own. Updating the UI from here would flood the main loop during bursts.
 void OnvifApp__eq_dispatch_cb(EventQueue * queue, EventQueueType type, void * user_data){
+    C_TRACE("EventQueue %s",EventQueueType__toString(type));
+}
+
+//Invoked on the main thread. Scopes are looked up among live rows since the task may outlive its device.
+char * OnvifApp__resolve_scope_cb(void * scope, void * user_data){
     OnvifApp * self = (OnvifApp *) user_data;
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
-    if(!GTK_IS_WIDGET(priv->task_label)){
-        return;
+    char * ret = NULL;
+    if(scope == self){
+        return strdup("Application");
+    }
+
+    GList * childs = gtk_container_get_children(GTK_CONTAINER(priv->listbox));
+    OnvifMgrDeviceRow * device;
+    GLIST_FOREACH(device, childs) {
+        if((void*)device == scope){
+            const char * name = OnvifMgrDeviceRow__get_name(device);
+            ret = strdup(name && strlen(name) ? name : "Device");
+            break;
+        }
+    }
+    g_list_free(childs);
+    return ret;
+}
+
+//The scope is only compared against the live rows, it may have been released since the task hung
+static gboolean OnvifApp__report_hung_task(void * user_data){
+    HungTaskReport * report = (HungTaskReport *) user_data;
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (report->app);
+    const char * task = report->name ? report->name : "unnamed";
+    gboolean found = FALSE;
+
+    if(COwnableObject__has_owner(COWNABLE_OBJECT(report->app)) && GTK_IS_CONTAINER(priv->listbox)){
+        GList * childs = gtk_container_get_children(GTK_CONTAINER(priv->listbox));
+        OnvifMgrDeviceRow * device;
+        GLIST_FOREACH(device, childs) {
+            if((void*)device == report->scope){
+                char * host = OnvifDevice__get_host(OnvifMgrDeviceRow__get_device(device));
+                C_WARN("Device '%s' [%s] unresponsive. Task '%s' cancelled after %lld ms",OnvifMgrDeviceRow__get_name(device),host,task,report->running_ms);
+                free(host);
+                found = TRUE;
+                break;
+            }
+        }
+        g_list_free(childs);
+    }
+    if(!found){
+        C_WARN("Task '%s' cancelled after %lld ms",task,report->running_ms);
     }
 
-    int running = EventQueue__get_running_event_count(queue);
-    int pending = EventQueue__get_pending_event_count(queue);
-    int total = EventQueue__get_thread_count(queue);
+    g_object_unref(report->app);
+    free(report);
+    return FALSE;
+}
 
-    C_TRACE("EventQueue %s : %d/%d/%d",EventQueueType__toString(type),running,pending,total);
+//Invoked by the queue watchdog under its lock, the device is looked up on the main thread
+void OnvifApp__hung_task_cb(EventQueue * queue, const EventQueueTask * task, void * user_data){
+    HungTaskReport * report = malloc(sizeof(HungTaskReport));
+    report->app = g_object_ref(user_data);
+    report->scope = task->scope;
+    report->name = task->name;
+    report->running_ms = task->age_us / 1000;
+    gdk_threads_add_idle(G_SOURCE_FUNC(OnvifApp__report_hung_task),report);
+}
 
-    char str[10];
-    memset(&str,'\0',sizeof(str));
-    sprintf(str, "[%d/%d]", running + pending,total);
+void _log_queue_stats(void * user_data){
+    EventQueue * queue = (EventQueue *) user_data;
+    char * json = QueueStats__to_json(EventQueue__get_stats(queue));
+    C_INFO("Queue statistics : %s",json);
+    free(json);
+}
 
-    gui_set_label_text(priv->task_label,str);
+void OnvifApp__setting_workers_cb(AppSettingsWorkers * settings, int min_threads, int max_threads, void * user_data){
+    OnvifApp * app = (OnvifApp *) user_data;
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    EventQueue__set_elastic(priv->queue, min_threads, max_threads);
 }
 
 void OnvifApp__setting_overscale_cb(AppSettingsStream * settings, int allow_overscale, void * user_data){
     OnvifApp * app = (OnvifApp *) user_data;
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
     GstRtspPlayer__set_allow_overscale(priv->player,allow_overscale);
+    OnvifGrid__set_allow_overscale(priv->grid,allow_overscale);
+    OnvifPrefetch__set_allow_overscale(priv->prefetch,allow_overscale);
+}
+
+void OnvifApp__setting_auto_profile_cb(AppSettingsStream * settings, int auto_profile, void * user_data){
+    OnvifApp * app = (OnvifApp *) user_data;
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    //Turning it back on hands the profiles picked by hand over to the automatic selection
+    if(auto_profile){
+        GList * childs = gtk_container_get_children(GTK_CONTAINER(priv->listbox));
+        OnvifMgrDeviceRow * device;
+        GLIST_FOREACH(device, childs) {
+            OnvifMgrDeviceRow__set_profile_locked(device, FALSE);
+        }
+        g_list_free(childs);
+    }
+    OnvifAutoProfile__set_enabled(priv->autoprofile, auto_profile);
+}
+
+void OnvifApp__setting_adaptive_profile_cb(AppSettingsStream * settings, int adaptive_profile, void * user_data){
+    OnvifApp * app = (OnvifApp *) user_data;
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    OnvifStreamMonitor__set_enabled(priv->monitor, adaptive_profile);
+}
+
+//The automatic selection would undo a step down meant for the stream's health
+static void OnvifApp__monitor_held_cb(int held, void * user_data){
+    OnvifApp * app = (OnvifApp *) user_data;
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    OnvifAutoProfile__set_held(priv->autoprofile, held);
+}
+
+void OnvifApp__setting_prefetch_cb(AppSettingsStream * settings, int sessions, int memory_mb, void * user_data){
+    OnvifApp * app = (OnvifApp *) user_data;
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    OnvifPrefetch__set_budget(priv->prefetch, sessions, memory_mb);
 }
 
 void OnvifApp__profile_selected_cb(ProfilesDialog * dialog, OnvifProfile * profile){
     OnvifMgrDeviceRow * device =  ProfilesDialog__get_device(dialog);
+    OnvifMgrDeviceRow__set_profile_locked(device,TRUE);
     OnvifMgrDeviceRow__set_profile(device,profile);
 }
 
@@ -501,39 +758,31 @@ void OnvifApp__btn_scan_cb (GtkWidget *widget, OnvifApp * app) {
 
     gtk_widget_set_sensitive(widget,FALSE);
 
-    /*
-    *
-    *TODO before uncommenting : Add cleanup mechanism to EventQueue event cancellation
-    *
-    */
-    // //Cancell all pending events associated to devices removed.
-    // GList * childs = gtk_container_get_children(GTK_CONTAINER(priv->listbox));
-    // GList * tmp = childs;
-    // int scopes_count = 0;
-    // void ** scopes = NULL;
-    // OnvifMgrDeviceRow * device;
-    // GLIST_FOREACH(device, childs) {
-    //     scopes_count++;
-    //     if(!scopes){
-    //         scopes = malloc(sizeof(void*)*scopes_count);
-    //     } else {
-    //         scopes = realloc(scopes,sizeof(void*)*scopes_count);
-    //     }
-    //     scopes[scopes_count-1] = device;
-    //     childs = childs->next;
-    // }
-    // g_list_free(tmp);
-
-    // //Submit cancellation request
-    // EventQueue__cancel_scopes(priv->queue,scopes, scopes_count);
-    // free(scopes);
+    //Cancel all pending events associated to devices removed.
+    //Their cleanup callbacks release the references held by the events.
+    GList * childs = gtk_container_get_children(GTK_CONTAINER(priv->listbox));
+    int scopes_count = g_list_length(childs);
+    void ** scopes = malloc(sizeof(void*)*(scopes_count + 1));
+    int i = 0;
+    OnvifMgrDeviceRow * device;
+    GLIST_FOREACH(device, childs) {
+        scopes[i++] = device;
+    }
+    g_list_free(childs);
+
+    //Submit cancellation request
+    EventQueue__cancel_scopes(priv->queue,scopes, scopes_count);
+    free(scopes);
 
     //Clearing the list
     gtk_container_foreach (GTK_CONTAINER (priv->listbox), (GtkCallback)gui_container_remove, priv->listbox);
 
     //Multiple dispatch in case of packet dropped
     g_object_ref(app);
-    EventQueue__insert(priv->queue, app, _start_onvif_discovery,app);
+    if(OnvifApp__queue_event(priv->queue, priv->discovery_pool, EVENTQUEUE_PRIORITY_BACKGROUND, FALSE, app, "discovery", _start_onvif_discovery,app, g_object_unref) == EVENTQUEUE_INSERT_REJECTED){
+        //Nothing will finish the scan to enable the button again
+        gtk_widget_set_sensitive(widget,TRUE);
+    }
 }
 
 static void OnvifApp__profile_picker_cb (OnvifMgrDeviceRow *device){
@@ -544,8 +793,10 @@ static void OnvifApp__profile_picker_cb (OnvifMgrDeviceRow *device){
 
 static void OnvifApp__profile_changed_cb (OnvifMgrDeviceRow *device){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(device));
+    //The standby session still plays the previous profile
+    OnvifPrefetch__forget(priv->prefetch, device);
     g_object_ref(device);
-    EventQueue__insert(priv->queue, device, _profile_callback,device);
+    OnvifApp__queue_event(priv->queue, priv->network_pool, EVENTQUEUE_PRIORITY_INTERACTIVE, TRUE, device, "profile-change", _profile_callback,device, g_object_unref);
 }
 
 void OnvifApp__add_device_cb(AppDialogEvent * event){
@@ -558,7 +809,11 @@ void OnvifApp__add_device_cb(AppDialogEvent * event){
 
     AppDialog__show_loading((AppDialog*)event->dialog, "Testing ONVIF device configuration...");
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
-    EventQueue__insert(priv->queue, event->dialog, _onvif_device_add,AppDialogEvent_copy(event));
+    if(OnvifApp__queue_record(priv->queue, QueueEvent__create_copy(event->dialog, _onvif_device_add, event, sizeof(AppDialogEvent)), priv->network_pool, EVENTQUEUE_PRIORITY_INTERACTIVE, FALSE, "device-add", NULL) == EVENTQUEUE_INSERT_REJECTED){
+        //Nothing will hide the loading state, the user can submit again
+        C_WARN("Device add rejected, too many queued tasks");
+        AppDialog__hide_loading((AppDialog*)event->dialog);
+    }
 }
 
 void OnvifApp__add_btn_cb (GtkWidget *widget, OnvifApp * app) {
@@ -617,8 +872,10 @@ static int OnvifApp__reload_device(OnvifMgrDeviceRow * device){
 
         OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
         safely_start_spinner(priv->player_loading_handle);
-        g_object_ref(device);
-        _play_onvif_stream(device);
+        StreamTask task;
+        task.device = g_object_ref(device);
+        task.player = g_object_ref(OnvifApp__get_player(priv));
+        _play_onvif_stream(&task);
     }
 
     return 1;
@@ -651,10 +908,27 @@ static void OnvifApp__select_device(OnvifApp * app,  GtkListBoxRow * row){
     C_DEBUG("OnvifApp__select_device");
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
 
-    //Stop previous stream
-    g_object_ref(app);
-    EventQueue__insert(priv->queue,app, _stop_onvif_stream,app);
+    g_atomic_int_set(&priv->retry_count,0);
 
+    //A ready standby session is resumed in place of the displayed one, which goes on standby for the previous device
+    OnvifMgrDeviceRow * previous = priv->device ? g_object_ref(priv->device) : NULL;
+    GstRtspPlayer * standby = ONVIFMGR_IS_DEVICEROW(row) ? OnvifPrefetch__swap(priv->prefetch, ONVIFMGR_DEVICEROW(row), priv->player, previous) : NULL;
+    if(previous){
+        g_object_unref(previous);
+    }
+
+    if(standby){
+        g_signal_handlers_disconnect_by_data(priv->player, app);
+        g_atomic_pointer_set(&priv->player, standby);
+        OnvifApp__attach_player(app, standby);
+        OnvifNVT__show_player(priv->nvt, standby);
+    } else {
+        //Stop previous stream. Rapid selection changes only need the latest pending stop.
+        g_object_ref(priv->player);
+        QueueEvent * stop_evt = QueueEvent__create(priv->player, _stop_onvif_stream, priv->player);
+        QueueEvent__set_coalesce(stop_evt, NULL);
+        OnvifApp__queue_record(priv->queue, stop_evt, priv->network_pool, EVENTQUEUE_PRIORITY_INTERACTIVE, FALSE, "stream-stop", g_object_unref);
+    }
 
     OnvifApp__set_device(app,row);
 
@@ -674,28 +948,61 @@ static void OnvifApp__select_device(OnvifApp * app,  GtkListBoxRow * row){
         }
 
         gtk_spinner_start (GTK_SPINNER (priv->player_loading_handle));
-        g_object_ref(priv->device);
-        EventQueue__insert(priv->queue, priv->device, _play_onvif_stream,priv->device);
+        if(standby){
+            //Resumed on the spot, the "started" signal hides the spinner
+            goto exit;
+        }
+        //Keyed on the player, so that a pending play of a previously selected device is superseded
+        QueueEvent * play_evt = OnvifApp__create_stream_event(priv->device, priv->player, _play_onvif_stream);
+        QueueEvent__set_name(play_evt, "stream-start");
+        QueueEvent__set_pool(play_evt, priv->network_pool);
+        QueueEvent__set_priority(play_evt, EVENTQUEUE_PRIORITY_INTERACTIVE);
+        QueueEvent__set_strand(play_evt, 1);
+        QueueEvent__set_coalesce(play_evt, priv->player);
+        QueueEvent__set_cleanup_callback(play_evt, _stream_task_cleanup);
+        EventQueue__insert_event(priv->queue, play_evt);
     }
 
 exit:
+    OnvifPrefetch__update(priv->prefetch, priv->device);
+    OnvifAutoProfile__set_device(priv->autoprofile, priv->device);
+    OnvifStreamMonitor__set_device(priv->monitor, priv->device);
     g_signal_emit (app, signals[DEVICE_CHANGED], 0, ONVIFMGR_DEVICEROW(row) /* details */);
 }
 
-static void OnvifApp__display_device(OnvifApp * self, OnvifMgrDeviceRow * device){
+static QueueEvent * OnvifApp__create_display_event(OnvifApp * self, OnvifMgrDeviceRow * device){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
     g_object_ref(device);
-    EventQueue__insert(priv->queue, device, _display_onvif_device,device);
+    return OnvifApp__prepare_record(QueueEvent__create(device, _display_onvif_device, device), priv->network_pool, EVENTQUEUE_PRIORITY_BACKGROUND, TRUE, "display-device", g_object_unref);
+}
+
+static void OnvifApp__display_device(OnvifApp * self, OnvifMgrDeviceRow * device){
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    EventQueue__insert_event(priv->queue, OnvifApp__create_display_event(self, device));
 }
 
-static void OnvifApp__add_device(OnvifApp * app, OnvifMgrDeviceRow * omgr_device){
+//A discovery burst is queued in a single insert, waking no more workers than there are devices to display
+static void OnvifApp__add_devices(OnvifApp * app, OnvifMgrDeviceRow ** devices, int count){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
-    g_signal_connect (G_OBJECT (omgr_device), "profile-clicked", G_CALLBACK (OnvifApp__profile_picker_cb), NULL);
+    QueueEvent * events[count > 0 ? count : 1];
+    int queued;
+
+    for(int i=0;i<count;i++){
+        g_signal_connect (G_OBJECT (devices[i]), "profile-clicked", G_CALLBACK (OnvifApp__profile_picker_cb), NULL);
+        OnvifGrid__add_drag_source(priv->grid, devices[i]);
 
-    gtk_list_box_insert (GTK_LIST_BOX (priv->listbox), GTK_WIDGET(omgr_device), -1);
-    gtk_widget_show_all (GTK_WIDGET(omgr_device));
+        gtk_list_box_insert (GTK_LIST_BOX (priv->listbox), GTK_WIDGET(devices[i]), -1);
+        gtk_widget_show_all (GTK_WIDGET(devices[i]));
 
-    OnvifApp__display_device(app,omgr_device);
+        events[i] = OnvifApp__create_display_event(app,devices[i]);
+    }
+
+    if(count > 0){
+        queued = EventQueue__insert_many(priv->queue, events, count);
+        if(queued < count){
+            C_WARN("Queue full, %d of %d devices won't be displayed",count - queued,count);
+        }
+    }
 }
 
 static int OnvifApp__device_already_exist(OnvifApp * app, char * xaddr){
@@ -847,7 +1154,10 @@ void OnvifApp__create_ui (OnvifApp * app) {
     gtk_box_pack_start(GTK_BOX(hbox),priv->player_loading_handle,FALSE,FALSE,0);
     gtk_widget_show_all(hbox);
 
-    widget = OnvifNVT__create_ui(priv->player);
+    widget = OnvifNVT__create_ui(&priv->player);
+    priv->nvt = widget;
+    OnvifPrefetch__set_view(priv->prefetch, priv->nvt, priv->listbox);
+    OnvifAutoProfile__set_view(priv->autoprofile, priv->nvt);
     gtk_notebook_append_page (GTK_NOTEBOOK (main_notebook), widget, hbox);
 
     label = gtk_label_new ("Details");
@@ -865,6 +1175,12 @@ void OnvifApp__create_ui (OnvifApp * app) {
 
     gtk_notebook_append_page (GTK_NOTEBOOK (main_notebook), widget, hbox);
 
+    //Devices are dragged from the list onto the tiles
+    label = gtk_label_new ("Grid");
+    widget = OnvifGrid__get_widget(priv->grid);
+
+    gtk_notebook_append_page (GTK_NOTEBOOK (main_notebook), widget, label);
+
 
     label = gtk_label_new ("Settings");
     //Hidden spinner used to display stream start loading
@@ -892,13 +1208,10 @@ void OnvifApp__create_ui (OnvifApp * app) {
     hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL,  6);
     gtk_box_pack_start (GTK_BOX(hbox),label,TRUE,TRUE,0);
 
-    int running = EventQueue__get_running_event_count(priv->queue);
-    int pending = EventQueue__get_pending_event_count(priv->queue);
-    int total = EventQueue__get_thread_count(priv->queue);
-    char str[7];
-    sprintf(str, "[%d/%d]", running + pending,total);
-    priv->task_label = gtk_label_new (str);
+    priv->task_label = gtk_label_new (NULL);
     gtk_box_pack_start(GTK_BOX(hbox),priv->task_label,FALSE,FALSE,0);
+    TaskMgr__set_summary_label(priv->taskmgr,priv->task_label);
+    TaskMgr__set_scope_resolver(priv->taskmgr,OnvifApp__resolve_scope_cb,app);
     // gtk_box_pack_start(GTK_BOX(hbox),widget,FALSE,FALSE,0);
     gtk_widget_show_all(hbox);
 
@@ -923,6 +1236,8 @@ void OnvifApp__create_ui (OnvifApp * app) {
 
     priv->window = main_window;
     gtk_widget_show_all (main_window);
+    //Worker updates to images and labels are applied once per frame of the main window
+    gui_batch_attach(main_window);
 
 }
 
@@ -930,11 +1245,23 @@ void OnvifApp__dispose(GObject * obj){
     OnvifApp * self = ONVIFMGR_APP(obj);
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
     if (self) {
+        //Stop sampling before the queue goes away
+        TaskMgr__destroy(priv->taskmgr);
+        //Pending continuations are dropped with the source, it must go before the queue
+        if(priv->completion_source){
+            g_source_destroy(priv->completion_source);
+            g_source_unref(priv->completion_source);
+            priv->completion_source = NULL;
+        }
         //Destroying the queue will hang until all threads are stopped
         CObject__destroy((CObject*)priv->queue);
+        //Same as the player below, the grid's players are released once nothing can dispatch their retries
+        OnvifGrid__destroy(priv->grid);
+        OnvifPrefetch__destroy(priv->prefetch);
+        OnvifStreamMonitor__destroy(priv->monitor);
+        OnvifAutoProfile__destroy(priv->autoprofile);
         OnvifDetails__destroy(priv->details);
         AppSettings__destroy(priv->settings);
-        TaskMgr__destroy(priv->taskmgr);
         CObject__destroy((CObject*)priv->profiles_dialog);
         CObject__destroy((CObject*)priv->add_dialog);
         CObject__destroy((CObject*)priv->cred_dialog);
@@ -999,38 +1326,69 @@ OnvifApp__init (OnvifApp *self)
 
     priv->device = NULL;
     priv->owned = 1;
+    priv->retry_count = 0;
     priv->task_label = NULL;
     priv->queue = EventQueue__create(OnvifApp__eq_dispatch_cb,self);
     priv->details = OnvifDetails__create(self);
     priv->settings = AppSettings__create(self);
-    priv->taskmgr = TaskMgr__create();
+    priv->taskmgr = TaskMgr__create(priv->queue);
+    priv->completion_source = QueueSource__new(priv->queue);
+    g_source_attach(priv->completion_source, NULL);
 
     AppSettingsStream__set_overscale_callback(priv->settings->stream,OnvifApp__setting_overscale_cb,self);
     priv->player = GstRtspPlayer__new();
     GstRtspPlayer__set_allow_overscale(priv->player,AppSettingsStream__get_allow_overscale(priv->settings->stream));
 
-    //Defaults 8 paralell event threads.
-    //TODO support configuration to modify this
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-
-    g_signal_connect (G_OBJECT(priv->player), "retry", G_CALLBACK (OnvifApp__player_retry_cb), self);
-    g_signal_connect (G_OBJECT(priv->player), "error", G_CALLBACK (OnvifApp__player_error_cb), self);
-    g_signal_connect (G_OBJECT(priv->player), "stopped", G_CALLBACK (OnvifApp__player_stopped_cb), self);
-    g_signal_connect (G_OBJECT(priv->player), "started", G_CALLBACK (OnvifApp__player_started_cb), self);
-
-    priv->profiles_dialog = ProfilesDialog__create(priv->queue, OnvifApp__profile_selected_cb);
+    //Worker pool grows under load and shrinks back when idle, within the configured bounds
+    AppSettingsWorkers__set_bounds_callback(priv->settings->workers,OnvifApp__setting_workers_cb,self);
+    EventQueue__set_elastic(priv->queue,
+                            AppSettingsWorkers__get_min_threads(priv->settings->workers),
+                            AppSettingsWorkers__get_max_threads(priv->settings->workers));
+    priv->network_pool = EventQueue__add_pool(priv->queue, "network", ONVIFAPP_NETWORK_POOL_MIN, ONVIFAPP_NETWORK_POOL_MAX);
+    priv->discovery_pool = EventQueue__add_pool(priv->queue, "discovery", ONVIFAPP_DISCOVERY_POOL_SIZE, ONVIFAPP_DISCOVERY_POOL_SIZE);
+    priv->grid = OnvifGrid__create(priv->queue, priv->network_pool, QueueSource__get_sink(priv->completion_source));
+    OnvifGrid__set_allow_overscale(priv->grid,AppSettingsStream__get_allow_overscale(priv->settings->stream));
+    priv->prefetch = OnvifPrefetch__create(priv->queue, priv->network_pool, QueueSource__get_sink(priv->completion_source));
+    OnvifPrefetch__set_allow_overscale(priv->prefetch,AppSettingsStream__get_allow_overscale(priv->settings->stream));
+    AppSettingsStream__set_prefetch_callback(priv->settings->stream,OnvifApp__setting_prefetch_cb,self);
+    priv->autoprofile = OnvifAutoProfile__create();
+    OnvifAutoProfile__set_enabled(priv->autoprofile,AppSettingsStream__get_auto_profile(priv->settings->stream));
+    AppSettingsStream__set_auto_profile_callback(priv->settings->stream,OnvifApp__setting_auto_profile_cb,self);
+    priv->monitor = OnvifStreamMonitor__create(OnvifApp__monitor_held_cb, self);
+    OnvifStreamMonitor__set_enabled(priv->monitor,AppSettingsStream__get_adaptive_profile(priv->settings->stream));
+    AppSettingsStream__set_adaptive_profile_callback(priv->settings->stream,OnvifApp__setting_adaptive_profile_cb,self);
+    //Only camera requests get a deadline, discovery is bounded by its own scan timeout
+    EventQueue__set_pool_deadline(priv->queue, priv->network_pool, ONVIFAPP_NETWORK_DEADLINE_MS);
+    EventQueue__set_watchdog(priv->queue, ONVIFAPP_WATCHDOG_INTERVAL_MS, OnvifApp__hung_task_cb, self);
+    //Producers run on the main thread, which must never block on the queue
+    EventQueue__set_capacity(priv->queue, ONVIFAPP_QUEUE_CAPACITY, EVENTQUEUE_OVERFLOW_REJECT);
+    EventQueue__set_scope_capacity(priv->queue, ONVIFAPP_SCOPE_CAPACITY, EVENTQUEUE_OVERFLOW_REJECT);
+    //Follow-ups queued by a device task (thumbnail, profiles...) stay on the worker that has its data cached
+    EventQueue__set_work_stealing(priv->queue, 1);
+
+    char * recycle = getenv(ONVIFAPP_PIPELINE_RECYCLE_ENV);
+    GstRtspPlayer__set_recycle_pipeline(priv->player, !recycle || atoi(recycle) != 0);
+    OnvifGrid__set_recycle_pipeline(priv->grid, !recycle || atoi(recycle) != 0);
+    OnvifPrefetch__set_recycle_pipeline(priv->prefetch, !recycle || atoi(recycle) != 0);
+
+    char * stats_interval = getenv(ONVIFAPP_QUEUE_STATS_ENV);
+    if(stats_interval && atoi(stats_interval) > 0){
+        EventQueue__set_stats_enabled(priv->queue,1);
+        EventQueue__insert_periodic(priv->queue, EVENTQUEUE_PRIORITY_BACKGROUND, NULL, atoi(stats_interval) * 1000, _log_queue_stats, priv->queue);
+    }
+
+    OnvifApp__attach_player(self, priv->player);
+
+    priv->profiles_dialog = ProfilesDialog__create(priv->queue, priv->network_pool, OnvifApp__profile_selected_cb);
     priv->add_dialog = AddDeviceDialog__create();
     priv->cred_dialog = CredentialsDialog__create();
     priv->msg_dialog = MsgDialog__create();
     
     OnvifApp__create_ui (self);
+    //Needs the NVT view for the standby canvases
+    OnvifPrefetch__set_budget(priv->prefetch,
+                            AppSettingsStream__get_prefetch_sessions(priv->settings->stream),
+                            AppSettingsStream__get_prefetch_memory(priv->settings->stream));
 
 }
 
@@ -1042,8 +1400,17 @@ OnvifApp * OnvifApp__new(void){
 void OnvifApp__destroy(OnvifApp* self){
     g_return_if_fail (self != NULL);
     g_return_if_fail (ONVIFMGR_IS_APP (self));
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
     g_object_ref(self);
     COwnableObject__disown(COWNABLE_OBJECT(self)); //Changing owned state, flagging pending events to be ignored
+    //Workers are joined here so that only references held by stuck tasks are left to wait on
+    int stragglers = EventQueue__shutdown(priv->queue,ONVIFAPP_SHUTDOWN_TIMEOUT_MS);
+    if(stragglers){
+        //Disposing would join the queue and wait on the references of the stuck tasks, both forever.
+        //The app and its queue are left to the process exit, the stuck tasks may still use them.
+        C_WARN("Skipping app disposal, %d task(s) still running",stragglers);
+        return;
+    }
     while(G_IS_OBJECT(self) && G_OBJECT(self)->ref_count > 1){ //Wait for destruction to complete
         usleep(500000);
     }
@@ -1057,9 +1424,25 @@ MsgDialog * OnvifApp__get_msg_dialog(OnvifApp * self){
     return priv->msg_dialog;
 }
 
-void OnvifApp__dispatch(OnvifApp* self, void * scope, void (*callback)(), void * user_data){
+void OnvifApp__dispatch(OnvifApp* self, void * scope, void (*callback)(), void * user_data, void (*cleanup)(void * user_data)){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (ONVIFMGR_IS_APP (self));
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    OnvifApp__queue_event(priv->queue, priv->network_pool, EVENTQUEUE_PRIORITY_NORMAL, FALSE, scope, NULL, callback, user_data, cleanup);
+}
+
+void OnvifApp__dispatch_copy(OnvifApp* self, void * scope, void (*callback)(), const void * data, size_t size, void (*cleanup)(void * user_data)){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (ONVIFMGR_IS_APP (self));
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    OnvifApp__queue_record(priv->queue, QueueEvent__create_copy(scope, callback, data, size), priv->network_pool, EVENTQUEUE_PRIORITY_NORMAL, FALSE, NULL, cleanup);
+}
+
+void OnvifApp__submit_copy(OnvifApp* self, void * scope, QUEUE_TASK task, const void * data, size_t size, QUEUE_CONTINUATION done, void (*free_result)(void * result), void (*cleanup)(void * user_data)){
     g_return_if_fail (self != NULL);
     g_return_if_fail (ONVIFMGR_IS_APP (self));
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
-    EventQueue__insert(priv->queue, scope, callback,user_data);
+    QueueEvent * evt = QueueEvent__create_future_copy(scope, task, data, size);
+    QueueEvent__set_continuation(evt, QueueSource__get_sink(priv->completion_source), done, free_result);
+    OnvifApp__queue_record(priv->queue, evt, priv->network_pool, EVENTQUEUE_PRIORITY_NORMAL, FALSE, NULL, cleanup);
 }
\ No newline at end of file
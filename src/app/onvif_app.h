@@ -2,12 +2,14 @@
 #define OMGR_APP_H_
 
 #include <glib-object.h>
+#include "../queue/queue_event.h"
 
 
 typedef struct _OnvifApp OnvifApp;
 
 #include "dialog/msg_dialog.h"
 #include "omgr_device_row.h"
+#include "../gst/gstrtspplayer.h"
 
 G_BEGIN_DECLS
 
@@ -27,9 +29,22 @@ struct _OnvifAppClass
 };
 
 OnvifApp * OnvifApp__new (void);
+//Shuts the queue down within a deadline, then disposes of the app. Tasks still running past the deadline leave the app undisposed.
 void OnvifApp__destroy(OnvifApp* self);
 MsgDialog * OnvifApp__get_msg_dialog(OnvifApp * self);
-void OnvifApp__dispatch(OnvifApp* app, void * scope, void (*callback)(), void * user_data);
+//Runs the callback on the network worker pool, meant for tasks blocking on camera requests.
+//cleanup is invoked with user_data if the event is cancelled before being dispatched
+void OnvifApp__dispatch(OnvifApp* app, void * scope, void (*callback)(), void * user_data, void (*cleanup)(void * user_data));
+//Same as OnvifApp__dispatch, but the callback receives a copy of data owned by the task. Small payloads don't require any allocation.
+void OnvifApp__dispatch_copy(OnvifApp* app, void * scope, void (*callback)(), const void * data, size_t size, void (*cleanup)(void * user_data));
+//Runs the task on the network worker pool, then its continuation on the main thread with the task's result.
+//Replaces the worker's own gdk_threads_add_idle call. Cancelling the scope drops the continuation too, and cleanup is invoked instead.
+//free_result is invoked with the result once the continuation returned, or when it is dropped.
+void OnvifApp__submit_copy(OnvifApp* app, void * scope, QUEUE_TASK task, const void * data, size_t size, QUEUE_CONTINUATION done, void (*free_result)(void * result), void (*cleanup)(void * user_data));
+
+//Fetches the stream URI of the device's profile and starts playing it. Blocks on camera requests, meant for network workers.
+//Returns FALSE if the URI couldn't be retrieved or the device was released meanwhile.
+gboolean OnvifApp__load_stream(OnvifMgrDeviceRow * device, GstRtspPlayer * player);
 
 G_END_DECLS
 
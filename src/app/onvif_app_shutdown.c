@@ -9,7 +9,7 @@ void * _thread_destruction(void * event){
     OnvifApp * app = (OnvifApp *) event;
     
     //This what may take a long time.
-    //Destroying the EventQueue will hang until all threads are finished
+    //Bounded by the queue shutdown deadline, stuck tasks leave the app to the process exit
     OnvifApp__destroy(app);
     
     //Quitting from idle thread allows the windows and OnvifMgrDeviceRow (and nested OnvifDevice) to destroy properly
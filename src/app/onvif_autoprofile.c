@@ -0,0 +1,205 @@
+#include "onvif_autoprofile.h"
+#include "clogger.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Time without resize before a profile is picked, a window drag shouldn't restart the stream
+#define ONVIFAUTOPROFILE_RESIZE_DELAY_MS 500
+//Upscaling a stream by up to 10% is tolerated before stepping up to a larger profile
+#define ONVIFAUTOPROFILE_UPSCALE_TOLERANCE 1.1
+//Stepping down once a stream is downscaled by more than 20%. The gap between both thresholds avoids flapping.
+#define ONVIFAUTOPROFILE_DOWNSCALE_THRESHOLD 0.8
+
+struct _OnvifAutoProfile {
+    int enabled;
+    int held;
+    GtkWidget * view;
+    gulong allocate_handler;
+    guint resize_source;
+    //Allocated size of the view in device pixels
+    int width;
+    int height;
+    OnvifMgrDeviceRow * device;
+};
+
+//Factor the stream is displayed at, fitted in the view
+static double priv_OnvifAutoProfile__scale(OnvifAutoProfile * self, int width, int height){
+    return MIN((double) self->width / width, (double) self->height / height);
+}
+
+//Smallest known profile displayed without upscaling, below max_area
+static int priv_OnvifAutoProfile__smallest_covering(OnvifAutoProfile * self, OnvifMgrDeviceRow * device, long max_area){
+    int best = -1;
+    long best_area = max_area;
+    int width, height;
+    for(int i=0;i<OnvifMgrDeviceRow__get_profile_count(device);i++){
+        if(OnvifMgrDeviceRow__get_profile_size(device, i, &width, &height) &&
+                priv_OnvifAutoProfile__scale(self, width, height) <= 1.0 && (long) width * height < best_area){
+            best = i;
+            best_area = (long) width * height;
+        }
+    }
+    return best;
+}
+
+static int priv_OnvifAutoProfile__largest(OnvifMgrDeviceRow * device, long min_area){
+    int best = -1;
+    long best_area = min_area;
+    int width, height;
+    for(int i=0;i<OnvifMgrDeviceRow__get_profile_count(device);i++){
+        if(OnvifMgrDeviceRow__get_profile_size(device, i, &width, &height) && (long) width * height > best_area){
+            best = i;
+            best_area = (long) width * height;
+        }
+    }
+    return best;
+}
+
+//Cameras list their main stream first and smaller sub streams after it. Only the neighbouring profile is probed.
+static int priv_OnvifAutoProfile__probe(OnvifMgrDeviceRow * device, int index){
+    int width, height;
+    if(index < 0 || index >= OnvifMgrDeviceRow__get_profile_count(device) || OnvifMgrDeviceRow__get_profile_size(device, index, &width, &height)){
+        return -1;
+    }
+    return index;
+}
+
+static int priv_OnvifAutoProfile__pick(OnvifAutoProfile * self, OnvifMgrDeviceRow * device, int current){
+    int width, height;
+    //Waiting for the current stream to report its size
+    if(!OnvifMgrDeviceRow__get_profile_size(device, current, &width, &height)){
+        return current;
+    }
+
+    long area = (long) width * height;
+    double scale = priv_OnvifAutoProfile__scale(self, width, height);
+    int target = -1;
+    if(scale > ONVIFAUTOPROFILE_UPSCALE_TOLERANCE){
+        target = priv_OnvifAutoProfile__smallest_covering(self, device, G_MAXLONG);
+        if(target < 0) target = priv_OnvifAutoProfile__largest(device, area);
+        if(target < 0) target = priv_OnvifAutoProfile__probe(device, current - 1);
+    } else if(scale < ONVIFAUTOPROFILE_DOWNSCALE_THRESHOLD){
+        target = priv_OnvifAutoProfile__smallest_covering(self, device, area);
+        if(target < 0) target = priv_OnvifAutoProfile__probe(device, current + 1);
+    }
+    return target < 0 ? current : target;
+}
+
+static void priv_OnvifAutoProfile__evaluate(OnvifAutoProfile * self){
+    OnvifMgrDeviceRow * device = self->device;
+    if(!self->enabled || self->held || self->width <= 0 || self->height <= 0 || !ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) || OnvifMgrDeviceRow__is_profile_locked(device)){
+        return;
+    }
+
+    OnvifProfile * profile = OnvifMgrDeviceRow__get_profile(device);
+    if(!profile || OnvifMgrDeviceRow__get_profile_count(device) < 2){
+        return;
+    }
+
+    int current = OnvifProfile__get_index(profile);
+    int target = priv_OnvifAutoProfile__pick(self, device, current);
+    if(target == current){
+        return;
+    }
+
+    int width, height;
+    OnvifProfile * next = OnvifMgrDeviceRow__get_profile_at(device, target);
+    if(OnvifMgrDeviceRow__get_profile_size(device, target, &width, &height)){
+        C_INFO("Automatic profile '%s' (%dx%d) for a %dx%d view", OnvifProfile__get_name(next), width, height, self->width, self->height);
+    } else {
+        C_INFO("Automatic profile probing '%s' for a %dx%d view", OnvifProfile__get_name(next), self->width, self->height);
+    }
+    //Restarts the stream through the regular profile change
+    OnvifMgrDeviceRow__set_profile(device, next);
+}
+
+static gboolean priv_OnvifAutoProfile__resize_timeout(gpointer user_data){
+    OnvifAutoProfile * self = (OnvifAutoProfile *) user_data;
+    self->resize_source = 0;
+    priv_OnvifAutoProfile__evaluate(self);
+    return G_SOURCE_REMOVE;
+}
+
+static void priv_OnvifAutoProfile__size_allocate(GtkWidget * widget, GdkRectangle * allocation, OnvifAutoProfile * self){
+    int scale_factor = gtk_widget_get_scale_factor(widget);
+    int width = allocation->width * scale_factor;
+    int height = allocation->height * scale_factor;
+    if(width == self->width && height == self->height){
+        return;
+    }
+
+    self->width = width;
+    self->height = height;
+    if(self->resize_source){
+        g_source_remove(self->resize_source);
+    }
+    self->resize_source = g_timeout_add(ONVIFAUTOPROFILE_RESIZE_DELAY_MS, priv_OnvifAutoProfile__resize_timeout, self);
+}
+
+OnvifAutoProfile * OnvifAutoProfile__create(){
+    OnvifAutoProfile * self = malloc(sizeof(OnvifAutoProfile));
+    memset(self, 0, sizeof(OnvifAutoProfile));
+    return self;
+}
+
+void OnvifAutoProfile__destroy(OnvifAutoProfile * self){
+    if(!self){
+        return;
+    }
+
+    if(self->resize_source){
+        g_source_remove(self->resize_source);
+    }
+    if(self->allocate_handler && GTK_IS_WIDGET(self->view)){
+        g_signal_handler_disconnect(self->view, self->allocate_handler);
+    }
+    if(self->device){
+        g_object_unref(self->device);
+    }
+    free(self);
+}
+
+void OnvifAutoProfile__set_enabled(OnvifAutoProfile * self, int enabled){
+    g_return_if_fail (self != NULL);
+    self->enabled = enabled;
+    priv_OnvifAutoProfile__evaluate(self);
+}
+
+void OnvifAutoProfile__set_held(OnvifAutoProfile * self, int held){
+    g_return_if_fail (self != NULL);
+    //Releasing comes with a profile change, the choice is reevaluated once that stream started
+    self->held = held;
+}
+
+void OnvifAutoProfile__set_view(OnvifAutoProfile * self, GtkWidget * view){
+    g_return_if_fail (self != NULL);
+    self->view = view;
+    self->allocate_handler = g_signal_connect (G_OBJECT(view), "size-allocate", G_CALLBACK (priv_OnvifAutoProfile__size_allocate), self);
+}
+
+void OnvifAutoProfile__set_device(OnvifAutoProfile * self, OnvifMgrDeviceRow * device){
+    g_return_if_fail (self != NULL);
+    if(device == self->device){
+        return;
+    }
+    if(self->device){
+        g_object_unref(self->device);
+    }
+    //Evaluated once its stream started, a change now would restart the stream being started
+    self->device = device ? g_object_ref(device) : NULL;
+}
+
+void OnvifAutoProfile__stream_started(OnvifAutoProfile * self, OnvifMgrDeviceRow * device, GstRtspPlayer * player){
+    g_return_if_fail (self != NULL);
+    int width, height;
+    OnvifProfile * profile = ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) ? OnvifMgrDeviceRow__get_profile(device) : NULL;
+    if(!profile || !GstRtspPlayer__get_video_size(player, &width, &height)){
+        return;
+    }
+
+    C_DEBUG("Profile '%s' streams %dx%d", OnvifProfile__get_name(profile), width, height);
+    OnvifMgrDeviceRow__set_profile_size(device, OnvifProfile__get_index(profile), width, height);
+    if(device == self->device){
+        priv_OnvifAutoProfile__evaluate(self);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef ONVIF_AUTOPROFILE_H_
+#define ONVIF_AUTOPROFILE_H_
+
+#include <gtk/gtk.h>
+#include "../gst/gstrtspplayer.h"
+#include "omgr_device_row.h"
+
+typedef struct _OnvifAutoProfile OnvifAutoProfile;
+
+//Switches the selected device to the smallest profile covering the view, so small views don't decode the main stream.
+//The media service doesn't report encoder resolutions, each profile's size is learned from its decoded stream.
+OnvifAutoProfile * OnvifAutoProfile__create();
+void OnvifAutoProfile__destroy(OnvifAutoProfile * self);
+void OnvifAutoProfile__set_enabled(OnvifAutoProfile * self, int enabled);
+//Suspends the selection while the stream is downgraded for its health (see OnvifStreamMonitor)
+void OnvifAutoProfile__set_held(OnvifAutoProfile * self, int held);
+//Follows the view's allocation. Resizes are debounced, a profile change restarts the stream.
+void OnvifAutoProfile__set_view(OnvifAutoProfile * self, GtkWidget * view);
+void OnvifAutoProfile__set_device(OnvifAutoProfile * self, OnvifMgrDeviceRow * device);
+//Records the stream size of the device's current profile, then reevaluates the choice
+void OnvifAutoProfile__stream_started(OnvifAutoProfile * self, OnvifMgrDeviceRow * device, GstRtspPlayer * player);
+
+#endif
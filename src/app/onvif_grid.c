@@ -0,0 +1,497 @@
+#include "onvif_grid.h"
+#include "onvif_app.h"
+#include "../gst/gstrtspplayer.h"
+#include "clogger.h"
+#include "gui_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Tile retries back off from 2s up to 32s, same as the main player
+#define ONVIFGRID_RETRY_DELAY_MS 2000
+#define ONVIFGRID_RETRY_MAX_SHIFT 4
+#define ONVIFGRID_DND_TARGET "ONVIFMGR_DEVICEROW"
+
+typedef enum {
+    ONVIFGRID_TILE_IDLE,
+    ONVIFGRID_TILE_WAITING, //Assigned, waiting for a stream slot
+    ONVIFGRID_TILE_STARTING,
+    ONVIFGRID_TILE_PLAYING,
+    ONVIFGRID_TILE_RETRYING,
+    ONVIFGRID_TILE_FAILED
+} OnvifGridTileState;
+
+typedef enum {
+    ONVIFGRID_LOAD_STARTED,
+    ONVIFGRID_LOAD_SKIPPED, //Stop only, or superseded by a newer assignment
+    ONVIFGRID_LOAD_UNAUTHORIZED,
+    ONVIFGRID_LOAD_FAILED
+} OnvifGridLoadResult;
+
+typedef struct {
+    OnvifGrid * grid;
+    int index;
+    GstRtspPlayer * player; //Created with the first stream of the tile
+    GtkWidget * widget;
+    GtkWidget * canvas_box;
+    GtkWidget * label;
+    OnvifMgrDeviceRow * device;
+    OnvifGridTileState state;
+    int retry_count;
+    int generation; //Bumped on every assignment, so that results of previous streams are ignored
+} OnvifGridTile;
+
+typedef struct _OnvifGrid {
+    GtkWidget * widget;
+    GtkWidget * tiles_grid;
+    EventQueue * queue;
+    int pool;
+    int sink;
+    int size;
+    int max_streams;
+    int allow_overscale;
+    int recycle;
+    OnvifGridTile tiles[ONVIFGRID_TILE_COUNT];
+} OnvifGrid;
+
+//Copied along with the load task. The device reference is released by the continuation, or the cleanup callback if it is dropped.
+typedef struct {
+    OnvifGridTile * tile;
+    OnvifMgrDeviceRow * device;
+    int generation;
+} OnvifGridLoad;
+
+typedef struct {
+    OnvifGridTile * tile;
+    int generation;
+} OnvifGridRetry;
+
+static const GtkTargetEntry grid_targets[] = {
+    { ONVIFGRID_DND_TARGET, GTK_TARGET_SAME_APP, 0 }
+};
+
+static void priv_OnvifGrid__schedule(OnvifGrid * self);
+static void priv_OnvifGrid__release_tile(OnvifGridTile * tile);
+
+static int priv_OnvifGridTile__holds_slot(OnvifGridTile * tile){
+    return tile->state == ONVIFGRID_TILE_STARTING || tile->state == ONVIFGRID_TILE_PLAYING || tile->state == ONVIFGRID_TILE_RETRYING;
+}
+
+static void priv_OnvifGridTile__set_state(OnvifGridTile * tile, OnvifGridTileState state, const char * message){
+    tile->state = state;
+    if(!tile->device){
+        gtk_label_set_text(GTK_LABEL(tile->label), "Drop a device here");
+    } else if(message){
+        char text[256];
+        snprintf(text, sizeof(text), "%s - %s", OnvifMgrDeviceRow__get_name(tile->device), message);
+        gtk_label_set_text(GTK_LABEL(tile->label), text);
+    } else {
+        gtk_label_set_text(GTK_LABEL(tile->label), OnvifMgrDeviceRow__get_name(tile->device));
+    }
+}
+
+//Runs on a network worker. Every task of a tile shares its strand, so they never overlap on the player.
+void * _grid_load_stream(void * user_data){
+    OnvifGridLoad * load = (OnvifGridLoad *) user_data;
+    OnvifGridTile * tile = load->tile;
+
+    GstRtspPlayer__stop(tile->player);
+
+    if(!load->device || g_atomic_int_get(&tile->generation) != load->generation){
+        return GINT_TO_POINTER(ONVIFGRID_LOAD_SKIPPED);
+    }
+
+    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(load->device)){
+        C_TRAIL("_grid_load_stream - invalid device.");
+        return GINT_TO_POINTER(ONVIFGRID_LOAD_FAILED);
+    }
+
+    OnvifDevice * odev = OnvifMgrDeviceRow__get_device(load->device);
+    OnvifDevice__authenticate(odev);
+
+    if(QueueEvent__is_cancelled(QueueEvent__get_current()) || g_atomic_int_get(&tile->generation) != load->generation){
+        return GINT_TO_POINTER(ONVIFGRID_LOAD_SKIPPED);
+    } else if(OnvifDevice__get_last_error(odev) == ONVIF_ERROR_NOT_AUTHORIZED){
+        return GINT_TO_POINTER(ONVIFGRID_LOAD_UNAUTHORIZED);
+    } else if(OnvifDevice__get_last_error(odev) != ONVIF_ERROR_NONE){
+        return GINT_TO_POINTER(ONVIFGRID_LOAD_FAILED);
+    }
+
+    return GINT_TO_POINTER(OnvifApp__load_stream(load->device, tile->player) ? ONVIFGRID_LOAD_STARTED : ONVIFGRID_LOAD_FAILED);
+}
+
+void _grid_load_cleanup(void * user_data){
+    OnvifGridLoad * load = (OnvifGridLoad *) user_data;
+    if(load->device){
+        g_object_unref(load->device);
+    }
+}
+
+//Main thread
+void _grid_load_done(void * result, void * user_data){
+    OnvifGridLoad * load = (OnvifGridLoad *) user_data;
+    OnvifGridTile * tile = load->tile;
+    OnvifGridLoadResult status = GPOINTER_TO_INT(result);
+
+    if(load->generation == tile->generation && tile->state == ONVIFGRID_TILE_STARTING){
+        if(status == ONVIFGRID_LOAD_UNAUTHORIZED){
+            priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_FAILED, "Unauthorized");
+            priv_OnvifGrid__schedule(tile->grid);
+        } else if(status == ONVIFGRID_LOAD_FAILED){
+            priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_FAILED, "Unavailable");
+            priv_OnvifGrid__schedule(tile->grid);
+        }
+    }
+
+    _grid_load_cleanup(load);
+}
+
+void _grid_retry_stream(void * user_data){
+    OnvifGridRetry * retry = (OnvifGridRetry *) user_data;
+    //The tile was reassigned or cleared during the backoff delay
+    if(g_atomic_int_get(&retry->tile->generation) == retry->generation){
+        GstRtspPlayer__retry(retry->tile->player);
+    }
+}
+
+static EventQueueInsertResult priv_OnvifGrid__queue_load(OnvifGridTile * tile, OnvifMgrDeviceRow * device){
+    OnvifGrid * self = tile->grid;
+    OnvifGridLoad load;
+    load.tile = tile;
+    load.device = device ? g_object_ref(device) : NULL;
+    load.generation = tile->generation;
+
+    QueueEvent * evt = QueueEvent__create_future_copy(tile, _grid_load_stream, &load, sizeof(OnvifGridLoad));
+    QueueEvent__set_continuation(evt, self->sink, _grid_load_done, NULL);
+    QueueEvent__set_name(evt, "grid-stream");
+    QueueEvent__set_pool(evt, self->pool);
+    QueueEvent__set_priority(evt, EVENTQUEUE_PRIORITY_INTERACTIVE);
+    QueueEvent__set_strand(evt, 1);
+    //Only the latest pending assignment of the tile is worth starting
+    QueueEvent__set_coalesce(evt, NULL);
+    QueueEvent__set_cleanup_callback(evt, _grid_load_cleanup);
+    return EventQueue__insert_event(self->queue, evt);
+}
+
+static void priv_OnvifGrid__start_tile(OnvifGridTile * tile){
+    priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_STARTING, "Connecting...");
+    if(priv_OnvifGrid__queue_load(tile, tile->device) == EVENTQUEUE_INSERT_REJECTED){
+        C_WARN("Grid tile %d stream rejected, queue is full", tile->index);
+        priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_FAILED, "Queue full");
+    }
+}
+
+//Hands out free stream slots to waiting tiles, in tile order
+static void priv_OnvifGrid__schedule(OnvifGrid * self){
+    int active = 0;
+    int count = self->size * self->size;
+
+    for(int i=0;i<count;i++){
+        if(priv_OnvifGridTile__holds_slot(&self->tiles[i])){
+            active++;
+        }
+    }
+
+    for(int i=0;i<count && active < self->max_streams;i++){
+        if(self->tiles[i].state == ONVIFGRID_TILE_WAITING){
+            priv_OnvifGrid__start_tile(&self->tiles[i]);
+            if(priv_OnvifGridTile__holds_slot(&self->tiles[i])){
+                active++;
+            }
+        }
+    }
+}
+
+void OnvifGrid__player_started_cb(GstRtspPlayer * player, void * user_data){
+    OnvifGridTile * tile = (OnvifGridTile *) user_data;
+    if(!tile->device || !priv_OnvifGridTile__holds_slot(tile)){
+        return;
+    }
+    tile->retry_count = 0;
+    priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_PLAYING, NULL);
+}
+
+void OnvifGrid__player_retry_cb(GstRtspPlayer * player, void * user_data){
+    OnvifGridTile * tile = (OnvifGridTile *) user_data;
+    OnvifGridRetry retry;
+    if(!tile->device || !priv_OnvifGridTile__holds_slot(tile)){
+        return;
+    }
+
+    //Backoff is per tile, a flapping camera doesn't slow down the others
+    int delay = ONVIFGRID_RETRY_DELAY_MS << MIN(tile->retry_count,ONVIFGRID_RETRY_MAX_SHIFT);
+    tile->retry_count++;
+    C_DEBUG("Retrying grid tile %d in %d ms",tile->index,delay);
+    priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_RETRYING, "Reconnecting...");
+
+    retry.tile = tile;
+    retry.generation = tile->generation;
+    QueueEvent * evt = QueueEvent__create_copy(tile, _grid_retry_stream, &retry, sizeof(OnvifGridRetry));
+    QueueEvent__set_name(evt, "grid-retry");
+    QueueEvent__set_pool(evt, tile->grid->pool);
+    QueueEvent__set_priority(evt, EVENTQUEUE_PRIORITY_INTERACTIVE);
+    QueueEvent__set_strand(evt, 1);
+    if(EventQueue__schedule_event(tile->grid->queue, evt, delay) == EVENTQUEUE_INSERT_REJECTED){
+        C_WARN("Grid tile %d retry rejected, queue is full", tile->index);
+        priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_FAILED, "Queue full");
+        priv_OnvifGrid__schedule(tile->grid);
+    }
+}
+
+//The player gave up, only this tile is affected. Its slot goes to the next waiting tile.
+void OnvifGrid__player_error_cb(GstRtspPlayer * player, void * user_data){
+    OnvifGridTile * tile = (OnvifGridTile *) user_data;
+    if(!tile->device || !priv_OnvifGridTile__holds_slot(tile)){
+        return;
+    }
+    C_ERROR("Grid tile %d stream encountered an error", tile->index);
+    priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_FAILED, "Stream error");
+    priv_OnvifGrid__schedule(tile->grid);
+}
+
+static void priv_OnvifGrid__create_player(OnvifGridTile * tile){
+    tile->player = GstRtspPlayer__new();
+    GstRtspPlayer__set_allow_overscale(tile->player, tile->grid->allow_overscale);
+    GstRtspPlayer__set_recycle_pipeline(tile->player, tile->grid->recycle);
+    g_signal_connect (G_OBJECT(tile->player), "started", G_CALLBACK (OnvifGrid__player_started_cb), tile);
+    g_signal_connect (G_OBJECT(tile->player), "retry", G_CALLBACK (OnvifGrid__player_retry_cb), tile);
+    g_signal_connect (G_OBJECT(tile->player), "error", G_CALLBACK (OnvifGrid__player_error_cb), tile);
+
+    GtkWidget * canvas = GstRtspPlayer__createCanvas(tile->player);
+    gtk_widget_set_vexpand (canvas, TRUE);
+    gtk_widget_set_hexpand (canvas, TRUE);
+    gtk_box_pack_start(GTK_BOX(tile->canvas_box), canvas, TRUE, TRUE, 0);
+    gtk_widget_show(canvas);
+}
+
+//Stops the tile's stream if it had one going. The tile keeps its player for the next assignment.
+static void priv_OnvifGrid__release_tile(OnvifGridTile * tile){
+    int had_slot = priv_OnvifGridTile__holds_slot(tile);
+
+    g_atomic_int_inc(&tile->generation);
+    tile->retry_count = 0;
+    if(tile->device){
+        g_object_unref(tile->device);
+        tile->device = NULL;
+    }
+
+    if(had_slot && priv_OnvifGrid__queue_load(tile, NULL) == EVENTQUEUE_INSERT_REJECTED){
+        C_WARN("Grid tile %d stop rejected, queue is full", tile->index);
+    }
+    priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_IDLE, NULL);
+}
+
+void OnvifGrid__set_device(OnvifGrid * self, int index, OnvifMgrDeviceRow * device){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (index >= 0 && index < self->size * self->size);
+
+    OnvifGridTile * tile = &self->tiles[index];
+    priv_OnvifGrid__release_tile(tile);
+
+    if(ONVIFMGR_IS_DEVICEROW(device)){
+        C_INFO("Grid tile %d assigned to '%s'", index, OnvifMgrDeviceRow__get_name(device));
+        tile->device = g_object_ref(device);
+        if(!tile->player){
+            priv_OnvifGrid__create_player(tile);
+        }
+        priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_WAITING, "Waiting for a stream slot");
+    }
+
+    priv_OnvifGrid__schedule(self);
+}
+
+static void OnvifGrid__drag_data_received_cb(GtkWidget *widget, GdkDragContext *context, gint x, gint y, GtkSelectionData *data, guint info, guint time, OnvifGridTile * tile){
+    const guchar * raw = gtk_selection_data_get_data(data);
+    OnvifMgrDeviceRow * device = NULL;
+
+    if(raw && gtk_selection_data_get_length(data) == sizeof(OnvifMgrDeviceRow *)){
+        memcpy(&device, raw, sizeof(OnvifMgrDeviceRow *));
+    }
+
+    //GTK_DEST_DEFAULT_ALL finishes the drag on its own
+    if(ONVIFMGR_IS_DEVICEROW(device) && ONVIFMGR_DEVICEROWROW_HAS_OWNER(device)){
+        OnvifGrid__set_device(tile->grid, tile->index, device);
+    }
+}
+
+static void OnvifGrid__drag_data_get_cb(GtkWidget *widget, GdkDragContext *context, GtkSelectionData *data, guint info, guint time, gpointer user_data){
+    //Same application target, the row pointer is passed as is
+    gtk_selection_data_set(data, gdk_atom_intern_static_string(ONVIFGRID_DND_TARGET), 8, (const guchar *) &widget, sizeof(OnvifMgrDeviceRow *));
+}
+
+//Right click clears the tile
+static gboolean OnvifGrid__tile_button_cb(GtkWidget *widget, GdkEventButton *event, OnvifGridTile * tile){
+    if(event->type == GDK_BUTTON_PRESS && event->button == GDK_BUTTON_SECONDARY && tile->device){
+        OnvifGrid__set_device(tile->grid, tile->index, NULL);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void priv_OnvifGrid__create_tile(OnvifGrid * self, int index){
+    OnvifGridTile * tile = &self->tiles[index];
+    tile->grid = self;
+    tile->index = index;
+    tile->player = NULL;
+    tile->device = NULL;
+    tile->state = ONVIFGRID_TILE_IDLE;
+    tile->retry_count = 0;
+    tile->generation = 0;
+
+    tile->widget = gtk_event_box_new();
+    gtk_widget_set_vexpand (tile->widget, TRUE);
+    gtk_widget_set_hexpand (tile->widget, TRUE);
+    g_object_unref(gui_widget_set_css(tile->widget, "* { background-image:none; background-color:black; border: 1px solid #303030; }", NULL));
+
+    GtkWidget * overlay = gtk_overlay_new();
+    gtk_container_add(GTK_CONTAINER(tile->widget), overlay);
+
+    tile->canvas_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_container_add(GTK_CONTAINER(overlay), tile->canvas_box);
+
+    tile->label = gtk_label_new(NULL);
+    gtk_widget_set_halign(tile->label, GTK_ALIGN_START);
+    gtk_widget_set_valign(tile->label, GTK_ALIGN_END);
+    g_object_unref(gui_widget_set_css(tile->label, "* { color:white; background-color: rgba(0,0,0,0.5); padding: 2px; }", NULL));
+    gtk_overlay_add_overlay(GTK_OVERLAY(overlay), tile->label);
+    priv_OnvifGridTile__set_state(tile, ONVIFGRID_TILE_IDLE, NULL);
+
+    gtk_drag_dest_set(tile->widget, GTK_DEST_DEFAULT_ALL, grid_targets, G_N_ELEMENTS(grid_targets), GDK_ACTION_COPY);
+    g_signal_connect (tile->widget, "drag-data-received", G_CALLBACK (OnvifGrid__drag_data_received_cb), tile);
+    g_signal_connect (tile->widget, "button-press-event", G_CALLBACK (OnvifGrid__tile_button_cb), tile);
+
+    //Tiles are moved in and out of the grid on resize
+    g_object_ref_sink(tile->widget);
+    gtk_widget_show_all(tile->widget);
+}
+
+static void OnvifGrid__size_changed_cb(GtkComboBox *widget, OnvifGrid * self){
+    OnvifGrid__set_size(self, ONVIFGRID_MIN_SIZE + gtk_combo_box_get_active(widget));
+}
+
+OnvifGrid * OnvifGrid__create(EventQueue * queue, int pool, int sink){
+    OnvifGrid * self = malloc(sizeof(OnvifGrid));
+    self->queue = queue;
+    self->pool = pool;
+    self->sink = sink;
+    self->size = 0;
+    self->max_streams = ONVIFGRID_DEFAULT_MAX_STREAMS;
+    self->allow_overscale = 0;
+    self->recycle = 0;
+
+    self->widget = gtk_grid_new();
+
+    GtkWidget * hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new("Layout"), FALSE, FALSE, 0);
+    GtkWidget * combo = gtk_combo_box_text_new();
+    for(int i=ONVIFGRID_MIN_SIZE;i<=ONVIFGRID_MAX_SIZE;i++){
+        char text[8];
+        snprintf(text, sizeof(text), "%dx%d", i, i);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo), text);
+    }
+    gtk_box_pack_start(GTK_BOX(hbox), combo, FALSE, FALSE, 0);
+    gtk_grid_attach(GTK_GRID(self->widget), hbox, 0, 0, 1, 1);
+
+    self->tiles_grid = gtk_grid_new();
+    gtk_grid_set_row_homogeneous(GTK_GRID(self->tiles_grid), TRUE);
+    gtk_grid_set_column_homogeneous(GTK_GRID(self->tiles_grid), TRUE);
+    gtk_widget_set_vexpand (self->tiles_grid, TRUE);
+    gtk_widget_set_hexpand (self->tiles_grid, TRUE);
+    gtk_grid_attach(GTK_GRID(self->widget), self->tiles_grid, 0, 1, 1, 1);
+
+    for(int i=0;i<ONVIFGRID_TILE_COUNT;i++){
+        priv_OnvifGrid__create_tile(self, i);
+    }
+
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), 0);
+    OnvifGrid__set_size(self, ONVIFGRID_MIN_SIZE);
+    g_signal_connect (combo, "changed", G_CALLBACK (OnvifGrid__size_changed_cb), self);
+
+    return self;
+}
+
+void OnvifGrid__destroy(OnvifGrid* self){
+    if(!self){
+        return;
+    }
+
+    for(int i=0;i<ONVIFGRID_TILE_COUNT;i++){
+        OnvifGridTile * tile = &self->tiles[i];
+        if(tile->player){
+            g_signal_handlers_disconnect_by_data(tile->player, tile);
+            //Destroying the player will cause it to hang until its state changed to NULL
+            g_object_unref(tile->player);
+        }
+        if(tile->device){
+            g_object_unref(tile->device);
+        }
+        g_object_unref(tile->widget);
+    }
+    free(self);
+}
+
+GtkWidget * OnvifGrid__get_widget(OnvifGrid * self){
+    return self->widget;
+}
+
+void OnvifGrid__set_size(OnvifGrid * self, int size){
+    g_return_if_fail (self != NULL);
+    size = CLAMP(size, ONVIFGRID_MIN_SIZE, ONVIFGRID_MAX_SIZE);
+    if(size == self->size){
+        return;
+    }
+
+    for(int i=0;i<self->size * self->size;i++){
+        gtk_container_remove(GTK_CONTAINER(self->tiles_grid), self->tiles[i].widget);
+    }
+
+    //Hidden tiles don't keep decoding
+    for(int i=size * size;i<ONVIFGRID_TILE_COUNT;i++){
+        if(self->tiles[i].device){
+            priv_OnvifGrid__release_tile(&self->tiles[i]);
+        }
+    }
+
+    self->size = size;
+    for(int i=0;i<size * size;i++){
+        gtk_grid_attach(GTK_GRID(self->tiles_grid), self->tiles[i].widget, i % size, i / size, 1, 1);
+    }
+
+    priv_OnvifGrid__schedule(self);
+}
+
+int OnvifGrid__get_size(OnvifGrid * self){
+    return self->size;
+}
+
+void OnvifGrid__set_max_streams(OnvifGrid * self, int max_streams){
+    g_return_if_fail (self != NULL);
+    self->max_streams = MAX(max_streams, 1);
+    //Lowering the cap doesn't interrupt running streams, it only applies to the next starts
+    priv_OnvifGrid__schedule(self);
+}
+
+void OnvifGrid__set_allow_overscale(OnvifGrid * self, int allow_overscale){
+    g_return_if_fail (self != NULL);
+    self->allow_overscale = allow_overscale;
+    for(int i=0;i<ONVIFGRID_TILE_COUNT;i++){
+        if(self->tiles[i].player){
+            GstRtspPlayer__set_allow_overscale(self->tiles[i].player, allow_overscale);
+        }
+    }
+}
+
+void OnvifGrid__set_recycle_pipeline(OnvifGrid * self, int recycle){
+    g_return_if_fail (self != NULL);
+    self->recycle = recycle;
+    for(int i=0;i<ONVIFGRID_TILE_COUNT;i++){
+        if(self->tiles[i].player){
+            GstRtspPlayer__set_recycle_pipeline(self->tiles[i].player, recycle);
+        }
+    }
+}
+
+void OnvifGrid__add_drag_source(OnvifGrid * self, OnvifMgrDeviceRow * device){
+    gtk_drag_source_set(GTK_WIDGET(device), GDK_BUTTON1_MASK, grid_targets, G_N_ELEMENTS(grid_targets), GDK_ACTION_COPY);
+    g_signal_connect (device, "drag-data-get", G_CALLBACK (OnvifGrid__drag_data_get_cb), NULL);
+}
@@ -0,0 +1,35 @@
+#ifndef ONVIF_GRID_H_
+#define ONVIF_GRID_H_
+
+#include <gtk/gtk.h>
+#include "../queue/event_queue.h"
+#include "omgr_device_row.h"
+
+//Mosaic sizes, from 2x2 up to 6x6 tiles
+#define ONVIFGRID_MIN_SIZE 2
+#define ONVIFGRID_MAX_SIZE 6
+#define ONVIFGRID_TILE_COUNT (ONVIFGRID_MAX_SIZE * ONVIFGRID_MAX_SIZE)
+//Streams decoded at once. Tiles beyond the cap wait for a slot to free up.
+#define ONVIFGRID_DEFAULT_MAX_STREAMS 16
+
+typedef struct _OnvifGrid OnvifGrid;
+
+//Each tile owns a player. Tile tasks (stream start, stop and retries) run on the given worker pool,
+//serialized per tile, with their results delivered on the main thread through sink.
+OnvifGrid * OnvifGrid__create(EventQueue * queue, int pool, int sink);
+//Must be called once the queue is destroyed, players are stopped and released here
+void OnvifGrid__destroy(OnvifGrid* self);
+GtkWidget * OnvifGrid__get_widget(OnvifGrid * self);
+//Tiles no longer visible are cleared
+void OnvifGrid__set_size(OnvifGrid * self, int size);
+int OnvifGrid__get_size(OnvifGrid * self);
+void OnvifGrid__set_max_streams(OnvifGrid * self, int max_streams);
+void OnvifGrid__set_allow_overscale(OnvifGrid * self, int allow_overscale);
+//See GstRtspPlayer__set_recycle_pipeline
+void OnvifGrid__set_recycle_pipeline(OnvifGrid * self, int recycle);
+//Plays the device in the tile, replacing its previous stream. A NULL device clears the tile.
+void OnvifGrid__set_device(OnvifGrid * self, int tile, OnvifMgrDeviceRow * device);
+//Allows dragging the row onto a tile
+void OnvifGrid__add_drag_source(OnvifGrid * self, OnvifMgrDeviceRow * device);
+
+#endif
@@ -122,8 +122,34 @@ void OnvifInfoPanel__map_event_cb (GtkWidget* self, OnvifInfoPanel * info){
     }
 }
 
-gboolean * onvif_info_gui_update (void * user_data){
-    InfoGUIUpdate * update = (InfoGUIUpdate *) user_data;
+void onvif_info_gui_update_free(void * result){
+    InfoGUIUpdate * update = (InfoGUIUpdate *) result;
+    free(update->name);
+    free(update->hostname);
+    free(update->location);
+    free(update->manufacturer);
+    free(update->model);
+    free(update->hardware);
+    free(update->firmware);
+    free(update->serial);
+    free(update->ip);
+    for(int i=0;i<update->mac_count;i++){
+        free(update->macs[i]);
+    }
+    free(update->macs);
+    free(update->version);
+    free(update->uri);
+    free(update);
+}
+
+//Continuation of _update_details_page, invoked on the main thread. The result is released by the queue.
+void onvif_info_gui_update (void * result, void * user_data){
+    InfoGUIUpdate * update = (InfoGUIUpdate *) result;
+    InfoDataUpdate * input = (InfoDataUpdate *) user_data;
+
+    if(!update){
+        goto exit;
+    }
 
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(update->device)){
         C_TRAIL("onvif_info_gui_update - invalid device.");
@@ -190,28 +216,25 @@ gboolean * onvif_info_gui_update (void * user_data){
 
     g_signal_emit (update->info, signals[FINISHED], 0 /* details */);
 exit:
-    free(update->name);
-    free(update->hostname);
-    free(update->location);
-    free(update->manufacturer);
-    free(update->model);
-    free(update->hardware);
-    free(update->firmware);
-    free(update->serial);
-    free(update->ip);
-    for(int i=0;i<update->mac_count;i++){
-        free(update->macs[i]);
-    }
-    free(update->macs);
-    free(update->version);
-    free(update->uri);
-    g_object_unref(update->device);
-    free(update);
-    return FALSE;
+    g_object_unref(input->device);
+}
+
+void _update_details_cleanup(void * user_data){
+    InfoDataUpdate * input = (InfoDataUpdate *) user_data;
+    g_object_unref(input->device);
+}
+
+//Checked between requests, either the device changed or the task got cancelled
+static int _update_details_obsolete(InfoDataUpdate * input){
+    return !ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device) 
+        || !OnvifMgrDeviceRow__is_selected(input->device)
+        || QueueEvent__is_cancelled(QueueEvent__get_current());
 }
 
-void _update_details_page(void * user_data){
+//Returns the details to display, or NULL if the device is gone or no longer selected
+void * _update_details_page(void * user_data){
     char * hostname = NULL;
+    InfoGUIUpdate * gui_update = NULL;
     OnvifDeviceInformation * dev_info = NULL;
     OnvifInterfaces * interfaces = NULL;
     OnvifScopes * scopes = NULL;
@@ -220,7 +243,7 @@ void _update_details_page(void * user_data){
 
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device)){
         C_TRAIL("_update_details_page - invalid device.");
-        return;
+        return NULL;
     }
 
     if(!OnvifMgrDeviceRow__is_selected(input->device)){
@@ -234,25 +257,25 @@ void _update_details_page(void * user_data){
     OnvifDeviceService * devserv = OnvifDevice__get_device_service(onvif_device);
 
     hostname = OnvifDeviceService__getHostname(devserv);
-    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device) || !OnvifMgrDeviceRow__is_selected(input->device))
+    if(_update_details_obsolete(input))
         goto exit;
 
     dev_info = OnvifDeviceService__getDeviceInformation(devserv);
     if(OnvifDevice__get_last_error(onvif_device) == ONVIF_ERROR_NONE) ginfo_success = 1;
-    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device) || !OnvifMgrDeviceRow__is_selected(input->device))
+    if(_update_details_obsolete(input))
         goto exit;
 
     interfaces = OnvifDeviceService__getNetworkInterfaces(devserv);
     if(OnvifDevice__get_last_error(onvif_device) == ONVIF_ERROR_NONE) gnetwork_success = 1;
-    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device) || !OnvifMgrDeviceRow__is_selected(input->device))
+    if(_update_details_obsolete(input))
         goto exit;
 
     scopes = OnvifDeviceService__getScopes(devserv);
     if(OnvifDevice__get_last_error(onvif_device) == ONVIF_ERROR_NONE) gscopes_success = 1;
-    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device) || !OnvifMgrDeviceRow__is_selected(input->device))
+    if(_update_details_obsolete(input))
         goto exit;
 
-    InfoGUIUpdate * gui_update = malloc(sizeof(InfoGUIUpdate));
+    gui_update = malloc(sizeof(InfoGUIUpdate));
     gui_update->info = input->info;
     gui_update->device = input->device;
     gui_update->mac_count = 0;
@@ -325,14 +348,14 @@ void _update_details_page(void * user_data){
     strcpy(gui_update->version,"SomeName");
 
     gui_update->uri = OnvifDeviceService__get_endpoint(devserv);
-    g_object_ref(gui_update->device);
-    gdk_threads_add_idle(G_SOURCE_FUNC(onvif_info_gui_update),gui_update);
+    hostname = NULL; //Owned by gui_update
 exit:
+    free(hostname);
     OnvifDeviceInformation__destroy(dev_info);
     OnvifInterfaces__destroy(interfaces);
     OnvifScopes__destroy(scopes);
-    g_object_unref(input->device);
-    free(input);
+    //The device reference is released by the continuation, or the cleanup callback if it is dropped
+    return gui_update;
 }
 
 void OnvifInfoPanel_update_details(OnvifInfoPanel * self, OnvifMgrDeviceRow * device){
@@ -350,11 +373,11 @@ void OnvifInfoPanel_update_details(OnvifInfoPanel * self, OnvifMgrDeviceRow * de
 
     OnvifInfoPanelPrivate *priv = OnvifInfoPanel__get_instance_private (self);
 
-    InfoDataUpdate * input = malloc(sizeof(InfoDataUpdate));
-    input->device = device;
-    input->info = self;
+    InfoDataUpdate input;
+    input.device = device;
+    input.info = self;
     g_object_ref(device);
-    OnvifApp__dispatch(priv->app, device, _update_details_page,input);
+    OnvifApp__submit_copy(priv->app, device, _update_details_page,&input,sizeof(input),onvif_info_gui_update,onvif_info_gui_update_free,_update_details_cleanup);
 }
 
 void OnvifInfoPanel_clear_details(OnvifInfoPanel * self){
@@ -86,8 +86,14 @@ void OnvifNetworkPanel__map_event_cb (GtkWidget* self, OnvifNetworkPanel * info)
     }
 }
 
-gboolean * onvif_network_gui_update (void * user_data){
-    NetworkGUIUpdate * update = (NetworkGUIUpdate *) user_data;
+//Continuation of _update_network_page, invoked on the main thread. The result is released by the queue.
+void onvif_network_gui_update (void * result, void * user_data){
+    NetworkGUIUpdate * update = (NetworkGUIUpdate *) result;
+    NetworkDataUpdate * input = (NetworkDataUpdate *) user_data;
+    if(!update){
+        goto exit;
+    }
+
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(update->device)){
         C_TRAIL("onvif_info_gui_update - invalid device.");
         goto exit;
@@ -113,22 +119,26 @@ gboolean * onvif_network_gui_update (void * user_data){
 
     g_signal_emit (update->network, signals[FINISHED], 0 /* details */);
 exit:
-    g_object_unref(update->device);
-    free(update);
+    g_object_unref(input->device);
+}
 
-    return FALSE;
+void _update_network_cleanup(void * user_data){
+    NetworkDataUpdate * input = (NetworkDataUpdate *) user_data;
+    g_object_unref(input->device);
 }
 
-void _update_network_page(void * user_data){
+//Returns the details to display, or NULL if the device is gone or no longer selected.
+//The device reference is released by the continuation, or the cleanup callback if it is dropped.
+void * _update_network_page(void * user_data){
     NetworkDataUpdate * input = (NetworkDataUpdate *) user_data;
 
     if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(input->device)){
         C_TRAIL("_update_network_page - invalid device.");
-        return;
+        return NULL;
     }
 
     if(!OnvifMgrDeviceRow__is_selected(input->device)){
-        goto exit;
+        return NULL;
     }
 
     NetworkGUIUpdate * gui_update = malloc(sizeof(NetworkGUIUpdate));
@@ -136,12 +146,7 @@ void _update_network_page(void * user_data){
     gui_update->device = input->device;
     //TODO Fetch networking details
 
-    g_object_ref(input->device);
-    gdk_threads_add_idle(G_SOURCE_FUNC(onvif_network_gui_update),gui_update);
-
-exit:
-    g_object_unref(input->device);
-    free(input);
+    return gui_update;
 }
 
 void OnvifNetworkPanel_update_details(OnvifNetworkPanel * self, OnvifMgrDeviceRow * device){
@@ -159,11 +164,11 @@ void OnvifNetworkPanel_update_details(OnvifNetworkPanel * self, OnvifMgrDeviceRo
 
     OnvifNetworkPanelPrivate *priv = OnvifNetworkPanel__get_instance_private (self);
 
-    NetworkDataUpdate * input = malloc(sizeof(NetworkDataUpdate));
-    input->device = device;
-    input->network = self;
+    NetworkDataUpdate input;
+    input.device = device;
+    input.network = self;
     g_object_ref(device);
-    OnvifApp__dispatch(priv->app, device, _update_network_page,input);
+    OnvifApp__submit_copy(priv->app, device, _update_network_page,&input,sizeof(input),onvif_network_gui_update,free,_update_network_cleanup);
 }
 
 void OnvifNetworkPanel_clear_details(OnvifNetworkPanel * self){
@@ -1,21 +1,25 @@
 #include "onvif_nvt.h"
 #include "gtkstyledimage.h"
+#include <stdio.h>
+
+#define ONVIFNVT_STACK_KEY "onvif-nvt-stack"
 
 extern char _binary_microphone_png_size[];
 extern char _binary_microphone_png_start[];
 extern char _binary_microphone_png_end[];
 
-gboolean toggle_mic_release_cb (GtkWidget *widget, gpointer * p, GstRtspPlayer * player){
-    GstRtspPlayer__mic_mute(player,TRUE);
+//The displayed player changes when a standby session is brought up, the controls always act on the current one
+gboolean toggle_mic_release_cb (GtkWidget *widget, gpointer * p, GstRtspPlayer ** player){
+    GstRtspPlayer__mic_mute(*player,TRUE);
     return FALSE;
 }
 
-gboolean toggle_mic_press_cb (GtkWidget *widget, gpointer * p, GstRtspPlayer * player){
-    GstRtspPlayer__mic_mute(player,FALSE);
+gboolean toggle_mic_press_cb (GtkWidget *widget, gpointer * p, GstRtspPlayer ** player){
+    GstRtspPlayer__mic_mute(*player,FALSE);
     return FALSE;
 }
 
-GtkWidget * create_controls_overlay(GstRtspPlayer *player){ 
+GtkWidget * create_controls_overlay(GstRtspPlayer ** player){ 
     GtkWidget * image = GtkStyledImage__new((unsigned char *)_binary_microphone_png_start, _binary_microphone_png_end - _binary_microphone_png_start, 20, 20, NULL);
 
     GtkWidget * widget = gtk_button_new ();
@@ -29,16 +33,22 @@ GtkWidget * create_controls_overlay(GstRtspPlayer *player){
     return fixed;
 }
 
-GtkWidget * OnvifNVT__create_ui (GstRtspPlayer * player){
+static void priv_OnvifNVT__player_name(GstRtspPlayer * player, char * name, size_t size){
+    snprintf(name, size, "%p", (void *) player);
+}
+
+GtkWidget * OnvifNVT__create_ui (GstRtspPlayer ** player){
     GtkWidget *grid;
-    GtkWidget *widget;
+    GtkWidget *stack;
 
     grid = gtk_grid_new ();
-    widget = GstRtspPlayer__createCanvas(player);
-    gtk_widget_set_vexpand (widget, TRUE);
-    gtk_widget_set_hexpand (widget, TRUE);
+    //One canvas per player, only the displayed player's is visible
+    stack = gtk_stack_new ();
+    gtk_stack_set_transition_type (GTK_STACK (stack), GTK_STACK_TRANSITION_TYPE_NONE);
+    gtk_widget_set_vexpand (stack, TRUE);
+    gtk_widget_set_hexpand (stack, TRUE);
 
-    gtk_grid_attach (GTK_GRID (grid), widget, 0, 1, 1, 1);
+    gtk_grid_attach (GTK_GRID (grid), stack, 0, 1, 1, 1);
 
     GtkCssProvider * cssProvider = gtk_css_provider_new();
     gtk_css_provider_load_from_data(cssProvider, "* { background-image:none; background-color:black;}",-1,NULL); 
@@ -48,10 +58,32 @@ GtkWidget * OnvifNVT__create_ui (GstRtspPlayer * player){
 
     GtkWidget * overlay =gtk_overlay_new();
     gtk_container_add (GTK_CONTAINER (overlay), grid);
+    g_object_set_data (G_OBJECT (overlay), ONVIFNVT_STACK_KEY, stack);
 
-    widget = create_controls_overlay(player);
+    gtk_overlay_add_overlay(GTK_OVERLAY(overlay),create_controls_overlay(player));
 
-    gtk_overlay_add_overlay(GTK_OVERLAY(overlay),widget);
+    OnvifNVT__add_player(overlay, *player);
     return overlay;
 }
 
+void OnvifNVT__add_player(GtkWidget * nvt, GstRtspPlayer * player){
+    char name[32];
+    GtkWidget * stack = g_object_get_data (G_OBJECT (nvt), ONVIFNVT_STACK_KEY);
+    GtkWidget * widget = GstRtspPlayer__createCanvas(player);
+    gtk_widget_set_vexpand (widget, TRUE);
+    gtk_widget_set_hexpand (widget, TRUE);
+    //The player hides its canvas when stopped, the stack would then show another page. The box stays visible instead.
+    GtkWidget * page = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_pack_start (GTK_BOX (page), widget, TRUE, TRUE, 0);
+    priv_OnvifNVT__player_name(player, name, sizeof(name));
+    gtk_stack_add_named (GTK_STACK (stack), page, name);
+    gtk_widget_show (page);
+}
+
+void OnvifNVT__show_player(GtkWidget * nvt, GstRtspPlayer * player){
+    char name[32];
+    GtkWidget * stack = g_object_get_data (G_OBJECT (nvt), ONVIFNVT_STACK_KEY);
+    priv_OnvifNVT__player_name(player, name, sizeof(name));
+    gtk_stack_set_visible_child_name (GTK_STACK (stack), name);
+}
+
@@ -3,6 +3,10 @@
 
 #include "../gst/gstrtspplayer.h"
 
-GtkWidget * OnvifNVT__create_ui (GstRtspPlayer * player);
+//player points to the displayed player, it may be replaced by one added with OnvifNVT__add_player
+GtkWidget * OnvifNVT__create_ui (GstRtspPlayer ** player);
+//Adds the player's canvas, hidden until shown
+void OnvifNVT__add_player(GtkWidget * nvt, GstRtspPlayer * player);
+void OnvifNVT__show_player(GtkWidget * nvt, GstRtspPlayer * player);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,577 @@
+#include "onvif_prefetch.h"
+#include "onvif_app.h"
+#include "onvif_nvt.h"
+#include "clogger.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Previously selected devices kept as candidates
+#define ONVIFPREFETCH_HISTORY_SIZE 8
+//Paused sessions cost no bandwidth, only their negotiation does. Warm-ups run one at a time.
+#define ONVIFPREFETCH_CONCURRENT_WARMUPS 1
+//Decoded frames held by a session (decoder references and sink pool), used to estimate its memory
+#define ONVIFPREFETCH_FRAMES_PER_SESSION 8
+//Frame size assumed until the session reports its video size
+#define ONVIFPREFETCH_DEFAULT_FRAME_BYTES (1920 * 1080 * 3 / 2)
+#define ONVIFPREFETCH_REFRESH_INTERVAL_S 5
+#define ONVIFPREFETCH_CONNECT_TIMEOUT_US (15 * G_USEC_PER_SEC)
+//Cameras commonly expire idle RTSP sessions after 60s, paused sessions are renegotiated before that
+#define ONVIFPREFETCH_SESSION_TTL_US (50 * G_USEC_PER_SEC)
+//A device that failed to warm up isn't tried again before that
+#define ONVIFPREFETCH_RETRY_DELAY_US (30 * G_USEC_PER_SEC)
+
+typedef enum {
+    ONVIFPREFETCH_SLOT_IDLE,
+    ONVIFPREFETCH_SLOT_CONNECTING,
+    ONVIFPREFETCH_SLOT_READY,
+    ONVIFPREFETCH_SLOT_FAILED //Keeps the device until the retry delay expires
+} OnvifPrefetchSlotState;
+
+typedef enum {
+    ONVIFPREFETCH_LOAD_STARTED,
+    ONVIFPREFETCH_LOAD_SKIPPED, //Stop only, or superseded by a newer assignment
+    ONVIFPREFETCH_LOAD_FAILED
+} OnvifPrefetchLoadResult;
+
+typedef struct {
+    OnvifPrefetch * owner;
+    GstRtspPlayer * player; //Created on first use
+    OnvifMgrDeviceRow * device;
+    OnvifPrefetchSlotState state;
+    gint64 since; //Time of the last state change
+    size_t memory; //Estimated decoder memory of the session
+    int rank; //Position among the candidates, the last ones are evicted first
+    int generation; //Bumped on every assignment, so that results of previous sessions are ignored
+} OnvifPrefetchSlot;
+
+struct _OnvifPrefetch {
+    EventQueue * queue;
+    int pool;
+    int sink;
+    GtkWidget * nvt;
+    GtkWidget * listbox;
+    int sessions;
+    size_t memory_budget;
+    int allow_overscale;
+    int recycle;
+    guint refresh_source;
+    OnvifMgrDeviceRow * selected;
+    OnvifMgrDeviceRow * history[ONVIFPREFETCH_HISTORY_SIZE]; //Most recent first
+    OnvifPrefetchSlot slots[ONVIFPREFETCH_MAX_SESSIONS];
+};
+
+//Copied along with the load task. The player is captured since a swap may hand the slot another one.
+typedef struct {
+    OnvifPrefetchSlot * slot;
+    GstRtspPlayer * player;
+    OnvifMgrDeviceRow * device; //NULL to only stop
+    int generation;
+} OnvifPrefetchLoad;
+
+static void priv_OnvifPrefetch__schedule(OnvifPrefetch * self);
+
+static const char * priv_OnvifPrefetch__name(OnvifMgrDeviceRow * device){
+    const char * name = OnvifMgrDeviceRow__get_name(device);
+    return name && strlen(name) ? name : "Device";
+}
+
+//Runs on a network worker. Tasks of a slot share its strand, they never overlap on its player.
+void * _prefetch_load_stream(void * user_data){
+    OnvifPrefetchLoad * load = (OnvifPrefetchLoad *) user_data;
+
+    //The player may have been swapped in for display since
+    if(g_atomic_int_get(&load->slot->generation) != load->generation){
+        return GINT_TO_POINTER(ONVIFPREFETCH_LOAD_SKIPPED);
+    }
+
+    GstRtspPlayer__stop(load->player);
+
+    if(!load->device){
+        return GINT_TO_POINTER(ONVIFPREFETCH_LOAD_SKIPPED);
+    }
+
+    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(load->device)){
+        C_TRAIL("_prefetch_load_stream - invalid device.");
+        return GINT_TO_POINTER(ONVIFPREFETCH_LOAD_FAILED);
+    }
+
+    OnvifDevice * odev = OnvifMgrDeviceRow__get_device(load->device);
+    OnvifDevice__authenticate(odev);
+
+    if(QueueEvent__is_cancelled(QueueEvent__get_current()) || g_atomic_int_get(&load->slot->generation) != load->generation){
+        return GINT_TO_POINTER(ONVIFPREFETCH_LOAD_SKIPPED);
+    } else if(OnvifDevice__get_last_error(odev) != ONVIF_ERROR_NONE){
+        return GINT_TO_POINTER(ONVIFPREFETCH_LOAD_FAILED);
+    }
+
+    return GINT_TO_POINTER(OnvifApp__load_stream(load->device, load->player) ? ONVIFPREFETCH_LOAD_STARTED : ONVIFPREFETCH_LOAD_FAILED);
+}
+
+void _prefetch_load_cleanup(void * user_data){
+    OnvifPrefetchLoad * load = (OnvifPrefetchLoad *) user_data;
+    g_object_unref(load->player);
+    if(load->device){
+        g_object_unref(load->device);
+    }
+}
+
+static void priv_OnvifPrefetchSlot__set_state(OnvifPrefetchSlot * slot, OnvifPrefetchSlotState state){
+    slot->state = state;
+    slot->since = g_get_monotonic_time();
+}
+
+static void priv_OnvifPrefetchSlot__fail(OnvifPrefetchSlot * slot, const char * reason){
+    C_DEBUG("Prefetch of '%s' failed : %s", priv_OnvifPrefetch__name(slot->device), reason);
+    g_atomic_int_inc(&slot->generation);
+    slot->memory = 0;
+    priv_OnvifPrefetchSlot__set_state(slot, ONVIFPREFETCH_SLOT_FAILED);
+}
+
+//Main thread
+void _prefetch_load_done(void * result, void * user_data){
+    OnvifPrefetchLoad * load = (OnvifPrefetchLoad *) user_data;
+    OnvifPrefetchSlot * slot = load->slot;
+
+    if(load->generation == slot->generation && slot->state == ONVIFPREFETCH_SLOT_CONNECTING && GPOINTER_TO_INT(result) == ONVIFPREFETCH_LOAD_FAILED){
+        priv_OnvifPrefetchSlot__fail(slot, "device unavailable");
+        priv_OnvifPrefetch__schedule(slot->owner);
+    }
+
+    _prefetch_load_cleanup(load);
+}
+
+static EventQueueInsertResult priv_OnvifPrefetch__queue_load(OnvifPrefetchSlot * slot, OnvifMgrDeviceRow * device){
+    OnvifPrefetch * self = slot->owner;
+    OnvifPrefetchLoad load;
+    load.slot = slot;
+    load.player = g_object_ref(slot->player);
+    load.device = device ? g_object_ref(device) : NULL;
+    load.generation = slot->generation;
+
+    QueueEvent * evt = QueueEvent__create_future_copy(slot, _prefetch_load_stream, &load, sizeof(OnvifPrefetchLoad));
+    QueueEvent__set_continuation(evt, self->sink, _prefetch_load_done, NULL);
+    QueueEvent__set_name(evt, "stream-prefetch");
+    QueueEvent__set_pool(evt, self->pool);
+    //Never ahead of what the user is waiting for
+    QueueEvent__set_priority(evt, EVENTQUEUE_PRIORITY_BACKGROUND);
+    QueueEvent__set_strand(evt, 1);
+    //Every load stops the player first, only the latest one is worth running
+    QueueEvent__set_coalesce(evt, NULL);
+    QueueEvent__set_cleanup_callback(evt, _prefetch_load_cleanup);
+    return EventQueue__insert_event(self->queue, evt);
+}
+
+static size_t priv_OnvifPrefetchSlot__estimate_memory(OnvifPrefetchSlot * slot){
+    int width, height;
+    if(slot->player && GstRtspPlayer__get_video_size(slot->player, &width, &height)){
+        return (size_t) width * height * 3 / 2 * ONVIFPREFETCH_FRAMES_PER_SESSION;
+    }
+    return (size_t) ONVIFPREFETCH_DEFAULT_FRAME_BYTES * ONVIFPREFETCH_FRAMES_PER_SESSION;
+}
+
+static size_t priv_OnvifPrefetch__used_memory(OnvifPrefetch * self){
+    size_t used = 0;
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        if(self->slots[i].state == ONVIFPREFETCH_SLOT_CONNECTING || self->slots[i].state == ONVIFPREFETCH_SLOT_READY){
+            used += self->slots[i].memory;
+        }
+    }
+    return used;
+}
+
+//Negotiates the slot's session, the player pauses it once the first frame is shown
+static void priv_OnvifPrefetchSlot__start(OnvifPrefetchSlot * slot){
+    g_atomic_int_inc(&slot->generation);
+    slot->memory = priv_OnvifPrefetchSlot__estimate_memory(slot);
+    priv_OnvifPrefetchSlot__set_state(slot, ONVIFPREFETCH_SLOT_CONNECTING);
+    C_DEBUG("Prefetching '%s'", priv_OnvifPrefetch__name(slot->device));
+    if(priv_OnvifPrefetch__queue_load(slot, slot->device) == EVENTQUEUE_INSERT_REJECTED){
+        priv_OnvifPrefetchSlot__fail(slot, "queue full");
+    }
+}
+
+//Stops the slot's session if it had one going. The slot keeps its player for the next assignment.
+static void priv_OnvifPrefetchSlot__release(OnvifPrefetchSlot * slot){
+    int had_session = slot->state == ONVIFPREFETCH_SLOT_CONNECTING || slot->state == ONVIFPREFETCH_SLOT_READY;
+
+    g_atomic_int_inc(&slot->generation);
+    if(slot->device){
+        g_object_unref(slot->device);
+        slot->device = NULL;
+    }
+    slot->memory = 0;
+    priv_OnvifPrefetchSlot__set_state(slot, ONVIFPREFETCH_SLOT_IDLE);
+
+    if(had_session && priv_OnvifPrefetch__queue_load(slot, NULL) == EVENTQUEUE_INSERT_REJECTED){
+        C_WARN("Prefetch stop rejected, queue is full");
+    }
+}
+
+//The least likely candidates go first
+static void priv_OnvifPrefetch__enforce_budget(OnvifPrefetch * self){
+    while(priv_OnvifPrefetch__used_memory(self) > self->memory_budget){
+        OnvifPrefetchSlot * victim = NULL;
+        for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+            OnvifPrefetchSlot * slot = &self->slots[i];
+            if((slot->state == ONVIFPREFETCH_SLOT_CONNECTING || slot->state == ONVIFPREFETCH_SLOT_READY) && (!victim || slot->rank > victim->rank)){
+                victim = slot;
+            }
+        }
+        if(!victim){
+            break;
+        }
+        C_DEBUG("Prefetch memory budget exceeded, dropping '%s'", priv_OnvifPrefetch__name(victim->device));
+        priv_OnvifPrefetchSlot__release(victim);
+    }
+}
+
+void OnvifPrefetch__player_started_cb(GstRtspPlayer * player, void * user_data){
+    OnvifPrefetchSlot * slot = (OnvifPrefetchSlot *) user_data;
+    if(slot->state == ONVIFPREFETCH_SLOT_CONNECTING){
+        slot->memory = priv_OnvifPrefetchSlot__estimate_memory(slot);
+        priv_OnvifPrefetchSlot__set_state(slot, ONVIFPREFETCH_SLOT_READY);
+        C_DEBUG("Prefetched '%s', ~%zu MB", priv_OnvifPrefetch__name(slot->device), slot->memory / (1024 * 1024));
+        priv_OnvifPrefetch__enforce_budget(slot->owner);
+        priv_OnvifPrefetch__schedule(slot->owner);
+    } else if(slot->state != ONVIFPREFETCH_SLOT_READY){
+        //A session started after its slot was released, e.g. a stream of the previously displayed device
+        if(priv_OnvifPrefetch__queue_load(slot, NULL) == EVENTQUEUE_INSERT_REJECTED){
+            C_WARN("Prefetch stop rejected, queue is full");
+        }
+    }
+}
+
+//Standby sessions don't retry, the device waits for the retry delay instead of keeping the camera busy
+void OnvifPrefetch__player_failed_cb(GstRtspPlayer * player, void * user_data){
+    OnvifPrefetchSlot * slot = (OnvifPrefetchSlot *) user_data;
+    if(slot->state != ONVIFPREFETCH_SLOT_CONNECTING && slot->state != ONVIFPREFETCH_SLOT_READY){
+        return;
+    }
+    priv_OnvifPrefetchSlot__fail(slot, "stream error");
+    if(priv_OnvifPrefetch__queue_load(slot, NULL) == EVENTQUEUE_INSERT_REJECTED){
+        C_WARN("Prefetch stop rejected, queue is full");
+    }
+    priv_OnvifPrefetch__schedule(slot->owner);
+}
+
+static void priv_OnvifPrefetchSlot__attach(OnvifPrefetchSlot * slot){
+    g_signal_connect (G_OBJECT(slot->player), "started", G_CALLBACK (OnvifPrefetch__player_started_cb), slot);
+    g_signal_connect (G_OBJECT(slot->player), "retry", G_CALLBACK (OnvifPrefetch__player_failed_cb), slot);
+    g_signal_connect (G_OBJECT(slot->player), "error", G_CALLBACK (OnvifPrefetch__player_failed_cb), slot);
+}
+
+static void priv_OnvifPrefetchSlot__create_player(OnvifPrefetchSlot * slot){
+    OnvifPrefetch * self = slot->owner;
+    slot->player = GstRtspPlayer__new();
+    GstRtspPlayer__set_allow_overscale(slot->player, self->allow_overscale);
+    GstRtspPlayer__set_recycle_pipeline(slot->player, self->recycle);
+    GstRtspPlayer__set_standby(slot->player, TRUE);
+    priv_OnvifPrefetchSlot__attach(slot);
+    //Hidden until swapped in, the paused session's last frame is shown right away
+    OnvifNVT__add_player(self->nvt, slot->player);
+}
+
+static int priv_OnvifPrefetch__is_eligible(OnvifPrefetch * self, OnvifMgrDeviceRow * device){
+    if(!ONVIFMGR_IS_DEVICEROW(device) || device == self->selected || !ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) || !OnvifMgrDeviceRow__is_initialized(device)){
+        return FALSE;
+    }
+    return OnvifDevice__get_last_error(OnvifMgrDeviceRow__get_device(device)) == ONVIF_ERROR_NONE;
+}
+
+static void priv_OnvifPrefetch__add_candidate(OnvifPrefetch * self, OnvifMgrDeviceRow ** candidates, int * count, OnvifMgrDeviceRow * device){
+    if(*count >= self->sessions || !priv_OnvifPrefetch__is_eligible(self, device)){
+        return;
+    }
+    for(int i=0;i<*count;i++){
+        if(candidates[i] == device){
+            return;
+        }
+    }
+    candidates[(*count)++] = device;
+}
+
+//The last selected device first, to switch back and forth, then the neighbouring rows, then older selections
+static int priv_OnvifPrefetch__collect(OnvifPrefetch * self, OnvifMgrDeviceRow ** candidates){
+    int count = 0;
+    priv_OnvifPrefetch__add_candidate(self, candidates, &count, self->history[0]);
+    if(self->selected && ONVIFMGR_DEVICEROWROW_HAS_OWNER(self->selected)){
+        int index = gtk_list_box_row_get_index(GTK_LIST_BOX_ROW(self->selected));
+        if(index >= 0){
+            priv_OnvifPrefetch__add_candidate(self, candidates, &count, (OnvifMgrDeviceRow *) gtk_list_box_get_row_at_index(GTK_LIST_BOX(self->listbox), index + 1));
+            if(index > 0){
+                priv_OnvifPrefetch__add_candidate(self, candidates, &count, (OnvifMgrDeviceRow *) gtk_list_box_get_row_at_index(GTK_LIST_BOX(self->listbox), index - 1));
+            }
+        }
+    }
+    for(int i=1;i<ONVIFPREFETCH_HISTORY_SIZE;i++){
+        priv_OnvifPrefetch__add_candidate(self, candidates, &count, self->history[i]);
+    }
+    return count;
+}
+
+static int priv_OnvifPrefetch__warming(OnvifPrefetch * self){
+    int warming = 0;
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        if(self->slots[i].state == ONVIFPREFETCH_SLOT_CONNECTING){
+            warming++;
+        }
+    }
+    return warming;
+}
+
+//Releases slots that are no longer candidates and warms up the missing ones, within the budget
+static void priv_OnvifPrefetch__schedule(OnvifPrefetch * self){
+    OnvifMgrDeviceRow * candidates[ONVIFPREFETCH_MAX_SESSIONS];
+    int count = self->nvt ? priv_OnvifPrefetch__collect(self, candidates) : 0;
+
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        OnvifPrefetchSlot * slot = &self->slots[i];
+        if(!slot->device){
+            continue;
+        }
+        slot->rank = -1;
+        for(int c=0;c<count;c++){
+            if(candidates[c] == slot->device){
+                slot->rank = c;
+                break;
+            }
+        }
+        if(slot->rank < 0 || i >= self->sessions){
+            priv_OnvifPrefetchSlot__release(slot);
+        }
+    }
+
+    int warming = priv_OnvifPrefetch__warming(self);
+    for(int c=0;c<count && warming < ONVIFPREFETCH_CONCURRENT_WARMUPS;c++){
+        OnvifPrefetchSlot * free_slot = NULL;
+        int assigned = 0;
+        for(int i=0;i<self->sessions;i++){
+            if(self->slots[i].device == candidates[c]){
+                assigned = 1;
+                break;
+            } else if(!free_slot && self->slots[i].state == ONVIFPREFETCH_SLOT_IDLE){
+                free_slot = &self->slots[i];
+            }
+        }
+        if(assigned){
+            continue;
+        }
+        if(!free_slot || priv_OnvifPrefetch__used_memory(self) + (size_t) ONVIFPREFETCH_DEFAULT_FRAME_BYTES * ONVIFPREFETCH_FRAMES_PER_SESSION > self->memory_budget){
+            break;
+        }
+
+        if(!free_slot->player){
+            priv_OnvifPrefetchSlot__create_player(free_slot);
+        }
+        free_slot->device = g_object_ref(candidates[c]);
+        free_slot->rank = c;
+        priv_OnvifPrefetchSlot__start(free_slot);
+        warming = priv_OnvifPrefetch__warming(self);
+    }
+}
+
+//Expires stuck warm-ups and failures, and renegotiates paused sessions before the camera drops them
+static gboolean priv_OnvifPrefetch__refresh(gpointer user_data){
+    OnvifPrefetch * self = (OnvifPrefetch *) user_data;
+    gint64 now = g_get_monotonic_time();
+
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        OnvifPrefetchSlot * slot = &self->slots[i];
+        if(slot->state == ONVIFPREFETCH_SLOT_CONNECTING && now - slot->since > ONVIFPREFETCH_CONNECT_TIMEOUT_US){
+            priv_OnvifPrefetchSlot__fail(slot, "timeout");
+            if(priv_OnvifPrefetch__queue_load(slot, NULL) == EVENTQUEUE_INSERT_REJECTED){
+                C_WARN("Prefetch stop rejected, queue is full");
+            }
+        } else if(slot->state == ONVIFPREFETCH_SLOT_FAILED && now - slot->since > ONVIFPREFETCH_RETRY_DELAY_US){
+            priv_OnvifPrefetchSlot__release(slot);
+        } else if(slot->state == ONVIFPREFETCH_SLOT_READY && now - slot->since > ONVIFPREFETCH_SESSION_TTL_US && priv_OnvifPrefetch__warming(self) < ONVIFPREFETCH_CONCURRENT_WARMUPS){
+            priv_OnvifPrefetchSlot__start(slot);
+        }
+    }
+
+    //Also picks up rows initialized or removed since the last selection
+    priv_OnvifPrefetch__schedule(self);
+    return G_SOURCE_CONTINUE;
+}
+
+OnvifPrefetch * OnvifPrefetch__create(EventQueue * queue, int pool, int sink){
+    OnvifPrefetch * self = malloc(sizeof(OnvifPrefetch));
+    memset(self, 0, sizeof(OnvifPrefetch));
+    self->queue = queue;
+    self->pool = pool;
+    self->sink = sink;
+    self->memory_budget = 0;
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        self->slots[i].owner = self;
+        self->slots[i].state = ONVIFPREFETCH_SLOT_IDLE;
+    }
+    return self;
+}
+
+void OnvifPrefetch__destroy(OnvifPrefetch * self){
+    if(!self){
+        return;
+    }
+
+    if(self->refresh_source){
+        g_source_remove(self->refresh_source);
+    }
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        OnvifPrefetchSlot * slot = &self->slots[i];
+        if(slot->player){
+            g_signal_handlers_disconnect_by_data(slot->player, slot);
+            //Destroying the player will cause it to hang until its state changed to NULL
+            g_object_unref(slot->player);
+        }
+        if(slot->device){
+            g_object_unref(slot->device);
+        }
+    }
+    for(int i=0;i<ONVIFPREFETCH_HISTORY_SIZE;i++){
+        if(self->history[i]){
+            g_object_unref(self->history[i]);
+        }
+    }
+    if(self->selected){
+        g_object_unref(self->selected);
+    }
+    free(self);
+}
+
+void OnvifPrefetch__set_view(OnvifPrefetch * self, GtkWidget * nvt, GtkWidget * listbox){
+    g_return_if_fail (self != NULL);
+    self->nvt = nvt;
+    self->listbox = listbox;
+}
+
+void OnvifPrefetch__set_budget(OnvifPrefetch * self, int sessions, int memory_mb){
+    g_return_if_fail (self != NULL);
+    self->sessions = CLAMP(sessions, 0, ONVIFPREFETCH_MAX_SESSIONS);
+    self->memory_budget = (size_t) MAX(memory_mb, 0) * 1024 * 1024;
+    C_INFO("Stream prefetch : %d sessions, %d MB", self->sessions, memory_mb);
+
+    if(self->sessions > 0 && !self->refresh_source){
+        self->refresh_source = g_timeout_add_seconds(ONVIFPREFETCH_REFRESH_INTERVAL_S, priv_OnvifPrefetch__refresh, self);
+    } else if(self->sessions == 0 && self->refresh_source){
+        g_source_remove(self->refresh_source);
+        self->refresh_source = 0;
+    }
+
+    priv_OnvifPrefetch__schedule(self);
+    priv_OnvifPrefetch__enforce_budget(self);
+}
+
+void OnvifPrefetch__set_allow_overscale(OnvifPrefetch * self, int allow_overscale){
+    g_return_if_fail (self != NULL);
+    self->allow_overscale = allow_overscale;
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        if(self->slots[i].player){
+            GstRtspPlayer__set_allow_overscale(self->slots[i].player, allow_overscale);
+        }
+    }
+}
+
+void OnvifPrefetch__set_recycle_pipeline(OnvifPrefetch * self, int recycle){
+    g_return_if_fail (self != NULL);
+    self->recycle = recycle;
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        if(self->slots[i].player){
+            GstRtspPlayer__set_recycle_pipeline(self->slots[i].player, recycle);
+        }
+    }
+}
+
+void OnvifPrefetch__update(OnvifPrefetch * self, OnvifMgrDeviceRow * selected){
+    g_return_if_fail (self != NULL);
+
+    if(selected != self->selected){
+        OnvifMgrDeviceRow * previous = self->selected;
+        self->selected = selected ? g_object_ref(selected) : NULL;
+        if(previous){
+            //Moved to the front, the reference is handed over to the history
+            int last = ONVIFPREFETCH_HISTORY_SIZE - 1;
+            for(int i=0;i<ONVIFPREFETCH_HISTORY_SIZE;i++){
+                if(self->history[i] == previous){
+                    g_object_unref(previous);
+                    last = i;
+                    break;
+                }
+            }
+            if(last == ONVIFPREFETCH_HISTORY_SIZE - 1 && self->history[last] && self->history[last] != previous){
+                g_object_unref(self->history[last]);
+            }
+            memmove(&self->history[1], &self->history[0], sizeof(OnvifMgrDeviceRow *) * last);
+            self->history[0] = previous;
+        }
+    }
+
+    //Rows removed by a rescan are forgotten
+    for(int i=0;i<ONVIFPREFETCH_HISTORY_SIZE;i++){
+        if(self->history[i] && !ONVIFMGR_DEVICEROWROW_HAS_OWNER(self->history[i])){
+            g_object_unref(self->history[i]);
+            memmove(&self->history[i], &self->history[i+1], sizeof(OnvifMgrDeviceRow *) * (ONVIFPREFETCH_HISTORY_SIZE - i - 1));
+            self->history[ONVIFPREFETCH_HISTORY_SIZE - 1] = NULL;
+            i--;
+        }
+    }
+
+    priv_OnvifPrefetch__schedule(self);
+}
+
+GstRtspPlayer * OnvifPrefetch__swap(OnvifPrefetch * self, OnvifMgrDeviceRow * device, GstRtspPlayer * player, OnvifMgrDeviceRow * previous){
+    g_return_val_if_fail (self != NULL, NULL);
+
+    OnvifPrefetchSlot * slot = NULL;
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS && device;i++){
+        if(self->slots[i].device == device){
+            slot = &self->slots[i];
+            break;
+        }
+    }
+
+    if(!slot){
+        return NULL;
+    } else if(slot->state != ONVIFPREFETCH_SLOT_READY){
+        //The regular start takes over, the camera shouldn't negotiate the same stream twice
+        priv_OnvifPrefetchSlot__release(slot);
+        return NULL;
+    }
+
+    GstRtspPlayer * standby = slot->player;
+    g_signal_handlers_disconnect_by_data(standby, slot);
+    g_atomic_int_inc(&slot->generation);
+    g_object_unref(slot->device);
+    slot->device = NULL;
+
+    //The displaced player takes the slot. A started stream is kept paused, in case the user switches back.
+    slot->player = player;
+    priv_OnvifPrefetchSlot__attach(slot);
+    GstRtspPlayer__set_standby(player, TRUE);
+    if(ONVIFMGR_IS_DEVICEROW(previous) && ONVIFMGR_DEVICEROWROW_HAS_OWNER(previous) && GstRtspPlayer__is_started(player)){
+        slot->device = g_object_ref(previous);
+        slot->memory = priv_OnvifPrefetchSlot__estimate_memory(slot);
+        slot->rank = 0;
+        priv_OnvifPrefetchSlot__set_state(slot, ONVIFPREFETCH_SLOT_READY);
+        priv_OnvifPrefetch__enforce_budget(self);
+    } else {
+        slot->memory = 0;
+        priv_OnvifPrefetchSlot__set_state(slot, ONVIFPREFETCH_SLOT_IDLE);
+        if(priv_OnvifPrefetch__queue_load(slot, NULL) == EVENTQUEUE_INSERT_REJECTED){
+            C_WARN("Prefetch stop rejected, queue is full");
+        }
+    }
+
+    GstRtspPlayer__set_standby(standby, FALSE);
+    C_INFO("Switched to the prefetched stream of '%s'", priv_OnvifPrefetch__name(device));
+    return standby;
+}
+
+void OnvifPrefetch__forget(OnvifPrefetch * self, OnvifMgrDeviceRow * device){
+    g_return_if_fail (self != NULL);
+    for(int i=0;i<ONVIFPREFETCH_MAX_SESSIONS;i++){
+        if(self->slots[i].device == device){
+            priv_OnvifPrefetchSlot__release(&self->slots[i]);
+        }
+    }
+    priv_OnvifPrefetch__schedule(self);
+}
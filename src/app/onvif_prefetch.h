@@ -0,0 +1,33 @@
+#ifndef ONVIF_PREFETCH_H_
+#define ONVIF_PREFETCH_H_
+
+#include <gtk/gtk.h>
+#include "../queue/event_queue.h"
+#include "../gst/gstrtspplayer.h"
+#include "omgr_device_row.h"
+
+//Upper bound of the sessions setting
+#define ONVIFPREFETCH_MAX_SESSIONS 8
+
+typedef struct _OnvifPrefetch OnvifPrefetch;
+
+//Keeps paused sessions of the devices likely to be selected next: the previously selected ones, then the rows around the selection.
+//Sessions are negotiated on the given worker pool and their results delivered on the main thread through sink.
+OnvifPrefetch * OnvifPrefetch__create(EventQueue * queue, int pool, int sink);
+//Must be called once the queue is destroyed, standby players are released here
+void OnvifPrefetch__destroy(OnvifPrefetch * self);
+//Standby canvases are added to the NVT view, candidates are looked up in the listbox
+void OnvifPrefetch__set_view(OnvifPrefetch * self, GtkWidget * nvt, GtkWidget * listbox);
+//sessions set to 0 disables prefetching. memory_mb bounds the estimated decoder memory of the standby sessions.
+void OnvifPrefetch__set_budget(OnvifPrefetch * self, int sessions, int memory_mb);
+void OnvifPrefetch__set_allow_overscale(OnvifPrefetch * self, int allow_overscale);
+void OnvifPrefetch__set_recycle_pipeline(OnvifPrefetch * self, int recycle);
+//Records the selection and warms up the next candidates
+void OnvifPrefetch__update(OnvifPrefetch * self, OnvifMgrDeviceRow * selected);
+//Returns the resumed standby player of device, or NULL if it has no ready session.
+//On success, player takes its place and keeps its session in standby for previous. Both players change owner.
+GstRtspPlayer * OnvifPrefetch__swap(OnvifPrefetch * self, OnvifMgrDeviceRow * device, GstRtspPlayer * player, OnvifMgrDeviceRow * previous);
+//Drops the device's standby session, e.g. after a profile change
+void OnvifPrefetch__forget(OnvifPrefetch * self, OnvifMgrDeviceRow * device);
+
+#endif
@@ -0,0 +1,308 @@
+#include "onvif_stream_monitor.h"
+#include "clogger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ONVIFSTREAMMONITOR_SAMPLE_INTERVAL_MS 1000
+//Session setup bursts packets and the decoder waits for a keyframe, the first seconds aren't representative
+#define ONVIFSTREAMMONITOR_GRACE_US ((gint64) 5 * G_USEC_PER_SEC)
+//Degradation is sustained once that many of the last samples were bad
+#define ONVIFSTREAMMONITOR_WINDOW 5
+#define ONVIFSTREAMMONITOR_BAD_SAMPLES 4
+//Lost and late packets. Below the minimum packet count a sample is too noisy to tell.
+#define ONVIFSTREAMMONITOR_LOSS_RATIO 0.02
+#define ONVIFSTREAMMONITOR_MIN_PACKETS 20
+//rtspsrc runs without jitterbuffer latency, jitter shows right away as stutter
+#define ONVIFSTREAMMONITOR_JITTER_US 80000
+//Frames rendered far behind the clock, the decoder can't keep up
+#define ONVIFSTREAMMONITOR_LATE_FRAME_RATIO 0.5
+#define ONVIFSTREAMMONITOR_DROP_RATIO 0.1
+//Time without a bad sample before stepping back up. Doubled each time a step up degrades again within it.
+#define ONVIFSTREAMMONITOR_STABLE_US ((gint64) 60 * G_USEC_PER_SEC)
+#define ONVIFSTREAMMONITOR_STABLE_MAX_SHIFT 3
+#define ONVIFSTREAMMONITOR_MAX_STEPS 8
+
+struct _OnvifStreamMonitor {
+    int enabled;
+    guint source;
+    OnvifMgrDeviceRow * device;
+    GstRtspPlayer * player;
+    gint64 session_start; //0 until the device's stream started
+    GstRtspPlayerStats last;
+    int window[ONVIFSTREAMMONITOR_WINDOW]; //1 for a bad sample
+    int window_index;
+    char cause[160]; //Of the last bad sample
+    gint64 last_bad;
+    gint64 last_step_up;
+    int stable_shift;
+    int locked_reported;
+    //Profiles stepped down from, the last one is restored first
+    int steps[ONVIFSTREAMMONITOR_MAX_STEPS];
+    int step_count;
+    void (*held_callback)(int held, void * user_data);
+    void * user_data;
+};
+
+static const char * priv_OnvifStreamMonitor__name(OnvifMgrDeviceRow * device){
+    const char * name = OnvifMgrDeviceRow__get_name(device);
+    return name && strlen(name) ? name : "Device";
+}
+
+static void priv_OnvifStreamMonitor__reset_window(OnvifStreamMonitor * self){
+    memset(self->window, 0, sizeof(self->window));
+    self->window_index = 0;
+}
+
+//Lower resolution stands for lower bitrate, the media service doesn't report encoder bitrates.
+//Falls back on the next profile, cameras list their sub streams after the main one.
+static int priv_OnvifStreamMonitor__lower_profile(OnvifMgrDeviceRow * device, int current){
+    int width, height;
+    int target = -1;
+    if(OnvifMgrDeviceRow__get_profile_size(device, current, &width, &height)){
+        long area = (long) width * height;
+        long best_area = 0;
+        for(int i=0;i<OnvifMgrDeviceRow__get_profile_count(device);i++){
+            if(OnvifMgrDeviceRow__get_profile_size(device, i, &width, &height) && (long) width * height < area && (long) width * height > best_area){
+                target = i;
+                best_area = (long) width * height;
+            }
+        }
+    }
+    if(target < 0 && current + 1 < OnvifMgrDeviceRow__get_profile_count(device)){
+        target = current + 1;
+    }
+    return target;
+}
+
+static void priv_OnvifStreamMonitor__set_profile(OnvifMgrDeviceRow * device, int index){
+    OnvifProfile * profile = OnvifMgrDeviceRow__get_profile_at(device, index);
+    if(profile){
+        //Restarts the stream through the regular profile change
+        OnvifMgrDeviceRow__set_profile(device, profile);
+    }
+}
+
+//Gives back the profile stepped down from, used when the device is left or monitoring is turned off
+static void priv_OnvifStreamMonitor__restore(OnvifStreamMonitor * self){
+    if(!self->step_count){
+        return;
+    }
+
+    if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(self->device) && !OnvifMgrDeviceRow__is_profile_locked(self->device)){
+        OnvifProfile * profile = OnvifMgrDeviceRow__get_profile_at(self->device, self->steps[0]);
+        C_INFO("Stream of '%s' restored to profile '%s'", priv_OnvifStreamMonitor__name(self->device), profile ? OnvifProfile__get_name(profile) : "?");
+        priv_OnvifStreamMonitor__set_profile(self->device, self->steps[0]);
+    }
+    self->step_count = 0;
+    self->stable_shift = 0;
+    if(self->held_callback){
+        self->held_callback(FALSE, self->user_data);
+    }
+}
+
+static void priv_OnvifStreamMonitor__step_down(OnvifStreamMonitor * self, gint64 now){
+    OnvifMgrDeviceRow * device = self->device;
+    OnvifProfile * profile = OnvifMgrDeviceRow__get_profile(device);
+    if(!profile){
+        return;
+    }
+
+    if(OnvifMgrDeviceRow__is_profile_locked(device)){
+        if(!self->locked_reported){
+            C_WARN("Stream of '%s' degraded (%s), its profile was picked by hand", priv_OnvifStreamMonitor__name(device), self->cause);
+            self->locked_reported = 1;
+        }
+        return;
+    }
+
+    int current = OnvifProfile__get_index(profile);
+    int target = priv_OnvifStreamMonitor__lower_profile(device, current);
+    if(target < 0 || self->step_count >= ONVIFSTREAMMONITOR_MAX_STEPS){
+        if(!self->locked_reported){
+            C_WARN("Stream of '%s' degraded (%s), no lighter profile left", priv_OnvifStreamMonitor__name(device), self->cause);
+            self->locked_reported = 1;
+        }
+        return;
+    }
+
+    //A step up that didn't hold, wait longer before the next one
+    if(self->last_step_up && now - self->last_step_up < (ONVIFSTREAMMONITOR_STABLE_US << self->stable_shift) * 2){
+        self->stable_shift = MIN(self->stable_shift + 1, ONVIFSTREAMMONITOR_STABLE_MAX_SHIFT);
+    }
+
+    C_WARN("Stream of '%s' degraded (%s), stepping down from '%s' to '%s'", priv_OnvifStreamMonitor__name(device), self->cause,
+            OnvifProfile__get_name(profile), OnvifProfile__get_name(OnvifMgrDeviceRow__get_profile_at(device, target)));
+    self->steps[self->step_count++] = current;
+    self->session_start = 0;
+    if(self->held_callback){
+        self->held_callback(TRUE, self->user_data);
+    }
+    priv_OnvifStreamMonitor__set_profile(device, target);
+}
+
+static void priv_OnvifStreamMonitor__step_up(OnvifStreamMonitor * self, gint64 now){
+    OnvifMgrDeviceRow * device = self->device;
+    int target = self->steps[--self->step_count];
+    OnvifProfile * profile = OnvifMgrDeviceRow__get_profile_at(device, target);
+
+    C_INFO("Stream of '%s' stable for %" G_GINT64_FORMAT " s, stepping back up to '%s'", priv_OnvifStreamMonitor__name(device),
+            (now - MAX(self->last_bad, self->session_start)) / G_USEC_PER_SEC, profile ? OnvifProfile__get_name(profile) : "?");
+    self->last_step_up = now;
+    self->session_start = 0;
+    priv_OnvifStreamMonitor__set_profile(device, target);
+    if(!self->step_count && self->held_callback){
+        self->held_callback(FALSE, self->user_data);
+    }
+}
+
+//Returns TRUE if the sample crossed any threshold, the cause is kept for the logs
+static gboolean priv_OnvifStreamMonitor__is_bad(OnvifStreamMonitor * self, GstRtspPlayerStats * stats){
+    guint64 packets = stats->packets - self->last.packets;
+    guint64 lost = (stats->lost - self->last.lost) + (stats->late - self->last.late);
+    guint64 frames = stats->frames - self->last.frames;
+    guint64 late_frames = stats->late_frames - self->last.late_frames;
+    guint64 dropped = stats->dropped_frames - self->last.dropped_frames;
+    char cause[sizeof(self->cause)];
+    int len = 0;
+    cause[0] = '\0';
+
+    if(packets + lost >= ONVIFSTREAMMONITOR_MIN_PACKETS && (double) lost / (packets + lost) > ONVIFSTREAMMONITOR_LOSS_RATIO){
+        len += snprintf(cause + len, sizeof(cause) - len, "%s%.1f%% packets lost or late", len ? ", " : "", 100.0 * lost / (packets + lost));
+    }
+    if(stats->jitter_us > ONVIFSTREAMMONITOR_JITTER_US && len < (int) sizeof(cause)){
+        len += snprintf(cause + len, sizeof(cause) - len, "%sjitter %" G_GUINT64_FORMAT " ms", len ? ", " : "", stats->jitter_us / 1000);
+    }
+    if(frames && (double) late_frames / frames > ONVIFSTREAMMONITOR_LATE_FRAME_RATIO && len < (int) sizeof(cause)){
+        len += snprintf(cause + len, sizeof(cause) - len, "%s%.0f%% frames late", len ? ", " : "", 100.0 * late_frames / frames);
+    }
+    if(frames + dropped && (double) dropped / (frames + dropped) > ONVIFSTREAMMONITOR_DROP_RATIO && len < (int) sizeof(cause)){
+        len += snprintf(cause + len, sizeof(cause) - len, "%s%.0f%% frames dropped", len ? ", " : "", 100.0 * dropped / (frames + dropped));
+    }
+    if(!frames && packets >= ONVIFSTREAMMONITOR_MIN_PACKETS && len < (int) sizeof(cause)){
+        len += snprintf(cause + len, sizeof(cause) - len, "%sno frame rendered", len ? ", " : "");
+    }
+
+    if(!len){
+        return FALSE;
+    }
+    C_DEBUG("Stream of '%s' bad sample : %s", priv_OnvifStreamMonitor__name(self->device), cause);
+    strcpy(self->cause, cause);
+    return TRUE;
+}
+
+static gboolean priv_OnvifStreamMonitor__sample(gpointer user_data){
+    OnvifStreamMonitor * self = (OnvifStreamMonitor *) user_data;
+    GstRtspPlayerStats stats;
+    gint64 now = g_get_monotonic_time();
+
+    if(!self->session_start || !self->player || !ONVIFMGR_DEVICEROWROW_HAS_OWNER(self->device)){
+        return G_SOURCE_CONTINUE;
+    }
+
+    GstRtspPlayer__get_stats(self->player, &stats);
+    //Counters were reset by a stop, the next start begins a new session
+    if(stats.packets < self->last.packets || stats.frames < self->last.frames){
+        self->session_start = 0;
+        return G_SOURCE_CONTINUE;
+    }
+
+    if(now - self->session_start < ONVIFSTREAMMONITOR_GRACE_US){
+        self->last = stats;
+        return G_SOURCE_CONTINUE;
+    }
+
+    int bad = priv_OnvifStreamMonitor__is_bad(self, &stats);
+    self->last = stats;
+    self->window[self->window_index] = bad;
+    self->window_index = (self->window_index + 1) % ONVIFSTREAMMONITOR_WINDOW;
+    if(bad){
+        self->last_bad = now;
+    }
+
+    int bad_count = 0;
+    for(int i=0;i<ONVIFSTREAMMONITOR_WINDOW;i++){
+        bad_count += self->window[i];
+    }
+
+    gint64 stable = ONVIFSTREAMMONITOR_STABLE_US << self->stable_shift;
+    if(bad_count >= ONVIFSTREAMMONITOR_BAD_SAMPLES){
+        priv_OnvifStreamMonitor__reset_window(self);
+        priv_OnvifStreamMonitor__step_down(self, now);
+    } else if(self->step_count && now - self->session_start > stable && now - self->last_bad > stable){
+        priv_OnvifStreamMonitor__step_up(self, now);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+OnvifStreamMonitor * OnvifStreamMonitor__create(void (*held_callback)(int held, void * user_data), void * user_data){
+    OnvifStreamMonitor * self = malloc(sizeof(OnvifStreamMonitor));
+    memset(self, 0, sizeof(OnvifStreamMonitor));
+    self->held_callback = held_callback;
+    self->user_data = user_data;
+    return self;
+}
+
+void OnvifStreamMonitor__destroy(OnvifStreamMonitor * self){
+    if(!self){
+        return;
+    }
+
+    if(self->source){
+        g_source_remove(self->source);
+    }
+    if(self->player){
+        g_object_unref(self->player);
+    }
+    if(self->device){
+        g_object_unref(self->device);
+    }
+    free(self);
+}
+
+void OnvifStreamMonitor__set_enabled(OnvifStreamMonitor * self, int enabled){
+    g_return_if_fail (self != NULL);
+    self->enabled = enabled;
+    if(enabled && !self->source){
+        self->source = g_timeout_add(ONVIFSTREAMMONITOR_SAMPLE_INTERVAL_MS, priv_OnvifStreamMonitor__sample, self);
+    } else if(!enabled && self->source){
+        g_source_remove(self->source);
+        self->source = 0;
+        priv_OnvifStreamMonitor__restore(self);
+    }
+}
+
+void OnvifStreamMonitor__set_device(OnvifStreamMonitor * self, OnvifMgrDeviceRow * device){
+    g_return_if_fail (self != NULL);
+    if(device == self->device){
+        return;
+    }
+
+    priv_OnvifStreamMonitor__restore(self);
+    if(self->device){
+        g_object_unref(self->device);
+    }
+    self->device = device ? g_object_ref(device) : NULL;
+    self->session_start = 0;
+    self->last_bad = 0;
+    self->last_step_up = 0;
+    self->locked_reported = 0;
+}
+
+void OnvifStreamMonitor__stream_started(OnvifStreamMonitor * self, OnvifMgrDeviceRow * device, GstRtspPlayer * player){
+    g_return_if_fail (self != NULL);
+    if(device != self->device){
+        return;
+    }
+
+    if(player != self->player){
+        if(self->player){
+            g_object_unref(self->player);
+        }
+        self->player = g_object_ref(player);
+    }
+    self->session_start = g_get_monotonic_time();
+    GstRtspPlayer__get_stats(player, &self->last);
+    priv_OnvifStreamMonitor__reset_window(self);
+}
@@ -0,0 +1,22 @@
+#ifndef ONVIF_STREAM_MONITOR_H_
+#define ONVIF_STREAM_MONITOR_H_
+
+#include <gtk/gtk.h>
+#include "../gst/gstrtspplayer.h"
+#include "omgr_device_row.h"
+
+typedef struct _OnvifStreamMonitor OnvifStreamMonitor;
+
+//Samples the displayed stream's health (packet loss, jitter, late and dropped frames) and steps the selected device
+//down to a lighter profile on sustained degradation, then back up once the stream stayed stable for a while.
+//held_callback is invoked with TRUE while a device is stepped down, and FALSE once it is restored.
+OnvifStreamMonitor * OnvifStreamMonitor__create(void (*held_callback)(int held, void * user_data), void * user_data);
+void OnvifStreamMonitor__destroy(OnvifStreamMonitor * self);
+//Disabling restores the profile stepped down from
+void OnvifStreamMonitor__set_enabled(OnvifStreamMonitor * self, int enabled);
+//A device left while stepped down gets its profile back
+void OnvifStreamMonitor__set_device(OnvifStreamMonitor * self, OnvifMgrDeviceRow * device);
+//Starts monitoring the session, after a grace period
+void OnvifStreamMonitor__stream_started(OnvifStreamMonitor * self, OnvifMgrDeviceRow * device, GstRtspPlayer * player);
+
+#endif
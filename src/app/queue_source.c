@@ -0,0 +1,52 @@
+#include "queue_source.h"
+#include "clogger.h"
+
+typedef struct {
+    GSource parent;
+    EventQueue * queue;
+    int sink;
+} QueueSource;
+
+//Invoked by the queue under its lock, from any thread
+static void priv_QueueSource__wakeup(void * data){
+    g_source_set_ready_time((GSource *) data, 0);
+}
+
+static gboolean priv_QueueSource__dispatch(GSource * source, GSourceFunc callback, gpointer user_data){
+    QueueSource * self = (QueueSource *) source;
+    //Reset before draining. A completion posted meanwhile wakes the source up again.
+    g_source_set_ready_time(source, -1);
+    if(EventQueue__complete(self->queue, self->sink, QUEUESOURCE_BATCH) > 0){
+        g_source_set_ready_time(source, 0);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void priv_QueueSource__finalize(GSource * source){
+    QueueSource * self = (QueueSource *) source;
+    //Pending continuations are dropped along with the sink
+    EventQueue__remove_sink(self->queue, self->sink);
+}
+
+static GSourceFuncs QueueSource__funcs = {
+    NULL,
+    NULL,
+    priv_QueueSource__dispatch,
+    priv_QueueSource__finalize
+};
+
+GSource * QueueSource__new(EventQueue * queue){
+    GSource * source = g_source_new(&QueueSource__funcs, sizeof(QueueSource));
+    QueueSource * self = (QueueSource *) source;
+    self->queue = queue;
+    self->sink = EventQueue__add_sink(queue, priv_QueueSource__wakeup, source);
+    if(self->sink < 0){
+        C_ERROR("Failed to register queue completion sink");
+    }
+    g_source_set_name(source, "QueueSource");
+    return source;
+}
+
+int QueueSource__get_sink(GSource * source){
+    return ((QueueSource *) source)->sink;
+}
@@ -0,0 +1,16 @@
+#ifndef QUEUE_SOURCE_H_ 
+#define QUEUE_SOURCE_H_
+
+#include <glib.h>
+#include "../queue/event_queue.h"
+
+//Continuations run per main loop iteration. The rest waits for the next iteration so input and redraws aren't starved.
+#define QUEUESOURCE_BATCH 32
+
+//GSource draining a new EventQueue sink on the context it is attached to.
+//A single source delivers every completion, instead of one idle callback per finished task.
+GSource * QueueSource__new(EventQueue * queue);
+//Sink to pass to QueueEvent__set_continuation
+int QueueSource__get_sink(GSource * source);
+
+#endif
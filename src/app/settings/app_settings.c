@@ -10,6 +10,7 @@
 void set_settings_state(AppSettings * settings, int state){
     AppSettingsStream__set_state(settings->stream, state);
     AppSettingsDiscovery__set_state(settings->discovery, state);
+    AppSettingsWorkers__set_state(settings->workers, state);
     //More settings to add here
 }
 
@@ -26,7 +27,8 @@ void priv_AppSettings_state_changed(void * data){
     AppSettings * self = (AppSettings*) data;
     //More settings to add here
     if(AppSettingsStream__get_state(self->stream) ||
-        AppSettingsDiscovery__get_state(self->discovery)){
+        AppSettingsDiscovery__get_state(self->discovery) ||
+        AppSettingsWorkers__get_state(self->workers)){
         set_button_state(self,TRUE);
     } else {
         set_button_state(self,FALSE);
@@ -108,6 +110,7 @@ void _save_settings(void * user_data){
     if(fptr != NULL){
         fprintf(fptr,"%s\n\n",AppSettingsStream__save(self->stream));
         fprintf(fptr,"%s\n\n",AppSettingsDiscovery__save(self->discovery));
+        fprintf(fptr,"%s\n\n",AppSettingsWorkers__save(self->workers));
         //More settings to add here
         
         fclose(fptr);
@@ -125,12 +128,13 @@ void apply_settings (GtkWidget *widget, AppSettings * settings) {
     set_button_state(settings,FALSE);
     gtk_spinner_start (GTK_SPINNER (settings->loading_handle));
 
-    OnvifApp__dispatch(settings->app,settings->app,_save_settings,settings);
+    OnvifApp__dispatch(settings->app,settings->app,_save_settings,settings,NULL);
 }
 
 void AppSettings__reset_settings(AppSettings * self){
     AppSettingsStream__reset(self->stream);
     AppSettingsDiscovery__reset(self->discovery);
+    AppSettingsWorkers__reset(self->workers);
     //More settings to add here
 }
 
@@ -169,6 +173,7 @@ void AppSettings__create_ui(AppSettings * self){
 
     add_panel(notebook, "Discovery", AppSettingsDiscovery__get_widget(self->discovery));
     add_panel(notebook, "Stream", AppSettingsStream__get_widget(self->stream));
+    add_panel(notebook, "Workers", AppSettingsWorkers__get_widget(self->workers));
 
     //More settings to add here
 
@@ -267,6 +272,9 @@ void AppSettings__load_settings(AppSettings * self){
                     } else if(strcmp(AppSettingsDiscovery__get_category(self->discovery),cat) == 0){
                         category = APPSETTING_DISCOVERY_TYPE;
                         C_INFO("[%s]",AppSettingsDiscovery__get_category(self->discovery));
+                    } else if(strcmp(AppSettingsWorkers__get_category(self->workers),cat) == 0){
+                        category = APPSETTING_WORKERS_TYPE;
+                        C_INFO("[%s]",AppSettingsWorkers__get_category(self->workers));
                     }//More settings to add here
 
                     continue;
@@ -290,6 +298,11 @@ void AppSettings__load_settings(AppSettings * self){
                                 C_WARN("Unknown discovery property %s=%s",key,val);
                             }//More settings to add here
                             break;
+                        case APPSETTING_WORKERS_TYPE:
+                            if(!AppSettingsWorkers__set_property(self->workers,key,val)){
+                                C_WARN("Unknown workers property %s=%s",key,val);
+                            }
+                            break;
                         default:
                             //TODO Warning
                             break;
@@ -316,6 +329,7 @@ AppSettings * AppSettings__create(OnvifApp * app){
     self->app = app;
     self->stream = AppSettingsStream__create(priv_AppSettings_state_changed,self);
     self->discovery = AppSettingsDiscovery__create(priv_AppSettings_state_changed,self);
+    self->workers = AppSettingsWorkers__create(priv_AppSettings_state_changed,self);
     AppSettings__load_settings(self);
     AppSettings__create_ui(self);
     AppSettings__reset_settings(self);
@@ -328,6 +342,7 @@ void AppSettings__destroy(AppSettings* self){
         //TODO Clean up more panels here
         AppSettingsStream__destroy(self->stream);
         AppSettingsDiscovery__destroy(self->discovery);
+        AppSettingsWorkers__destroy(self->workers);
         free(self);
     }
 }
@@ -6,12 +6,14 @@
 
 #include "app_settings_stream.h"
 #include "app_settings_discovery.h"
+#include "app_settings_workers.h"
 
 typedef struct _AppSettings AppSettings;
 typedef enum _AppSettingsType {
     APPSETTING_INVALID = -1,
     APPSETTING_STREAM_TYPE = 0,
     APPSETTING_DISCOVERY_TYPE = 1,
+    APPSETTING_WORKERS_TYPE = 2,
 } AppSettingsType;
 
 struct _AppSettings {
@@ -25,6 +27,7 @@ struct _AppSettings {
 
     AppSettingsStream * stream;
     AppSettingsDiscovery * discovery;
+    AppSettingsWorkers * workers;
 
     OnvifApp * app;
 };
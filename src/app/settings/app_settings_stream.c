@@ -1,4 +1,8 @@
 #include "app_settings_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #define APPSETTINGS_STREAM_CAT "stream"
 
@@ -10,18 +14,73 @@ void value_toggled (GtkToggleButton* self, AppSettingsStream * settings){
     }
 }
 
+static gboolean priv_AppSettingsStream__scale_changed (GtkRange* scale, GtkScrollType* scroll, gdouble value, AppSettingsStream * self){
+    double roundedValue = round(value);
+    int signal = -1;
+    if(scale == GTK_RANGE(self->prefetch_scale)){
+        signal = self->prefetch_signal;
+    } else if(scale == GTK_RANGE(self->prefetch_memory_scale)){
+        signal = self->prefetch_memory_signal;
+    }
+
+    if(signal > -1){
+        g_signal_handler_block(scale,signal);
+        g_signal_emit_by_name(scale, "change-value", scroll, roundedValue,self);
+        g_signal_handler_unblock(scale,signal);
+    }
+
+    if(self->state_changed_callback){
+        self->state_changed_callback(self->state_changed_user_data);
+    }
+    return TRUE;
+}
+
 int AppSettingsStream__get_state (AppSettingsStream * settings){
     int scale_val = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(settings->overscale_chk));
+    if(scale_val != settings->allow_overscale){
+        return 1;
+    }
+
+    if(gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(settings->auto_profile_chk)) != settings->auto_profile){
+        return 1;
+    }
 
-    //TODO check for more settings
+    if(gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(settings->adaptive_profile_chk)) != settings->adaptive_profile){
+        return 1;
+    }
 
-    //More settings widgets here
-    return scale_val != settings->allow_overscale;
+    if((int) gtk_range_get_value (GTK_RANGE(settings->prefetch_scale)) != settings->prefetch_sessions){
+        return 1;
+    }
+
+    return (int) gtk_range_get_value (GTK_RANGE(settings->prefetch_memory_scale)) != settings->prefetch_memory;
 }
 
 void AppSettingsStream__set_state(AppSettingsStream * self,int state){
     if(GTK_IS_WIDGET(self->overscale_chk))
         gtk_widget_set_sensitive(self->overscale_chk,state);
+    if(GTK_IS_WIDGET(self->auto_profile_chk))
+        gtk_widget_set_sensitive(self->auto_profile_chk,state);
+    if(GTK_IS_WIDGET(self->adaptive_profile_chk))
+        gtk_widget_set_sensitive(self->adaptive_profile_chk,state);
+    if(GTK_IS_WIDGET(self->prefetch_scale))
+        gtk_widget_set_sensitive(self->prefetch_scale,state);
+    if(GTK_IS_WIDGET(self->prefetch_memory_scale))
+        gtk_widget_set_sensitive(self->prefetch_memory_scale,state);
+}
+
+static GtkWidget * priv_AppSettingsStream__create_scale(int min, int max, int step, int value){
+    char mark[10];
+    GtkWidget * scale = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,min,max,1);
+    gtk_widget_set_hexpand (scale, TRUE);
+    gtk_scale_set_draw_value(GTK_SCALE(scale),TRUE);
+    gtk_scale_set_digits(GTK_SCALE(scale),0);
+    for(int i=min;i<=max;i+=step){
+        sprintf(mark,"%d",i);
+        gtk_scale_add_mark (GTK_SCALE(scale),i,GTK_POS_BOTTOM,mark);
+    }
+    gtk_range_set_value(GTK_RANGE(scale),value);
+    return scale;
 }
 
 GtkWidget * AppSettingsStream__create_ui(AppSettingsStream * self){
@@ -35,6 +94,49 @@ GtkWidget * AppSettingsStream__create_ui(AppSettingsStream * self){
 
     g_signal_connect (G_OBJECT (self->overscale_chk), "toggled", G_CALLBACK (value_toggled), self);
 
+    self->auto_profile_chk = gtk_check_button_new_with_label("Automatic profile (smallest stream covering the view)");
+    gtk_grid_attach (GTK_GRID (widget), self->auto_profile_chk, 0, 2, 1, 1);
+
+    g_signal_connect (G_OBJECT (self->auto_profile_chk), "toggled", G_CALLBACK (value_toggled), self);
+
+    self->adaptive_profile_chk = gtk_check_button_new_with_label("Adaptive quality (lighter profile on packet loss or dropped frames)");
+    gtk_grid_attach (GTK_GRID (widget), self->adaptive_profile_chk, 0, 3, 1, 1);
+
+    g_signal_connect (G_OBJECT (self->adaptive_profile_chk), "toggled", G_CALLBACK (value_toggled), self);
+
+    GtkWidget * label = gtk_label_new("");
+    gtk_label_set_markup(GTK_LABEL(label),"<span size=\"large\" ><b>Prefetched streams</b></span>");
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin-top", 20, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 4, 1, 1);
+
+    label = gtk_label_new("Keeps paused sessions of the previously viewed and neighbouring cameras, to switch to them instantly.\nEach session holds a connection to the camera. 0 disables prefetching.");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 5, 1, 1);
+
+    self->prefetch_scale = priv_AppSettingsStream__create_scale(0,8,1,self->prefetch_sessions);
+    g_object_set (self->prefetch_scale, "margin-bottom", 20, NULL);
+    gtk_grid_attach (GTK_GRID (widget), self->prefetch_scale, 0, 6, 1, 1);
+
+    label = gtk_label_new("");
+    gtk_label_set_markup(GTK_LABEL(label),"<span size=\"large\" ><b>Prefetch memory budget (MB)</b></span>");
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 7, 1, 1);
+
+    label = gtk_label_new("Estimated decoder memory of the paused sessions. Lower it for high resolution cameras on small devices.");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 8, 1, 1);
+
+    self->prefetch_memory_scale = priv_AppSettingsStream__create_scale(64,1024,192,self->prefetch_memory);
+    gtk_grid_attach (GTK_GRID (widget), self->prefetch_memory_scale, 0, 9, 1, 1);
+
+    self->prefetch_signal = g_signal_connect (G_OBJECT (self->prefetch_scale), "change-value", G_CALLBACK (priv_AppSettingsStream__scale_changed), self);
+    self->prefetch_memory_signal = g_signal_connect (G_OBJECT (self->prefetch_memory_scale), "change-value", G_CALLBACK (priv_AppSettingsStream__scale_changed), self);
+
     return widget;
 }
 
@@ -48,22 +150,93 @@ int AppSettingsStream__get_allow_overscale(AppSettingsStream * self){
     return self->allow_overscale;
 }
 
+void AppSettingsStream__set_auto_profile_callback(AppSettingsStream * self, void (*auto_profile_callback)(AppSettingsStream *, int, void * ), void * auto_profile_userdata){
+    self->auto_profile_callback = auto_profile_callback;
+    self->auto_profile_userdata = auto_profile_userdata;
+}
+
+int AppSettingsStream__get_auto_profile(AppSettingsStream * self){
+    return self->auto_profile;
+}
+
+void AppSettingsStream__set_adaptive_profile_callback(AppSettingsStream * self, void (*adaptive_profile_callback)(AppSettingsStream *, int, void * ), void * adaptive_profile_userdata){
+    self->adaptive_profile_callback = adaptive_profile_callback;
+    self->adaptive_profile_userdata = adaptive_profile_userdata;
+}
+
+int AppSettingsStream__get_adaptive_profile(AppSettingsStream * self){
+    return self->adaptive_profile;
+}
+
+void AppSettingsStream__set_prefetch_callback(AppSettingsStream * self, void (*prefetch_callback)(AppSettingsStream *, int, int, void *), void * prefetch_userdata){
+    self->prefetch_callback = prefetch_callback;
+    self->prefetch_userdata = prefetch_userdata;
+}
+
+int AppSettingsStream__get_prefetch_sessions(AppSettingsStream * self){
+    return self->prefetch_sessions;
+}
+
+int AppSettingsStream__get_prefetch_memory(AppSettingsStream * self){
+    return self->prefetch_memory;
+}
+
+static char stream_settings_str[210];
 char * AppSettingsStream__save(AppSettingsStream * self){
-    if(AppSettingsStream__get_state(self) && self->overscale_callback){
-        self->allow_overscale = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(self->overscale_chk));
-        self->overscale_callback(self, self->allow_overscale, self->overscale_userdata);
-    }
-    if(self->allow_overscale){
-        return "[stream]\nallow_overscaling=true";
-    } else {
-        return "[stream]\nallow_overscaling=false";
+    if(AppSettingsStream__get_state(self)){
+        int allow_overscale = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(self->overscale_chk));
+        if(allow_overscale != self->allow_overscale && self->overscale_callback){
+            self->allow_overscale = allow_overscale;
+            self->overscale_callback(self, self->allow_overscale, self->overscale_userdata);
+        }
+        self->allow_overscale = allow_overscale;
+
+        int auto_profile = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(self->auto_profile_chk));
+        if(auto_profile != self->auto_profile && self->auto_profile_callback){
+            self->auto_profile = auto_profile;
+            self->auto_profile_callback(self, self->auto_profile, self->auto_profile_userdata);
+        }
+        self->auto_profile = auto_profile;
+
+        int adaptive_profile = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(self->adaptive_profile_chk));
+        if(adaptive_profile != self->adaptive_profile && self->adaptive_profile_callback){
+            self->adaptive_profile = adaptive_profile;
+            self->adaptive_profile_callback(self, self->adaptive_profile, self->adaptive_profile_userdata);
+        }
+        self->adaptive_profile = adaptive_profile;
+
+        int sessions = gtk_range_get_value (GTK_RANGE(self->prefetch_scale));
+        int memory = gtk_range_get_value (GTK_RANGE(self->prefetch_memory_scale));
+        if((sessions != self->prefetch_sessions || memory != self->prefetch_memory) && self->prefetch_callback){
+            self->prefetch_sessions = sessions;
+            self->prefetch_memory = memory;
+            self->prefetch_callback(self, sessions, memory, self->prefetch_userdata);
+        }
+        self->prefetch_sessions = sessions;
+        self->prefetch_memory = memory;
     }
+    sprintf(stream_settings_str, "[%s]\nallow_overscaling=%s\nauto_profile=%s\nadaptive_profile=%s\nprefetch_sessions=%i\nprefetch_memory=%i",
+            APPSETTINGS_STREAM_CAT, self->allow_overscale ? "true" : "false", self->auto_profile ? "true" : "false", self->adaptive_profile ? "true" : "false", self->prefetch_sessions, self->prefetch_memory);
+    return stream_settings_str;
 }
 
 void AppSettingsStream__init(AppSettingsStream * self, void (*state_changed_callback)(void * ),void * state_changed_user_data){
     self->allow_overscale = 1;
     self->overscale_callback = NULL;
     self->overscale_userdata = NULL;
+    //Manual profiles stay the default, automatic selection restarts streams on resize
+    self->auto_profile = 0;
+    self->auto_profile_callback = NULL;
+    self->auto_profile_userdata = NULL;
+    //Only ever lowers the quality of a struggling stream, on by default
+    self->adaptive_profile = 1;
+    self->adaptive_profile_callback = NULL;
+    self->adaptive_profile_userdata = NULL;
+    //Prefetching is opt-in, every session holds a camera connection
+    self->prefetch_sessions = 0;
+    self->prefetch_memory = 256;
+    self->prefetch_callback = NULL;
+    self->prefetch_userdata = NULL;
     self->state_changed_callback = state_changed_callback;
     self->state_changed_user_data = state_changed_user_data;
     self->widget = AppSettingsStream__create_ui(self);
@@ -90,6 +263,10 @@ void AppSettingsStream__reset(AppSettingsStream * self){
     } else {
         gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (self->overscale_chk),FALSE);
     }
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (self->auto_profile_chk),self->auto_profile);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (self->adaptive_profile_chk),self->adaptive_profile);
+    gtk_range_set_value(GTK_RANGE(self->prefetch_scale),self->prefetch_sessions);
+    gtk_range_set_value(GTK_RANGE(self->prefetch_memory_scale),self->prefetch_memory);
 }
 
 char * AppSettingsStream__get_category(AppSettingsStream * self){
@@ -105,6 +282,18 @@ int AppSettingsStream__set_property(AppSettingsStream * self, char * key, char *
             self->allow_overscale = 1;
         }
         valid = 1;
+    } else if(!strcmp(key,"auto_profile")){
+        self->auto_profile = !strcmp(value,"true");
+        valid = 1;
+    } else if(!strcmp(key,"adaptive_profile")){
+        self->adaptive_profile = !strcmp(value,"true");
+        valid = 1;
+    } else if(!strcmp(key,"prefetch_sessions")){
+        self->prefetch_sessions = CLAMP(atoi(value),0,8);
+        valid = 1;
+    } else if(!strcmp(key,"prefetch_memory")){
+        self->prefetch_memory = CLAMP(atoi(value),64,1024);
+        valid = 1;
     }
     return valid;
 }
\ No newline at end of file
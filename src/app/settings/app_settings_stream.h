@@ -12,6 +12,25 @@ struct _AppSettingsStream {
     void (*overscale_callback)(AppSettingsStream *, int, void *);
     void * overscale_userdata;
 
+    GtkWidget * auto_profile_chk;
+    int auto_profile;
+    void (*auto_profile_callback)(AppSettingsStream *, int, void *);
+    void * auto_profile_userdata;
+
+    GtkWidget * adaptive_profile_chk;
+    int adaptive_profile;
+    void (*adaptive_profile_callback)(AppSettingsStream *, int, void *);
+    void * adaptive_profile_userdata;
+
+    GtkWidget * prefetch_scale;
+    GtkWidget * prefetch_memory_scale;
+    int prefetch_sessions;
+    int prefetch_memory;
+    int prefetch_signal;
+    int prefetch_memory_signal;
+    void (*prefetch_callback)(AppSettingsStream *, int, int, void *);
+    void * prefetch_userdata;
+
     void (*state_changed_callback)(void * );
     void * state_changed_user_data;
 };
@@ -20,6 +39,16 @@ struct _AppSettingsStream {
 AppSettingsStream * AppSettingsStream__create(void (*state_changed_callback)(void * ),void * state_changed_user_data);
 void AppSettingsStream__set_overscale_callback(AppSettingsStream * self, void (*overscale_callback)(AppSettingsStream *, int value, void *), void * overscale_userdata);
 int AppSettingsStream__get_allow_overscale(AppSettingsStream * self);
+void AppSettingsStream__set_auto_profile_callback(AppSettingsStream * self, void (*auto_profile_callback)(AppSettingsStream *, int value, void *), void * auto_profile_userdata);
+//Profiles follow the size of the NVT view, unless picked by hand
+int AppSettingsStream__get_auto_profile(AppSettingsStream * self);
+void AppSettingsStream__set_adaptive_profile_callback(AppSettingsStream * self, void (*adaptive_profile_callback)(AppSettingsStream *, int value, void *), void * adaptive_profile_userdata);
+//Steps down to a lighter profile on sustained packet loss or decoder lag
+int AppSettingsStream__get_adaptive_profile(AppSettingsStream * self);
+void AppSettingsStream__set_prefetch_callback(AppSettingsStream * self, void (*prefetch_callback)(AppSettingsStream *, int sessions, int memory_mb, void *), void * prefetch_userdata);
+//Standby sessions kept for instant switching, 0 when disabled
+int AppSettingsStream__get_prefetch_sessions(AppSettingsStream * self);
+int AppSettingsStream__get_prefetch_memory(AppSettingsStream * self);
 int AppSettingsStream__get_state(AppSettingsStream * settings);
 void AppSettingsStream__set_state(AppSettingsStream * self,int state);
 char * AppSettingsStream__save(AppSettingsStream *self);
@@ -0,0 +1,189 @@
+#include "app_settings_workers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define APPSETTINGS_WORKERS_CAT "workers"
+
+static void priv_AppSettingsWorkers__state_changed(AppSettingsWorkers * self){
+    if(self->state_changed_callback){
+        self->state_changed_callback(self->state_changed_user_data);
+    }
+}
+
+static gboolean priv_AppSettingsWorkers__scale_changed (GtkRange* scale, GtkScrollType* scroll, gdouble value, AppSettingsWorkers * self){
+    double roundedValue = round(value);
+    int signal = -1;
+    if(scale == GTK_RANGE(self->min_scale)){
+        signal = self->min_signal;
+    } else if(scale == GTK_RANGE(self->max_scale)){
+        signal = self->max_signal;
+    }
+
+    if(signal > -1){
+        g_signal_handler_block(scale,signal);
+        g_signal_emit_by_name(scale, "change-value", scroll, roundedValue,self);
+        g_signal_handler_unblock(scale,signal);
+    }
+
+    priv_AppSettingsWorkers__state_changed(self);
+    return TRUE;
+}
+
+int AppSettingsWorkers__get_state (AppSettingsWorkers * self){
+    int v = gtk_range_get_value (GTK_RANGE(self->min_scale));
+    if(v != self->min_threads){
+        return 1;
+    }
+
+    v = gtk_range_get_value (GTK_RANGE(self->max_scale));
+    if(v != self->max_threads){
+        return 1;
+    }
+    return 0;
+}
+
+void AppSettingsWorkers__set_state(AppSettingsWorkers * self,int state){
+    if(GTK_IS_WIDGET(self->min_scale))
+        gtk_widget_set_sensitive(self->min_scale,state);
+    if(GTK_IS_WIDGET(self->max_scale))
+        gtk_widget_set_sensitive(self->max_scale,state);
+}
+
+static GtkWidget * priv_AppSettingsWorkers__create_scale(int min, int max, int step){
+    char mark[10];
+    GtkWidget * scale = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,min,max,1);
+    gtk_widget_set_hexpand (scale, TRUE);
+    gtk_scale_set_draw_value(GTK_SCALE(scale),TRUE);
+    gtk_scale_set_digits(GTK_SCALE(scale),0);
+    for(int i=min;i<=max;i+=step){
+        sprintf(mark,"%d",i);
+        gtk_scale_add_mark (GTK_SCALE(scale),i,GTK_POS_BOTTOM,mark);
+    }
+    return scale;
+}
+
+GtkWidget * AppSettingsWorkers__create_ui(AppSettingsWorkers * self){
+    GtkWidget * label;
+    GtkWidget * widget = gtk_grid_new(); //Widget filling up workers page
+
+    g_object_set (widget, "margin", 20, NULL);
+    gtk_widget_set_hexpand (widget, TRUE);
+
+    label = gtk_label_new("");
+    gtk_label_set_markup(GTK_LABEL(label),"<span size=\"large\" ><b>Minimum worker threads</b></span>");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 0, 1, 1);
+
+    label = gtk_label_new("Defines how many background threads are kept alive when idle.\nDecreasing this value is useful on small devices.");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 1, 1, 1);
+
+    self->min_scale = priv_AppSettingsWorkers__create_scale(1,16,3);
+    gtk_range_set_value(GTK_RANGE(self->min_scale),self->min_threads);
+    g_object_set (self->min_scale, "margin-bottom", 20, NULL);
+    gtk_grid_attach (GTK_GRID (widget), self->min_scale, 0, 2, 1, 1);
+
+    label = gtk_label_new("");
+    gtk_label_set_markup(GTK_LABEL(label),"<span size=\"large\" ><b>Maximum worker threads</b></span>");
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 3, 1, 1);
+
+    label = gtk_label_new("Defines how many background threads can be started under load.\nIncreasing this value is useful for large number of cameras.");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 4, 1, 1);
+
+    self->max_scale = priv_AppSettingsWorkers__create_scale(4,64,12);
+    gtk_range_set_value(GTK_RANGE(self->max_scale),self->max_threads);
+    gtk_grid_attach (GTK_GRID (widget), self->max_scale, 0, 5, 1, 1);
+
+    self->min_signal = g_signal_connect (G_OBJECT (self->min_scale), "change-value", G_CALLBACK (priv_AppSettingsWorkers__scale_changed), self);
+    self->max_signal = g_signal_connect (G_OBJECT (self->max_scale), "change-value", G_CALLBACK (priv_AppSettingsWorkers__scale_changed), self);
+
+    return widget;
+}
+
+static char workers_settings_str[100];
+char * AppSettingsWorkers__save(AppSettingsWorkers * self){
+    if(AppSettingsWorkers__get_state(self)){
+        self->min_threads = gtk_range_get_value (GTK_RANGE(self->min_scale));
+        self->max_threads = gtk_range_get_value (GTK_RANGE(self->max_scale));
+        if(self->max_threads < self->min_threads){
+            self->max_threads = self->min_threads;
+        }
+        if(self->bounds_callback){
+            self->bounds_callback(self, self->min_threads, self->max_threads, self->bounds_userdata);
+        }
+    }
+    sprintf(workers_settings_str, "[%s]\nmin_threads=%i\nmax_threads=%i",
+            APPSETTINGS_WORKERS_CAT, self->min_threads, self->max_threads);
+    return workers_settings_str;
+}
+
+void AppSettingsWorkers__init(AppSettingsWorkers * self, void (*state_changed_callback)(void * ),void * state_changed_user_data){
+    self->min_threads = 4;
+    self->max_threads = 32;
+    self->min_scale = NULL;
+    self->max_scale = NULL;
+    self->bounds_callback = NULL;
+    self->bounds_userdata = NULL;
+    self->state_changed_callback = state_changed_callback;
+    self->state_changed_user_data = state_changed_user_data;
+    self->widget = AppSettingsWorkers__create_ui(self);
+}
+
+AppSettingsWorkers * AppSettingsWorkers__create(void (*state_changed_callback)(void * ),void * state_changed_user_data){
+    AppSettingsWorkers * self = malloc(sizeof(AppSettingsWorkers));
+    AppSettingsWorkers__init(self,state_changed_callback, state_changed_user_data);
+    return self;
+}
+
+void AppSettingsWorkers__destroy(AppSettingsWorkers * self){
+    free(self);
+}
+
+void AppSettingsWorkers__set_bounds_callback(AppSettingsWorkers * self, void (*bounds_callback)(AppSettingsWorkers *, int, int, void *), void * bounds_userdata){
+    self->bounds_callback = bounds_callback;
+    self->bounds_userdata = bounds_userdata;
+}
+
+GtkWidget * AppSettingsWorkers__get_widget(AppSettingsWorkers * self){
+    return self->widget;
+}
+
+void AppSettingsWorkers__reset(AppSettingsWorkers * self){
+    gtk_range_set_value(GTK_RANGE(self->min_scale),self->min_threads);
+    gtk_range_set_value(GTK_RANGE(self->max_scale),self->max_threads);
+    priv_AppSettingsWorkers__state_changed(self);
+}
+
+char * AppSettingsWorkers__get_category(AppSettingsWorkers * self){
+    return APPSETTINGS_WORKERS_CAT;
+}
+
+int AppSettingsWorkers__set_property(AppSettingsWorkers * self, char * key, char * value){
+    int valid = 0;
+    if(!strcmp(key,"min_threads")){
+        self->min_threads = atoi(value);
+        valid = 1;
+    } else if(!strcmp(key,"max_threads")){
+        self->max_threads = atoi(value);
+        valid = 1;
+    }
+    
+    return valid;
+}
+
+int AppSettingsWorkers__get_min_threads(AppSettingsWorkers * self){
+    return self->min_threads;
+}
+
+int AppSettingsWorkers__get_max_threads(AppSettingsWorkers * self){
+    return self->max_threads;
+}
@@ -0,0 +1,40 @@
+#ifndef ONVIF_APP_SETTINGS_WORKERS_H_ 
+#define ONVIF_APP_SETTINGS_WORKERS_H_
+
+#include <gtk/gtk.h>
+
+typedef struct _AppSettingsWorkers AppSettingsWorkers;
+
+struct _AppSettingsWorkers {
+    GtkWidget * widget;
+    GtkWidget * min_scale;
+    GtkWidget * max_scale;
+
+    int min_threads;
+    int min_signal;
+
+    int max_threads;
+    int max_signal;
+
+    void (*bounds_callback)(AppSettingsWorkers *, int, int, void *);
+    void * bounds_userdata;
+
+    void (*state_changed_callback)(void * );
+    void * state_changed_user_data;
+};
+
+AppSettingsWorkers * AppSettingsWorkers__create(void (*state_changed_callback)(void * ),void * state_changed_user_data);
+void AppSettingsWorkers__set_bounds_callback(AppSettingsWorkers * self, void (*bounds_callback)(AppSettingsWorkers *, int min_threads, int max_threads, void *), void * bounds_userdata);
+int AppSettingsWorkers__get_state(AppSettingsWorkers * settings);
+void AppSettingsWorkers__set_state(AppSettingsWorkers * self,int state);
+char * AppSettingsWorkers__save(AppSettingsWorkers *self);
+void AppSettingsWorkers__reset(AppSettingsWorkers * settings);
+char * AppSettingsWorkers__get_category(AppSettingsWorkers * self);
+int AppSettingsWorkers__set_property(AppSettingsWorkers * self, char * key, char * value);
+GtkWidget * AppSettingsWorkers__get_widget(AppSettingsWorkers * dialog);
+void AppSettingsWorkers__destroy(AppSettingsWorkers * self);
+
+int AppSettingsWorkers__get_min_threads(AppSettingsWorkers * self);
+int AppSettingsWorkers__get_max_threads(AppSettingsWorkers * self);
+
+#endif
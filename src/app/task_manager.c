@@ -1,25 +1,351 @@
 #include "task_manager.h"
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//4Hz keeps the panel live without waking the main loop for every queue event
+#define TASKMGR_SAMPLE_MS 250
+#define TASKMGR_MAX_TASKS 256
+#define TASKMGR_MAX_CALLBACKS 64
+
+enum {
+    TASKMGR_TASK_OWNER,
+    TASKMGR_TASK_NAME,
+    TASKMGR_TASK_STATE,
+    TASKMGR_TASK_PRIORITY,
+    TASKMGR_TASK_POOL,
+    TASKMGR_TASK_AGE,
+    TASKMGR_TASK_COLUMNS
+};
+
+enum {
+    TASKMGR_CB_NAME,
+    TASKMGR_CB_RATE,
+    TASKMGR_CB_COUNT,
+    TASKMGR_CB_WAIT,
+    TASKMGR_CB_RUN,
+    TASKMGR_CB_COLUMNS
+};
+
+typedef struct {
+    QUEUE_CALLBACK callback;
+    unsigned long long count;
+} TaskMgrCallbackCount;
 
 typedef struct _TaskMgr {
     GtkWidget * widget;
+    GtkWidget * lbl_workers;
+    GtkWidget * lbl_utilization;
+    GtkWidget * lbl_pending;
+    GtkWidget * lbl_throughput;
+    GtkWidget * summary_label;
+    GtkListStore * tasks_store;
+    GtkListStore * callbacks_store;
+    guint timeout_source;
+    int stats_owned; //Queue statistics enabled by the panel, off again once it is hidden
+
+    EventQueue * queue;
+    TASKMGR_SCOPE_RESOLVER resolver;
+    void * resolver_data;
+
+    //Previous sample, used to turn cumulative counters into rates
+    EventQueueSnapshot last;
+    TaskMgrCallbackCount last_counts[TASKMGR_MAX_CALLBACKS];
+    int last_counts_count;
+
+    EventQueueTask tasks[TASKMGR_MAX_TASKS];
+    QueueStatsSummary summaries[TASKMGR_MAX_CALLBACKS];
 } TaskMgr;
 
+static const char * priv_TaskMgr__state_to_string(EventQueueTaskState state){
+    switch(state){
+        case EVENTQUEUE_TASK_RUNNING:
+            return "Running";
+        case EVENTQUEUE_TASK_PENDING:
+            return "Pending";
+        case EVENTQUEUE_TASK_SCHEDULED:
+            return "Scheduled";
+        case EVENTQUEUE_TASK_HUNG:
+            return "Hung";
+        default:
+            return NULL;
+    }
+}
+
+static const char * priv_TaskMgr__priority_to_string(EventQueuePriority priority){
+    switch(priority){
+        case EVENTQUEUE_PRIORITY_INTERACTIVE:
+            return "Interactive";
+        case EVENTQUEUE_PRIORITY_NORMAL:
+            return "Normal";
+        case EVENTQUEUE_PRIORITY_BACKGROUND:
+            return "Background";
+        default:
+            return NULL;
+    }
+}
+
+static void priv_TaskMgr__format_duration(char * str, size_t size, long long us){
+    if(us < 1000){
+        snprintf(str,size,"%lld µs",us);
+    } else if(us < 1000000){
+        snprintf(str,size,"%lld ms",us / 1000);
+    } else {
+        snprintf(str,size,"%.1f s",(double) us / 1000000);
+    }
+}
+
+static void priv_TaskMgr__format_callback(char * str, size_t size, const char * name, QUEUE_CALLBACK callback){
+    if(name){
+        snprintf(str,size,"%s",name);
+    } else {
+        snprintf(str,size,"0x%" PRIxPTR,(uintptr_t) callback);
+    }
+}
+
+//Running first, then grouped by owner
+static int priv_TaskMgr__compare_tasks(const void * a, const void * b){
+    const EventQueueTask * ta = a;
+    const EventQueueTask * tb = b;
+    if(ta->scope != tb->scope){
+        return (uintptr_t) ta->scope < (uintptr_t) tb->scope ? -1 : 1;
+    }
+    if(ta->state != tb->state){
+        return ta->state - tb->state;
+    }
+    return ta->age_us > tb->age_us ? -1 : ta->age_us < tb->age_us;
+}
+
+static void priv_TaskMgr__update_tasks(TaskMgr * self, int count){
+    GtkTreeIter iter;
+    char age[32];
+    char name[32];
+    char * owner = NULL;
+    void * owner_scope = NULL;
+
+    qsort(self->tasks,count,sizeof(EventQueueTask),priv_TaskMgr__compare_tasks);
+
+    gtk_list_store_clear(self->tasks_store);
+    for(int i=0;i<count;i++){
+        EventQueueTask * task = &self->tasks[i];
+        //Scopes are resolved once per group
+        if(i == 0 || task->scope != owner_scope){
+            free(owner);
+            owner = (task->scope && self->resolver) ? self->resolver(task->scope,self->resolver_data) : NULL;
+            owner_scope = task->scope;
+        }
+
+        priv_TaskMgr__format_duration(age,sizeof(age),task->age_us);
+        priv_TaskMgr__format_callback(name,sizeof(name),task->name,task->callback);
+        gtk_list_store_append(self->tasks_store,&iter);
+        gtk_list_store_set(self->tasks_store,&iter,
+                            TASKMGR_TASK_OWNER, owner ? owner : "-",
+                            TASKMGR_TASK_NAME, name,
+                            TASKMGR_TASK_STATE, priv_TaskMgr__state_to_string(task->state),
+                            TASKMGR_TASK_PRIORITY, priv_TaskMgr__priority_to_string(task->priority),
+                            TASKMGR_TASK_POOL, EventQueue__get_pool_name(self->queue,task->pool),
+                            TASKMGR_TASK_AGE, age,
+                            -1);
+    }
+    free(owner);
+}
+
+static unsigned long long priv_TaskMgr__last_count(TaskMgr * self, QUEUE_CALLBACK callback){
+    for(int i=0;i<self->last_counts_count;i++){
+        if(self->last_counts[i].callback == callback){
+            return self->last_counts[i].count;
+        }
+    }
+    return 0;
+}
+
+static void priv_TaskMgr__update_callbacks(TaskMgr * self, double elapsed){
+    GtkTreeIter iter;
+    char name[32];
+    char rate[32];
+    char wait[32];
+    char run[32];
+    int count = QueueStats__get_summary(EventQueue__get_stats(self->queue),self->summaries,TASKMGR_MAX_CALLBACKS);
+    if(count > TASKMGR_MAX_CALLBACKS){
+        count = TASKMGR_MAX_CALLBACKS;
+    }
+
+    gtk_list_store_clear(self->callbacks_store);
+    for(int i=0;i<count;i++){
+        QueueStatsSummary * summary = &self->summaries[i];
+        unsigned long long delta = summary->count - priv_TaskMgr__last_count(self,summary->callback);
+
+        priv_TaskMgr__format_callback(name,sizeof(name),summary->name,summary->callback);
+        snprintf(rate,sizeof(rate),"%.1f/s",elapsed > 0 ? delta / elapsed : 0);
+        priv_TaskMgr__format_duration(wait,sizeof(wait),summary->wait_us[QUEUESTATS_P90]);
+        priv_TaskMgr__format_duration(run,sizeof(run),summary->run_us[QUEUESTATS_P90]);
+        gtk_list_store_append(self->callbacks_store,&iter);
+        gtk_list_store_set(self->callbacks_store,&iter,
+                            TASKMGR_CB_NAME, name,
+                            TASKMGR_CB_RATE, rate,
+                            TASKMGR_CB_COUNT, summary->count,
+                            TASKMGR_CB_WAIT, wait,
+                            TASKMGR_CB_RUN, run,
+                            -1);
+
+        self->last_counts[i].callback = summary->callback;
+        self->last_counts[i].count = summary->count;
+    }
+    self->last_counts_count = count;
+}
+
+static gboolean priv_TaskMgr__sample(gpointer user_data){
+    TaskMgr * self = (TaskMgr *) user_data;
+    EventQueueSnapshot snapshot;
+    char str[64];
+
+    //Only the tab label is refreshed while the panel is hidden
+    int visible = gtk_widget_get_mapped(self->widget);
+    EventQueue__snapshot(self->queue,&snapshot,self->tasks,visible ? TASKMGR_MAX_TASKS : 0);
+
+    if(GTK_IS_LABEL(self->summary_label)){
+        snprintf(str,sizeof(str),"[%d/%d]",snapshot.running_count + snapshot.pending_count,snapshot.thread_count);
+        gtk_label_set_text(GTK_LABEL(self->summary_label),str);
+    }
+
+    if(visible){
+        double elapsed = self->last.time_us ? (double)(snapshot.time_us - self->last.time_us) / 1000000 : 0;
+        double capacity = (double)(snapshot.time_us - self->last.time_us) * snapshot.thread_count;
+        double utilization = self->last.time_us && capacity > 0 ? (snapshot.busy_us - self->last.busy_us) * 100 / capacity : 0;
+
+        if(snapshot.hung_count){
+            snprintf(str,sizeof(str),"%d busy (%d hung) / %d",snapshot.running_count,snapshot.hung_count,snapshot.thread_count);
+        } else {
+            snprintf(str,sizeof(str),"%d busy / %d",snapshot.running_count,snapshot.thread_count);
+        }
+        gtk_label_set_text(GTK_LABEL(self->lbl_workers),str);
+        snprintf(str,sizeof(str),"%.0f%%",utilization > 100 ? 100 : utilization);
+        gtk_label_set_text(GTK_LABEL(self->lbl_utilization),str);
+        unsigned long long overflowed = snapshot.overflow_count[EVENTQUEUE_OVERFLOW_REJECT]
+                                    + snapshot.overflow_count[EVENTQUEUE_OVERFLOW_DROP_OLDEST]
+                                    + snapshot.overflow_count[EVENTQUEUE_OVERFLOW_DROP_NEWEST];
+        if(overflowed){
+            snprintf(str,sizeof(str),"%d pending, %d scheduled (%llu dropped)",snapshot.pending_count,snapshot.scheduled_count,overflowed);
+        } else {
+            snprintf(str,sizeof(str),"%d pending, %d scheduled",snapshot.pending_count,snapshot.scheduled_count);
+        }
+        gtk_label_set_text(GTK_LABEL(self->lbl_pending),str);
+        snprintf(str,sizeof(str),"%.1f/s",elapsed > 0 ? (snapshot.finished_count - self->last.finished_count) / elapsed : 0);
+        gtk_label_set_text(GTK_LABEL(self->lbl_throughput),str);
+
+        priv_TaskMgr__update_tasks(self,snapshot.task_count);
+        priv_TaskMgr__update_callbacks(self,elapsed);
+    }
+
+    self->last = snapshot;
+    return G_SOURCE_CONTINUE;
+}
+
+//Statistics cost every event a few timestamps, they are only recorded while the panel is shown
+static void priv_TaskMgr__map(GtkWidget * widget, TaskMgr * self){
+    QueueStats * stats = EventQueue__get_stats(self->queue);
+    if(!QueueStats__is_enabled(stats)){
+        EventQueue__set_stats_enabled(self->queue,1);
+        self->stats_owned = 1;
+    }
+}
+
+static void priv_TaskMgr__unmap(GtkWidget * widget, TaskMgr * self){
+    if(self->stats_owned){
+        EventQueue__set_stats_enabled(self->queue,0);
+        self->stats_owned = 0;
+    }
+}
+
+static GtkWidget * priv_TaskMgr__add_summary(GtkWidget * grid, int col, char * title){
+    GtkWidget * widget = gtk_label_new(title);
+    gtk_widget_set_halign(widget,GTK_ALIGN_END);
+    gtk_grid_attach (GTK_GRID (grid), widget, col, 0, 1, 1);
+
+    widget = gtk_label_new("-");
+    gtk_widget_set_halign(widget,GTK_ALIGN_START);
+    gtk_widget_set_hexpand (widget, TRUE);
+    gtk_grid_attach (GTK_GRID (grid), widget, col+1, 0, 1, 1);
+    return widget;
+}
+
+static GtkWidget * priv_TaskMgr__create_view(GtkListStore * store, char ** titles, int count){
+    GtkWidget * view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    for(int i=0;i<count;i++){
+        GtkCellRenderer * renderer = gtk_cell_renderer_text_new();
+        GtkTreeViewColumn * column = gtk_tree_view_column_new_with_attributes(titles[i],renderer,"text",i,NULL);
+        gtk_tree_view_column_set_resizable(column,TRUE);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(view),column);
+    }
+
+    GtkWidget * scroll = gtk_scrolled_window_new(NULL,NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),GTK_POLICY_AUTOMATIC,GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_vexpand (scroll, TRUE);
+    gtk_container_add(GTK_CONTAINER(scroll),view);
+    return scroll;
+}
+
 void TaskMgr__create_ui(TaskMgr* self){
-    self->widget = gtk_label_new("Work In Progress...");
+    char * task_titles[] = { "Owner", "Task", "State", "Priority", "Pool", "Age" };
+    char * cb_titles[] = { "Task", "Throughput", "Total", "Wait (p90)", "Run (p90)" };
+
+    self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL,6);
+    g_object_set (self->widget, "margin", 5, NULL);
+
+    GtkWidget * grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid),5);
+    self->lbl_workers = priv_TaskMgr__add_summary(grid,0,"Workers :");
+    self->lbl_utilization = priv_TaskMgr__add_summary(grid,2,"Utilization :");
+    self->lbl_pending = priv_TaskMgr__add_summary(grid,4,"Queued :");
+    self->lbl_throughput = priv_TaskMgr__add_summary(grid,6,"Throughput :");
+    gtk_box_pack_start(GTK_BOX(self->widget),grid,FALSE,FALSE,0);
+
+    GtkWidget * paned = gtk_paned_new(GTK_ORIENTATION_VERTICAL);
+    self->tasks_store = gtk_list_store_new(TASKMGR_TASK_COLUMNS,G_TYPE_STRING,G_TYPE_STRING,G_TYPE_STRING,G_TYPE_STRING,G_TYPE_STRING,G_TYPE_STRING);
+    gtk_paned_pack1(GTK_PANED(paned),priv_TaskMgr__create_view(self->tasks_store,task_titles,TASKMGR_TASK_COLUMNS),TRUE,FALSE);
+    self->callbacks_store = gtk_list_store_new(TASKMGR_CB_COLUMNS,G_TYPE_STRING,G_TYPE_STRING,G_TYPE_UINT64,G_TYPE_STRING,G_TYPE_STRING);
+    gtk_paned_pack2(GTK_PANED(paned),priv_TaskMgr__create_view(self->callbacks_store,cb_titles,TASKMGR_CB_COLUMNS),TRUE,FALSE);
+    gtk_box_pack_start(GTK_BOX(self->widget),paned,TRUE,TRUE,0);
+
+    //Views hold their own reference
+    g_object_unref(self->tasks_store);
+    g_object_unref(self->callbacks_store);
+
+    g_signal_connect (G_OBJECT (self->widget), "map", G_CALLBACK (priv_TaskMgr__map), self);
+    g_signal_connect (G_OBJECT (self->widget), "unmap", G_CALLBACK (priv_TaskMgr__unmap), self);
 }
 
-TaskMgr * TaskMgr__create(){
+TaskMgr * TaskMgr__create(EventQueue * queue){
     TaskMgr * ret = malloc(sizeof(TaskMgr));
+    memset(ret,0,sizeof(TaskMgr));
+    ret->queue = queue;
     TaskMgr__create_ui(ret);
+    ret->timeout_source = g_timeout_add(TASKMGR_SAMPLE_MS,priv_TaskMgr__sample,ret);
     return ret;
 }
 
 void TaskMgr__destroy(TaskMgr* self){
     if(self){
+        g_source_remove(self->timeout_source);
+        if(GTK_IS_WIDGET(self->widget)){
+            g_signal_handlers_disconnect_by_data(self->widget,self);
+        }
+        priv_TaskMgr__unmap(self->widget,self);
         free(self);
     }
 }
 
 GtkWidget * TaskMgr__get_widget(TaskMgr * self){
     return self->widget;
-}
\ No newline at end of file
+}
+
+void TaskMgr__set_scope_resolver(TaskMgr * self, TASKMGR_SCOPE_RESOLVER resolver, void * user_data){
+    self->resolver = resolver;
+    self->resolver_data = user_data;
+}
+
+void TaskMgr__set_summary_label(TaskMgr * self, GtkWidget * label){
+    self->summary_label = label;
+}
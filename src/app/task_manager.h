@@ -1,12 +1,20 @@
-#ifndef TASK_MGR_H_ 
+#ifndef TASK_MGR_H_
 #define TASK_MGR_H_
 
 #include <gtk/gtk.h>
+#include "../queue/event_queue.h"
 
 typedef struct _TaskMgr TaskMgr;
 
-TaskMgr * TaskMgr__create();
+//Returns a newly allocated display name for the scope, or NULL if unknown. Invoked on the GTK main thread.
+typedef char * (*TASKMGR_SCOPE_RESOLVER)(void * scope, void * user_data);
+
+//Samples the queue at a fixed rate instead of reacting to every queue event
+TaskMgr * TaskMgr__create(EventQueue * queue);
 void TaskMgr__destroy(TaskMgr* self);
 GtkWidget * TaskMgr__get_widget(TaskMgr * self);
+void TaskMgr__set_scope_resolver(TaskMgr * self, TASKMGR_SCOPE_RESOLVER resolver, void * user_data);
+//Label updated with the "[tasks/workers]" summary on every sample
+void TaskMgr__set_summary_label(TaskMgr * self, GtkWidget * label);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,194 @@
+#include "../gst/onvifinitstaticplugins.h"
+#include "../gst/gtk/gstgtkbasesink.h"
+#include "clogger.h"
+#include <gtk/gtk.h>
+#include <gst/gst.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/*
+ * Grid rendering benchmark. Opens N local test streams, each rendered by its own gtkcustomsink like the grid tiles.
+ *  - "raw"  : videotestsrc straight to the sink. Measures conversion and rendering only.
+ *  - "h264" : videotestsrc encoded with x264enc then decoded by decodebin3, closer to a camera stream.
+ *             The encoder runs in the same process, its cost is included in the CPU figures.
+ *
+ * Every second, reports the total frames rendered per second and the process CPU time per tile.
+ *
+ * Usage : gridbench [tiles] [seconds] [raw|h264] [width] [height]
+ */
+
+#define GRIDBENCH_FRAMERATE 25
+
+typedef struct {
+    GstElement * pipeline;
+    GtkWidget * canvas;
+    gint frames;
+} BenchTile;
+
+typedef struct {
+    BenchTile * tiles;
+    int count;
+    int seconds;
+    int elapsed;
+    long long last_frames;
+    double last_cpu;
+    double last_time;
+    double total_fps;
+} BenchGrid;
+
+static double now_sec(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_sec(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static GstPadProbeReturn count_frame(GstPad * pad, GstPadProbeInfo * info, gpointer user_data){
+    BenchTile * tile = (BenchTile *) user_data;
+    g_atomic_int_inc(&tile->frames);
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean report(gpointer user_data){
+    BenchGrid * grid = (BenchGrid *) user_data;
+    long long frames = 0;
+    for(int i=0;i<grid->count;i++){
+        frames += g_atomic_int_get(&grid->tiles[i].frames);
+    }
+
+    double now = now_sec();
+    double cpu = cpu_sec();
+    double fps = (frames - grid->last_frames) / (now - grid->last_time);
+    double load = (cpu - grid->last_cpu) / (now - grid->last_time) * 100.0;
+    printf("%3ds : %8.1f frames/s total  %6.1f frames/s per tile  %6.1f%% CPU  %5.1f%% CPU per tile\n",
+        grid->elapsed + 1, fps, fps / grid->count, load, load / grid->count);
+
+    //The first sample includes pipeline startup
+    if(grid->elapsed > 0){
+        grid->total_fps += fps;
+    }
+    grid->last_frames = frames;
+    grid->last_cpu = cpu;
+    grid->last_time = now;
+
+    if(++grid->elapsed >= grid->seconds){
+        gtk_main_quit();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int create_tile(BenchTile * tile, GtkWidget * parent, int h264, int width, int height){
+    GError * error = NULL;
+    char description[512];
+    snprintf(description, sizeof(description),
+        "videotestsrc is-live=true pattern=ball ! video/x-raw,width=%d,height=%d,framerate=%d/1 ! %s videoconvert ! gtkcustomsink name=sink",
+        width, height, GRIDBENCH_FRAMERATE,
+        h264 ? "x264enc tune=zerolatency speed-preset=ultrafast ! decodebin3 !" : "");
+
+    tile->frames = 0;
+    tile->pipeline = gst_parse_launch(description, &error);
+    if(!tile->pipeline){
+        C_ERROR("Failed to create test pipeline : %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+        return 0;
+    }
+
+    //Same sink configuration as GstRtspPlayer
+    GstElement * sink = gst_bin_get_by_name(GST_BIN(tile->pipeline), "sink");
+    gst_base_sink_set_qos_enabled(GST_BASE_SINK_CAST(sink),FALSE);
+    gst_base_sink_set_sync(GST_BASE_SINK_CAST(sink),FALSE);
+    tile->canvas = gst_gtk_base_custom_sink_acquire_widget(GST_GTK_BASE_CUSTOM_SINK(sink));
+    gst_gtk_base_custom_sink_set_parent(GST_GTK_BASE_CUSTOM_SINK(sink),parent);
+
+    GstPad * pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, count_frame, tile, NULL);
+    gst_object_unref(pad);
+    gst_object_unref(sink);
+    return 1;
+}
+
+static void delete_event_cb (GtkWidget *widget, GdkEvent *event, gpointer data) {
+    gtk_main_quit();
+}
+
+int main(int argc, char *argv[]){
+    BenchGrid grid;
+
+    gtk_init (&argc, &argv);
+    gst_init (&argc, &argv);
+    onvif_init_static_plugins();
+
+    grid.count = argc > 1 ? atoi(argv[1]) : 16;
+    grid.seconds = argc > 2 ? atoi(argv[2]) : 10;
+    int h264 = argc > 3 && !strcmp(argv[3],"h264");
+    int width = argc > 4 ? atoi(argv[4]) : 640;
+    int height = argc > 5 ? atoi(argv[5]) : 360;
+
+    if(grid.count <= 0 || grid.seconds <= 0 || width <= 0 || height <= 0){
+        printf("Usage : %s [tiles] [seconds] [raw|h264] [width] [height]\n",argv[0]);
+        return 1;
+    }
+
+    printf("tiles=%d seconds=%d mode=%s size=%dx%d@%d\n",grid.count,grid.seconds,h264 ? "h264" : "raw",width,height,GRIDBENCH_FRAMERATE);
+
+    GtkWidget * window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    g_signal_connect (G_OBJECT (window), "delete-event", G_CALLBACK (delete_event_cb), NULL);
+    gtk_window_set_title (GTK_WINDOW (window), "Grid benchmark");
+    gtk_window_set_default_size(GTK_WINDOW(window),1280,720);
+
+    GtkWidget * tiles_grid = gtk_grid_new();
+    gtk_grid_set_row_homogeneous(GTK_GRID(tiles_grid), TRUE);
+    gtk_grid_set_column_homogeneous(GTK_GRID(tiles_grid), TRUE);
+    gtk_container_add(GTK_CONTAINER(window), tiles_grid);
+
+    int columns = (int) ceil(sqrt(grid.count));
+    grid.tiles = calloc(grid.count, sizeof(BenchTile));
+    for(int i=0;i<grid.count;i++){
+        GtkWidget * tile_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+        gtk_widget_set_vexpand (tile_box, TRUE);
+        gtk_widget_set_hexpand (tile_box, TRUE);
+        gtk_grid_attach(GTK_GRID(tiles_grid), tile_box, i % columns, i / columns, 1, 1);
+        if(!create_tile(&grid.tiles[i], tile_box, h264, width, height)){
+            return 1;
+        }
+    }
+
+    gtk_widget_show_all (window);
+
+    for(int i=0;i<grid.count;i++){
+        gst_element_set_state(grid.tiles[i].pipeline, GST_STATE_PLAYING);
+    }
+
+    grid.elapsed = 0;
+    grid.total_fps = 0;
+    grid.last_frames = 0;
+    grid.last_cpu = cpu_sec();
+    grid.last_time = now_sec();
+    g_timeout_add_seconds(1, report, &grid);
+
+    gtk_main();
+
+    if(grid.elapsed > 1){
+        double fps = grid.total_fps / (grid.elapsed - 1);
+        printf("average : %8.1f frames/s total  %6.1f frames/s per tile (%d expected)\n", fps, fps / grid.count, GRIDBENCH_FRAMERATE);
+    }
+
+    for(int i=0;i<grid.count;i++){
+        gst_element_set_state(grid.tiles[i].pipeline, GST_STATE_NULL);
+        gst_object_unref(grid.tiles[i].pipeline);
+        g_object_unref(grid.tiles[i].canvas);
+    }
+    free(grid.tiles);
+    gtk_widget_destroy(window);
+    return 0;
+}
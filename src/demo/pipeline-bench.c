@@ -0,0 +1,142 @@
+#include "../gst/gstrtspplayer.h"
+#include "../gst/onvifinitstaticplugins.h"
+#include "clogger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+/*
+ * Stream switch benchmark. Runs the same stop/play cycles with pipeline recycling off, then on.
+ *  - Without url : stops an idle player repeatedly. Measures the pipeline reset or rebuild alone.
+ *  - With url    : plays the stream until "started", then stops it. Also measures the play to first frame time.
+ *
+ * Each run reports the pipelines built (allocation churn) and recycled per cycle.
+ * The main loop runs between cycles, like it would between two clicks, so the pre-built pipeline pool can refill.
+ *
+ * Usage : pipelinebench [cycles] [url] [user] [pass]
+ */
+
+#define PIPELINEBENCH_START_TIMEOUT_US (10 * G_USEC_PER_SEC)
+
+typedef struct {
+    int started;
+    int failed;
+} BenchSession;
+
+static void started_cb(GstRtspPlayer * player, BenchSession * session){
+    session->started = 1;
+}
+
+static void error_cb(GstRtspPlayer * player, BenchSession * session){
+    session->failed = 1;
+}
+
+static void flush_main_loop(){
+    while(g_main_context_iteration(NULL, FALSE));
+}
+
+static long max_rss_kb(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void run(GtkWidget * parent, int recycle, int cycles, char * url, char * user, char * pass){
+    unsigned long long built_start, recycled_start, built, recycled;
+    BenchSession session;
+    gint64 stop_total = 0;
+    gint64 start_total = 0;
+    int start_count = 0;
+    int failures = 0;
+    long rss_start = max_rss_kb();
+
+    GstRtspPlayer * player = GstRtspPlayer__new();
+    GstRtspPlayer__set_recycle_pipeline(player, recycle);
+    if(url){
+        GstRtspPlayer__set_playback_url(player, url);
+        GstRtspPlayer__set_credentials(player, user, pass);
+    }
+    g_signal_connect (G_OBJECT(player), "started", G_CALLBACK (started_cb), &session);
+    g_signal_connect (G_OBJECT(player), "error", G_CALLBACK (error_cb), &session);
+    GtkWidget * canvas = GstRtspPlayer__createCanvas(player);
+    gtk_box_pack_start(GTK_BOX(parent), canvas, TRUE, TRUE, 0);
+    gtk_widget_show_all(parent);
+    flush_main_loop();
+
+    GstRtspPlayer__get_pipeline_stats(&built_start, &recycled_start);
+    for(int i=0;i<cycles;i++){
+        if(url){
+            session.started = 0;
+            session.failed = 0;
+            gint64 start = g_get_monotonic_time();
+            GstRtspPlayer__play(player);
+            while(!session.started && !session.failed && g_get_monotonic_time() - start < PIPELINEBENCH_START_TIMEOUT_US){
+                g_main_context_iteration(NULL, TRUE);
+            }
+            if(session.started){
+                start_total += g_get_monotonic_time() - start;
+                start_count++;
+            } else {
+                failures++;
+            }
+        }
+
+        gint64 start = g_get_monotonic_time();
+        GstRtspPlayer__stop(player);
+        stop_total += g_get_monotonic_time() - start;
+        flush_main_loop();
+    }
+    GstRtspPlayer__get_pipeline_stats(&built, &recycled);
+
+    printf("%-10s : stop %8.1f us", recycle ? "recycle" : "rebuild", (double) stop_total / cycles);
+    if(url){
+        if(start_count){
+            printf("  start %8.1f ms", (double) start_total / start_count / 1000.0);
+        }
+        printf("  %d failed", failures);
+    }
+    printf("  %.2f built  %.2f recycled per cycle  +%ld kB max rss\n",
+        (double)(built - built_start) / cycles,
+        (double)(recycled - recycled_start) / cycles,
+        max_rss_kb() - rss_start);
+
+    gtk_widget_destroy(canvas);
+    g_object_unref(player);
+    flush_main_loop();
+}
+
+static void delete_event_cb (GtkWidget *widget, GdkEvent *event, gpointer data) {
+    gtk_main_quit();
+}
+
+int main(int argc, char *argv[]){
+    gtk_init (&argc, &argv);
+    gst_init (&argc, &argv);
+    onvif_init_static_plugins();
+
+    int cycles = argc > 1 ? atoi(argv[1]) : 50;
+    char * url = argc > 2 ? argv[2] : NULL;
+    char * user = argc > 3 ? argv[3] : NULL;
+    char * pass = argc > 4 ? argv[4] : NULL;
+
+    if(cycles <= 0){
+        printf("Usage : %s [cycles] [url] [user] [pass]\n",argv[0]);
+        return 1;
+    }
+
+    printf("cycles=%d url=%s\n",cycles,url ? url : "none");
+
+    GtkWidget * window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    g_signal_connect (G_OBJECT (window), "delete-event", G_CALLBACK (delete_event_cb), NULL);
+    gtk_window_set_title (GTK_WINDOW (window), "Pipeline benchmark");
+    gtk_window_set_default_size(GTK_WINDOW(window),640,360);
+    GtkWidget * vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL,0);
+    gtk_container_add(GTK_CONTAINER(window),vbox);
+    gtk_widget_show_all (window);
+
+    run(vbox, 0, cycles, url, user, pass);
+    run(vbox, 1, cycles, url, user, pass);
+
+    gtk_widget_destroy(window);
+    return 0;
+}
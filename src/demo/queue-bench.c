@@ -0,0 +1,329 @@
+#include "../queue/event_queue.h"
+#include "clist_ts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+/*
+ * Microbenchmark comparing the EventQueue pending/running store.
+ *  - "clist"     : Previous store. CListTS guarded by the pool lock, with a linear running_events removal.
+ *  - "intrusive" : QueueEventList guarded by the pool lock, with O(1) unlink.
+ *  - "queue"     : End-to-end EventQueue insert/dispatch throughput.
+ *  - "batch"     : Same as "queue", inserting bursts of BENCH_BATCH events with EventQueue__insert_many.
+ *  - "latency"   : Insert to dispatch latency of small bursts, with the timestamp carried in the inline payload.
+ *  - "spawn"     : Events inserting BENCH_BATCH - 1 follow-ups from their worker, through the pool's shared lanes.
+ *  - "steal"     : Same workload with work stealing, follow-ups going to the spawning worker's deque.
+ *
+ * Each run also reports how many QueueEvent records (or payloads) had to be obtained from malloc.
+ *
+ * Usage : queuebench [events] [producers] [consumers]
+ */
+
+typedef struct {
+    P_MUTEX_TYPE pool_lock;
+    P_COND_TYPE cond;
+    CListTS events;
+    CListTS running_events;
+    QueueEventList ievents;
+    QueueEventList irunning_events;
+    int intrusive;
+    int per_producer;
+    atomic_int consumed;
+    int total;
+} BenchStore;
+
+static double now_sec(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void noop_callback(void * user_data){
+
+}
+
+static void * store_producer(void * data){
+    BenchStore * store = (BenchStore *) data;
+    for(int i=0;i<store->per_producer;i++){
+        QueueEvent * evt = QueueEvent__create(NULL, noop_callback, NULL);
+        P_MUTEX_LOCK(store->pool_lock);
+        if(store->intrusive){
+            QueueEventList__append(&store->ievents,evt);
+        } else {
+            CListTS__add(&store->events,(CObject*)evt);
+        }
+        P_MUTEX_UNLOCK(store->pool_lock);
+        P_COND_SIGNAL(store->cond);
+    }
+    return NULL;
+}
+
+static void * store_consumer(void * data){
+    BenchStore * store = (BenchStore *) data;
+    while(1){
+        QueueEvent * evt = NULL;
+        P_MUTEX_LOCK(store->pool_lock);
+        while(atomic_load(&store->consumed) < store->total){
+            if(store->intrusive){
+                evt = QueueEventList__pop(&store->ievents);
+                if(evt) QueueEventList__append(&store->irunning_events,evt);
+            } else {
+                evt = (QueueEvent *) CListTS__pop(&store->events);
+                if(evt) CListTS__add(&store->running_events,(CObject*)evt);
+            }
+            if(evt){
+                break;
+            }
+            P_COND_WAIT(store->cond, store->pool_lock);
+        }
+        P_MUTEX_UNLOCK(store->pool_lock);
+
+        if(!evt){
+            P_COND_BROADCAST(store->cond);
+            return NULL;
+        }
+
+        P_MUTEX_LOCK(store->pool_lock);
+        if(store->intrusive){
+            QueueEventList__remove(&store->irunning_events,evt);
+        } else {
+            CListTS__remove_record(&store->running_events,(CObject*)evt);
+        }
+        P_MUTEX_UNLOCK(store->pool_lock);
+        CObject__destroy((CObject*)evt);
+
+        if(atomic_fetch_add(&store->consumed,1) + 1 == store->total){
+            P_COND_BROADCAST(store->cond);
+        }
+    }
+}
+
+static double run_store(int intrusive, int events, int producers, int consumers){
+    BenchStore store;
+    P_THREAD_TYPE threads[producers + consumers];
+
+    memset(&store,0,sizeof(BenchStore));
+    P_MUTEX_SETUP(store.pool_lock);
+    P_COND_SETUP(store.cond);
+    CListTS__init(&store.events);
+    CListTS__init(&store.running_events);
+    QueueEventList__init(&store.ievents);
+    QueueEventList__init(&store.irunning_events);
+    store.intrusive = intrusive;
+    store.per_producer = events / producers;
+    store.total = store.per_producer * producers;
+    atomic_init(&store.consumed, 0);
+
+    double start = now_sec();
+    for(int i=0;i<consumers;i++){
+        pthread_create(&threads[i], NULL, store_consumer, &store);
+    }
+    for(int i=0;i<producers;i++){
+        pthread_create(&threads[consumers+i], NULL, store_producer, &store);
+    }
+    for(int i=0;i<producers + consumers;i++){
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_sec() - start;
+
+    CObject__destroy((CObject*)&store.events);
+    CObject__destroy((CObject*)&store.running_events);
+    P_COND_CLEANUP(store.cond);
+    P_MUTEX_CLEANUP(store.pool_lock);
+    return elapsed;
+}
+
+#define BENCH_BATCH 64
+
+static atomic_int dispatched;
+
+static void count_callback(void * user_data){
+    atomic_fetch_add(&dispatched,1);
+}
+
+static EventQueue * spawn_queue;
+
+static void spawn_callback(void * user_data){
+    for(int i=1;i<BENCH_BATCH;i++){
+        EventQueue__insert(spawn_queue, NULL, count_callback, NULL);
+    }
+    atomic_fetch_add(&dispatched,1);
+}
+
+typedef struct {
+    double inserted;
+    int index;
+} LatencyPayload;
+
+static double * latencies;
+
+static void latency_callback(void * user_data){
+    LatencyPayload * payload = (LatencyPayload *) user_data;
+    latencies[payload->index] = now_sec() - payload->inserted;
+    atomic_fetch_add(&dispatched,1);
+}
+
+static int compare_double(const void * a, const void * b){
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return da < db ? -1 : da > db;
+}
+
+//Bursts are small enough to measure dispatch overhead rather than backlog
+static void run_latency(int events, int consumers, int burst){
+    LatencyPayload payload;
+    EventQueue * queue = EventQueue__create(NULL,NULL);
+    for(int i=0;i<consumers;i++){
+        EventQueue__start(queue);
+    }
+    atomic_store(&dispatched,0);
+    latencies = malloc(sizeof(double) * events);
+
+    for(int i=0;i<events;i++){
+        payload.inserted = now_sec();
+        payload.index = i;
+        EventQueue__insert_copy(queue, EVENTQUEUE_PRIORITY_NORMAL, NULL, latency_callback, &payload, sizeof(payload), NULL);
+        if((i+1) % burst == 0){
+            while(atomic_load(&dispatched) < i+1){
+                usleep(10);
+            }
+        }
+    }
+    while(atomic_load(&dispatched) < events){
+        usleep(100);
+    }
+
+    CObject__destroy((CObject*)queue);
+
+    qsort(latencies,events,sizeof(double),compare_double);
+    printf("%-10s : p50 %6.1f us  p99 %6.1f us  max %8.1f us\n","latency",
+        latencies[events / 2] * 1e6,
+        latencies[(int)(events * 0.99)] * 1e6,
+        latencies[events - 1] * 1e6);
+    free(latencies);
+}
+
+static void print_allocations(const char * name, int events, unsigned long long * last){
+    unsigned long long allocations;
+    QueueEvent__get_pool_stats(&allocations,NULL);
+    printf("%-10s : %llu mallocs (%.3f per event)\n",name,allocations - *last,(double)(allocations - *last) / events);
+    *last = allocations;
+}
+
+static double run_queue(int events, int consumers){
+    EventQueue * queue = EventQueue__create(NULL,NULL);
+    for(int i=0;i<consumers;i++){
+        EventQueue__start(queue);
+    }
+    atomic_store(&dispatched,0);
+
+    double start = now_sec();
+    for(int i=0;i<events;i++){
+        EventQueue__insert(queue, NULL, count_callback, NULL);
+    }
+    while(atomic_load(&dispatched) < events){
+        usleep(100);
+    }
+    double elapsed = now_sec() - start;
+
+    CObject__destroy((CObject*)queue);
+    return elapsed;
+}
+
+static double run_batch(int events, int consumers){
+    QueueEvent * batch[BENCH_BATCH];
+    EventQueue * queue = EventQueue__create(NULL,NULL);
+    for(int i=0;i<consumers;i++){
+        EventQueue__start(queue);
+    }
+    atomic_store(&dispatched,0);
+
+    double start = now_sec();
+    for(int i=0;i<events;i+=BENCH_BATCH){
+        int count = events - i < BENCH_BATCH ? events - i : BENCH_BATCH;
+        for(int j=0;j<count;j++){
+            batch[j] = QueueEvent__create(NULL, count_callback, NULL);
+        }
+        EventQueue__insert_many(queue, batch, count);
+    }
+    while(atomic_load(&dispatched) < events){
+        usleep(100);
+    }
+    double elapsed = now_sec() - start;
+
+    CObject__destroy((CObject*)queue);
+    return elapsed;
+}
+
+static double run_spawn(int events, int consumers, int work_stealing){
+    EventQueueSnapshot snapshot;
+    int roots = events / BENCH_BATCH;
+    spawn_queue = EventQueue__create(NULL,NULL);
+    EventQueue__set_work_stealing(spawn_queue, work_stealing);
+    for(int i=0;i<consumers;i++){
+        EventQueue__start(spawn_queue);
+    }
+    atomic_store(&dispatched,0);
+
+    double start = now_sec();
+    for(int i=0;i<roots;i++){
+        EventQueue__insert(spawn_queue, NULL, spawn_callback, NULL);
+    }
+    while(atomic_load(&dispatched) < roots * BENCH_BATCH){
+        usleep(100);
+    }
+    double elapsed = now_sec() - start;
+
+    EventQueue__snapshot(spawn_queue, &snapshot, NULL, 0);
+    if(work_stealing){
+        printf("%-10s : %llu events stolen\n","steal",snapshot.stolen_count);
+    }
+    CObject__destroy((CObject*)spawn_queue);
+    return elapsed;
+}
+
+int main(int argc, char *argv[]){
+    int events = argc > 1 ? atoi(argv[1]) : 200000;
+    int producers = argc > 2 ? atoi(argv[2]) : 4;
+    int consumers = argc > 3 ? atoi(argv[3]) : 8;
+
+    if(events <= 0 || producers <= 0 || consumers <= 0){
+        printf("Usage : %s [events] [producers] [consumers]\n",argv[0]);
+        return 1;
+    }
+
+    printf("events=%d producers=%d consumers=%d\n",events,producers,consumers);
+
+    unsigned long long allocations = 0;
+    double t = run_store(0, events, producers, consumers);
+    printf("%-10s : %8.3f s  %12.0f events/s\n","clist",t,events / t);
+    print_allocations("clist",events,&allocations);
+
+    t = run_store(1, events, producers, consumers);
+    printf("%-10s : %8.3f s  %12.0f events/s\n","intrusive",t,events / t);
+    print_allocations("intrusive",events,&allocations);
+
+    t = run_queue(events, consumers);
+    printf("%-10s : %8.3f s  %12.0f events/s\n","queue",t,events / t);
+    print_allocations("queue",events,&allocations);
+
+    t = run_batch(events, consumers);
+    printf("%-10s : %8.3f s  %12.0f events/s\n","batch",t,events / t);
+    print_allocations("batch",events,&allocations);
+
+    t = run_spawn(events, consumers, 0);
+    printf("%-10s : %8.3f s  %12.0f events/s\n","spawn",t,events / t);
+    print_allocations("spawn",events,&allocations);
+
+    t = run_spawn(events, consumers, 1);
+    printf("%-10s : %8.3f s  %12.0f events/s\n","steal",t,events / t);
+    print_allocations("steal",events,&allocations);
+
+    run_latency(events, consumers, 16);
+    print_allocations("latency",events,&allocations);
+
+    return 0;
+}
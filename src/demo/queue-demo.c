@@ -1,48 +1,411 @@
 #include "../queue/event_queue.h"
+#include "cobject.h"
 #include <stdio.h>
-#include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+/*
+ * EventQueue benchmark and stress suite.
+ *
+ * bench  : Insert/dispatch throughput and p50/p99/p999 insert to dispatch latency
+ *          across producer/consumer counts and payload sizes, then scope cancellation cost under load.
+ * stress : Random strand, delayed, coalesced and cancelled work with a shutdown racing the producers.
+ *          Checks that strand events run one at a time in insertion order, that every event is either
+ *          dispatched or cleaned up exactly once and that shutdown leaves nothing behind.
+ *
+ * Usage : queuedemo bench [events]
+ *         queuedemo stress [seconds]
+ */
+
+#define BENCH_MAX_THREADS 16
+#define STRESS_PRODUCERS 4
+#define STRESS_SCOPES 8 //Per producer
+#define STRESS_ROUND_MS 250
+#define STRESS_MAX_EVENTS 2000000
+
+static double now_sec(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_ms(int ms){
+    usleep(ms * 1000);
+}
+
+/*
+ * Benchmark
+ */
+
+typedef struct {
+    double inserted;
+    int index;
+} BenchHeader;
+
+typedef struct {
+    EventQueue * queue;
+    int first;
+    int count;
+    size_t payload_size;
+} BenchProducer;
+
+static double * latencies;
+static atomic_int dispatched;
+
+static void bench_callback(void * user_data){
+    BenchHeader * header = (BenchHeader *) user_data;
+    latencies[header->index] = now_sec() - header->inserted;
+    atomic_fetch_add_explicit(&dispatched, 1, memory_order_relaxed);
+}
+
+static void * bench_producer(void * data){
+    BenchProducer * producer = (BenchProducer *) data;
+    unsigned char payload[producer->payload_size];
+    BenchHeader * header = (BenchHeader *) payload;
+    memset(payload,0,producer->payload_size);
+    for(int i=0;i<producer->count;i++){
+        header->index = producer->first + i;
+        header->inserted = now_sec();
+        EventQueue__insert_copy(producer->queue, EVENTQUEUE_PRIORITY_NORMAL, NULL, bench_callback, payload, producer->payload_size, NULL);
+    }
+    QueueEvent__release_thread_cache();
+    return NULL;
+}
+
+static int compare_double(const void * a, const void * b){
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return da < db ? -1 : da > db;
+}
+
+static void bench_run(int events, int producers, int consumers, size_t payload_size){
+    pthread_t threads[BENCH_MAX_THREADS];
+    BenchProducer args[BENCH_MAX_THREADS];
+    unsigned long long allocations_start, allocations_end;
+    int per_producer = events / producers;
+    int total = per_producer * producers;
+
+    EventQueue * queue = EventQueue__create(NULL,NULL);
+    for(int i=0;i<consumers;i++){
+        EventQueue__start(queue);
+    }
+    atomic_store(&dispatched,0);
+    QueueEvent__get_pool_stats(&allocations_start,NULL);
 
-void evt_callback(void * user_data){
-    printf("evt_callback\n");
-    char * data = (char *) user_data;
+    double start = now_sec();
+    for(int i=0;i<producers;i++){
+        args[i].queue = queue;
+        args[i].first = i * per_producer;
+        args[i].count = per_producer;
+        args[i].payload_size = payload_size;
+        pthread_create(&threads[i], NULL, bench_producer, &args[i]);
+    }
+    for(int i=0;i<producers;i++){
+        pthread_join(threads[i], NULL);
+    }
+    while(atomic_load(&dispatched) < total){
+        usleep(50);
+    }
+    double elapsed = now_sec() - start;
 
-    printf("data : %s\n",data);
+    QueueEvent__get_pool_stats(&allocations_end,NULL);
+    EventQueue__shutdown(queue,1000);
+    CObject__destroy((CObject*)queue);
 
+    qsort(latencies,total,sizeof(double),compare_double);
+    printf("%4d %4d %6zu | %10.0f/s | %9.1f %9.1f %9.1f %10.1f | %6.3f\n",
+        producers, consumers, payload_size,
+        total / elapsed,
+        latencies[total / 2] * 1e6,
+        latencies[(int)(total * 0.99)] * 1e6,
+        latencies[(int)(total * 0.999)] * 1e6,
+        latencies[total - 1] * 1e6,
+        (double)(allocations_end - allocations_start) / total);
 }
 
-void eventqueue_dispatch_cb(QueueThread * thread, EventQueueType type, void * user_data){
-    EventQueue * queue = QueueThread__get_queue(thread);
-    int running = EventQueue__get_running_event_count(queue);
+static atomic_int gate_open;
+
+static void gate_callback(void * user_data){
+    while(!atomic_load(&gate_open)){
+        usleep(100);
+    }
+}
+
+static void noop_callback(void * user_data){
+
+}
+
+//Cancels half the scopes while every worker is busy and the rest of the queue is loaded
+static void bench_cancel(int scopes_count, int per_scope, int consumers){
+    int dummy[scopes_count];
+    void * scopes[scopes_count];
+    EventQueue * queue = EventQueue__create(NULL,NULL);
+    for(int i=0;i<consumers;i++){
+        EventQueue__start(queue);
+    }
+
+    atomic_store(&gate_open,0);
+    for(int i=0;i<consumers;i++){
+        EventQueue__insert(queue, NULL, gate_callback, NULL);
+    }
+    for(int i=0;i<scopes_count;i++){
+        scopes[i] = &dummy[i];
+    }
+    for(int j=0;j<per_scope;j++){
+        for(int i=0;i<scopes_count;i++){
+            EventQueue__insert_with_priority(queue, i % EVENTQUEUE_PRIORITY_COUNT, scopes[i], noop_callback, NULL);
+        }
+    }
+
     int pending = EventQueue__get_pending_event_count(queue);
-    int total = EventQueue__get_thread_count(queue);
+    double start = now_sec();
+    EventQueue__cancel_scopes(queue, scopes, scopes_count / 2);
+    double elapsed = now_sec() - start;
+    int cancelled = pending - EventQueue__get_pending_event_count(queue);
+
+    atomic_store(&gate_open,1);
+    EventQueue__shutdown(queue,1000);
+    CObject__destroy((CObject*)queue);
+
+    printf("%6d scopes x %5d events | %8d cancelled in %9.1f us (%6.3f us/event)\n",
+        scopes_count, per_scope, cancelled, elapsed * 1e6, cancelled ? elapsed * 1e6 / cancelled : 0);
+}
+
+static int bench_main(int events){
+    static const int producer_counts[] = { 1, 4 };
+    static const int consumer_counts[] = { 1, 4, 8 };
+    static const size_t payload_sizes[] = { sizeof(BenchHeader), QUEUEEVENT_INLINE_SIZE, 256 };
+
+    latencies = malloc(sizeof(double) * events);
+    printf("Throughput and latency (%d events, latency in us)\n",events);
+    printf("prod cons  bytes |   throughput |       p50       p99      p999        max | mallocs/event\n");
+    for(size_t s=0;s<sizeof(payload_sizes)/sizeof(payload_sizes[0]);s++){
+        for(size_t p=0;p<sizeof(producer_counts)/sizeof(producer_counts[0]);p++){
+            for(size_t c=0;c<sizeof(consumer_counts)/sizeof(consumer_counts[0]);c++){
+                bench_run(events, producer_counts[p], consumer_counts[c], payload_sizes[s]);
+            }
+        }
+    }
+    free(latencies);
 
-    char str[10];
-    memset(&str,'\0',sizeof(str));
-    sprintf(str, "[%d/%d]", running + pending,total);
+    printf("\nScope cancellation under load\n");
+    bench_cancel(16, 1000, 4);
+    bench_cancel(256, 100, 4);
+    bench_cancel(4096, 10, 4);
+    return 0;
 }
 
-int main()
-{
-    EventQueue * queue = EventQueue__create(eventqueue_dispatch_cb,NULL);
+/*
+ * Stress
+ */
 
-    EventQueue__insert(queue,evt_callback,"Data 1");
-    EventQueue__insert(queue,evt_callback,"Data 2");
-    EventQueue__insert(queue,evt_callback,"Data 3");
-    EventQueue__insert(queue,evt_callback,"Data 4");
-    EventQueue__insert(queue,evt_callback,"Data 5");
-    EventQueue__insert(queue,evt_callback,"Data 6");
+typedef enum {
+    STRESS_QUEUED     = 0,
+    STRESS_DISPATCHED = 1,
+    STRESS_CLEANED    = 2
+} StressState;
 
+typedef struct {
+    atomic_int active; //Strand events of the scope currently running
+    atomic_int last_seq; //Sequence of the last strand event dispatched
+    int next_seq; //Only touched by the owning producer
+} StressScope;
 
-    EventQueue__start(queue);
-    EventQueue__start(queue);
-    EventQueue__start(queue);
-    EventQueue__start(queue);
-    while(1){
-        sleep(3);
-        // EventQueue__insert(queue,evt);
-        // snprintf(numstr, 12, "Data %d", index++);
-        // printf("buff %s\n",numstr);
-        EventQueue__insert(queue,evt_callback,"Data 6");
+typedef struct {
+    int id;
+    int scope;
+    int seq; //Strand sequence, 0 if not a strand event
+} StressPayload;
+
+typedef struct {
+    EventQueue * queue;
+    int index;
+    unsigned int seed;
+    atomic_int * running;
+} StressProducer;
+
+static StressScope stress_scopes[STRESS_PRODUCERS * STRESS_SCOPES];
+static atomic_char * stress_states;
+static atomic_int stress_next_id;
+static atomic_int stress_violations;
+
+static void stress_violation(const char * msg, int id){
+    if(atomic_fetch_add(&stress_violations,1) < 20){
+        printf("VIOLATION : %s (event %d)\n",msg,id);
+    }
+}
+
+static void stress_resolve(int id, StressState state){
+    char expected = STRESS_QUEUED;
+    if(!atomic_compare_exchange_strong(&stress_states[id],&expected,state)){
+        stress_violation(state == STRESS_DISPATCHED ? "dispatched after being resolved" : "cleaned up after being resolved",id);
+    }
+}
+
+static void stress_callback(void * user_data){
+    StressPayload * payload = (StressPayload *) user_data;
+    if(payload->seq){
+        StressScope * scope = &stress_scopes[payload->scope];
+        if(atomic_fetch_add(&scope->active,1) != 0){
+            stress_violation("strand events ran concurrently",payload->id);
+        }
+        if(payload->seq <= atomic_load(&scope->last_seq)){
+            stress_violation("strand events ran out of order",payload->id);
+        }
+        atomic_store(&scope->last_seq,payload->seq);
+        if(payload->id % 7 == 0){
+            usleep(50);
+        }
+        atomic_fetch_sub(&scope->active,1);
+    }
+    stress_resolve(payload->id,STRESS_DISPATCHED);
+}
+
+static void stress_cleanup(void * user_data){
+    StressPayload * payload = (StressPayload *) user_data;
+    stress_resolve(payload->id,STRESS_CLEANED);
+}
+
+static void * stress_producer(void * data){
+    StressProducer * producer = (StressProducer *) data;
+    StressPayload payload;
+    QueueEvent * evt;
+
+    while(atomic_load(producer->running)){
+        payload.id = atomic_fetch_add(&stress_next_id,1);
+        if(payload.id >= STRESS_MAX_EVENTS){
+            atomic_fetch_sub(&stress_next_id,1);
+            break;
+        }
+        payload.scope = producer->index * STRESS_SCOPES + rand_r(&producer->seed) % STRESS_SCOPES;
+        payload.seq = 0;
+
+        int kind = rand_r(&producer->seed) % 10;
+        if(kind < 6){
+            //Strand events carry the sequence checked at dispatch
+            payload.seq = ++stress_scopes[payload.scope].next_seq;
+            evt = QueueEvent__create_copy(&stress_scopes[payload.scope], stress_callback, &payload, sizeof(payload));
+            QueueEvent__set_strand(evt,1);
+            QueueEvent__set_priority(evt,rand_r(&producer->seed) % EVENTQUEUE_PRIORITY_COUNT);
+            QueueEvent__set_cleanup_callback(evt,stress_cleanup);
+            EventQueue__insert_event(producer->queue,evt);
+        } else if(kind < 8){
+            //Superseded events must be cleaned up
+            evt = QueueEvent__create_copy(&stress_scopes[payload.scope], stress_callback, &payload, sizeof(payload));
+            QueueEvent__set_coalesce(evt,NULL);
+            QueueEvent__set_cleanup_callback(evt,stress_cleanup);
+            EventQueue__insert_event(producer->queue,evt);
+        } else {
+            evt = QueueEvent__create_copy(&stress_scopes[payload.scope], stress_callback, &payload, sizeof(payload));
+            QueueEvent__set_cleanup_callback(evt,stress_cleanup);
+            EventQueue__schedule_event(producer->queue,evt,rand_r(&producer->seed) % 20);
+        }
+
+        if(payload.id % 64 == 0){
+            usleep(rand_r(&producer->seed) % 200);
+        }
+    }
+    QueueEvent__release_thread_cache();
+    return NULL;
+}
+
+static int stress_round(int round){
+    pthread_t threads[STRESS_PRODUCERS];
+    StressProducer producers[STRESS_PRODUCERS];
+    atomic_int running;
+    unsigned int seed = round;
+    int first_id = atomic_load(&stress_next_id);
+    int violations = atomic_load(&stress_violations);
+
+    EventQueue * queue = EventQueue__create(NULL,NULL);
+    EventQueue__set_elastic(queue,2,8);
+    EventQueue__set_elastic_timing(queue,5,50);
+
+    atomic_init(&running,1);
+    for(int i=0;i<STRESS_PRODUCERS;i++){
+        producers[i].queue = queue;
+        producers[i].index = i;
+        producers[i].seed = round * STRESS_PRODUCERS + i;
+        producers[i].running = &running;
+        pthread_create(&threads[i], NULL, stress_producer, &producers[i]);
     }
-}
\ No newline at end of file
+
+    //Cancel random scopes while producers keep inserting
+    double end = now_sec() + STRESS_ROUND_MS / 1000.0;
+    while(now_sec() < end){
+        void * scopes[2];
+        scopes[0] = &stress_scopes[rand_r(&seed) % (STRESS_PRODUCERS * STRESS_SCOPES)];
+        scopes[1] = &stress_scopes[rand_r(&seed) % (STRESS_PRODUCERS * STRESS_SCOPES)];
+        EventQueue__cancel_scopes(queue,scopes,2);
+        sleep_ms(rand_r(&seed) % 10);
+    }
+
+    //Shutdown races the producers, later inserts must be rejected and cleaned up
+    int stragglers = EventQueue__shutdown(queue,2000);
+    atomic_store(&running,0);
+    for(int i=0;i<STRESS_PRODUCERS;i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    if(stragglers){
+        stress_violation("workers left after shutdown",-1);
+    }
+    if(EventQueue__get_pending_event_count(queue) || EventQueue__get_running_event_count(queue) || EventQueue__get_scheduled_event_count(queue)){
+        stress_violation("events left after shutdown",-1);
+    }
+    CObject__destroy((CObject*)queue);
+
+    int last_id = atomic_load(&stress_next_id);
+    int counts[3] = { 0, 0, 0 };
+    for(int id=first_id;id<last_id;id++){
+        counts[(int) atomic_load(&stress_states[id])]++;
+    }
+    if(counts[STRESS_QUEUED]){
+        stress_violation("events neither dispatched nor cleaned up",first_id);
+    }
+
+    printf("round %3d : %7d events, %7d dispatched, %7d cleaned up, %d violations\n",
+        round, last_id - first_id, counts[STRESS_DISPATCHED], counts[STRESS_CLEANED],
+        atomic_load(&stress_violations) - violations);
+    return last_id < STRESS_MAX_EVENTS;
+}
+
+static int stress_main(int seconds){
+    stress_states = calloc(STRESS_MAX_EVENTS,sizeof(atomic_char));
+    atomic_init(&stress_next_id,0);
+    atomic_init(&stress_violations,0);
+
+    double end = now_sec() + seconds;
+    for(int round=0;now_sec() < end;round++){
+        if(!stress_round(round)){
+            printf("Event budget exhausted\n");
+            break;
+        }
+    }
+    free(stress_states);
+
+    int violations = atomic_load(&stress_violations);
+    printf("%s : %d violations\n",violations ? "FAILED" : "PASSED",violations);
+    return violations ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    if(argc > 1 && !strcmp(argv[1],"bench")){
+        int events = argc > 2 ? atoi(argv[2]) : 200000;
+        if(events > 0){
+            return bench_main(events);
+        }
+    } else if(argc > 1 && !strcmp(argv[1],"stress")){
+        int seconds = argc > 2 ? atoi(argv[2]) : 10;
+        if(seconds > 0){
+            return stress_main(seconds);
+        }
+    }
+
+    printf("Usage : %s bench [events]\n",argv[0]);
+    printf("        %s stress [seconds]\n",argv[0]);
+    return 1;
+}
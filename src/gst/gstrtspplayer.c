@@ -7,6 +7,11 @@
 #include "gst/rtsp/gstrtsptransport.h"
 #include "url_parser.h"
 
+//Spare pipelines built ahead of time, shared by every player. A player replacing its pipeline takes one instead of building it on the stop path.
+#define RTSPPLAYER_PIPELINE_POOL_SIZE 2
+//The sink renders without clock sync, a frame further behind the clock counts as late. A decoder that can't keep up builds up that delay.
+#define RTSPPLAYER_LATE_FRAME_MS 500
+
 typedef enum {
     RTSP_FALLBACK_NONE,
     RTSP_FALLBACK_PORT,
@@ -35,6 +40,22 @@ typedef struct {
     int retry;
     //Playing or trying to play
     int playing;
+    //Reuse the pipeline between sessions instead of replacing it on every stop
+    int recycle;
+    //Set when an element outside of rtspsrc failed. The next stop replaces the pipeline even when recycling.
+    int pipeline_dirty;
+    //Time at which play was requested, used to report the time to first frame
+    gint64 play_time;
+    //Standby sessions are paused once started, keeping the negotiated session and the last frame. Guarded by prop_lock.
+    int standby;
+    int standby_paused;
+    //The video branch reached PLAYING since the last stop. Guarded by prop_lock.
+    int started;
+    //Stream health of the current session, see GstRtspPlayer__get_stats. Guarded by stats_lock.
+    GList * jitterbuffers;
+    guint64 frames;
+    guint64 late_frames;
+    guint64 dropped_frames;
 
     //Grid holding the canvas
     GtkWidget *canvas_handle;
@@ -45,6 +66,10 @@ typedef struct {
 
     P_MUTEX_TYPE prop_lock;
     P_MUTEX_TYPE player_lock;
+    //Serializes standby state changes, held across gst_element_set_state unlike prop_lock
+    P_MUTEX_TYPE standby_lock;
+    //Taken from the streaming threads, rtpbin holds its own lock while emitting new-jitterbuffer
+    P_MUTEX_TYPE stats_lock;
 
     char * user;
     char * pass;
@@ -63,11 +88,22 @@ enum {
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+G_LOCK_DEFINE_STATIC(pipeline_pool);
+static GstElement * pipeline_pool[RTSPPLAYER_PIPELINE_POOL_SIZE];
+static int pipeline_pool_count = 0;
+static guint pipeline_pool_refill = 0;
+static int player_count = 0;
+static unsigned long long pipelines_built = 0;
+static unsigned long long pipelines_recycled = 0;
+
 G_DEFINE_TYPE_WITH_PRIVATE(GstRtspPlayer, GstRtspPlayer_, G_TYPE_OBJECT)
 
 static void 
 GstRtspPlayerPrivate__message_handler (GstBus * bus, GstMessage * message, GstRtspPlayerPrivate * priv);
 void GstRtspPlayerPrivate__stop(GstRtspPlayerPrivate * priv);
+static void GstRtspPlayerPrivate__setup_pipeline (GstRtspPlayerPrivate * priv);
+static void GstRtspPlayerPrivate__discard_pipeline (GstRtspPlayerPrivate * priv);
+static void GstRtspPlayer__clear_pipeline_pool();
 
 static void
 GstRtspPlayer__dispose (GObject *gobject)
@@ -90,7 +126,17 @@ GstRtspPlayer__dispose (GObject *gobject)
     // }
 
     if(GST_IS_ELEMENT(priv->pipeline)){
-        gst_object_unref (priv->pipeline);
+        GstRtspPlayerPrivate__discard_pipeline(priv);
+    }
+    g_list_free(priv->dynamic_elements);
+    priv->dynamic_elements = NULL;
+
+    //Spare pipelines are only kept while players exist
+    G_LOCK(pipeline_pool);
+    int last = --player_count == 0;
+    G_UNLOCK(pipeline_pool);
+    if(last){
+        GstRtspPlayer__clear_pipeline_pool();
     }
 
     RtspBackchannel__destroy(priv->backchannel);
@@ -116,6 +162,8 @@ GstRtspPlayer__dispose (GObject *gobject)
     }
     P_MUTEX_CLEANUP(priv->prop_lock);
     P_MUTEX_CLEANUP(priv->player_lock);
+    P_MUTEX_CLEANUP(priv->standby_lock);
+    P_MUTEX_CLEANUP(priv->stats_lock);
 
     /* Always chain up to the parent class; there is no need to check if
     * the parent class implements the dispose() virtual function: it is
@@ -202,6 +250,8 @@ void GstRtspPlayerPrivate__play(GstRtspPlayerPrivate* priv){
     if(priv->location)
         g_object_set (G_OBJECT (priv->src), "location", priv->location, NULL);
     P_MUTEX_UNLOCK(priv->prop_lock);
+    //Recycled pipelines keep the previous session's value
+    g_object_set (G_OBJECT (priv->src), "backchannel", priv->enable_backchannel, NULL);
 
     C_DEBUG("RtspPlayer__play retry[%i] - playing[%i]\n",priv->retry,priv->playing);
     priv->playing = 1;
@@ -210,7 +260,12 @@ void GstRtspPlayerPrivate__play(GstRtspPlayerPrivate* priv){
     ret = gst_element_set_state (priv->pipeline, GST_STATE_PLAYING);
     if (ret == GST_STATE_CHANGE_FAILURE) {
         C_ERROR ("Unable to set the pipeline to the playing state.\n");
-        gst_object_unref (priv->pipeline);
+        //Replaced right away, the player must always hold a valid pipeline to stop or recycle
+        gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+        g_list_free(priv->dynamic_elements);
+        priv->dynamic_elements = NULL;
+        GstRtspPlayerPrivate__discard_pipeline(priv);
+        GstRtspPlayerPrivate__setup_pipeline(priv);
         goto exit;
     }
 
@@ -227,6 +282,7 @@ void GstRtspPlayer__play(GstRtspPlayer* self){
     priv->retry = 0;
     priv->fallback = RTSP_FALLBACK_NONE;
     priv->enable_backchannel = 1;//TODO Handle parameter input...
+    priv->play_time = g_get_monotonic_time();
     GstRtspPlayerPrivate__play(priv);
 }
 
@@ -264,6 +320,38 @@ on_decoder_pad_added (GstElement *element, GstPad *new_pad, gpointer data){
     gst_object_unref (sinkpad);
 }
 
+//Runs on the streaming thread for every frame reaching the sink
+static GstPadProbeReturn
+GstRtspPlayerPrivate__sink_probe (GstPad * pad, GstPadProbeInfo * info, GstRtspPlayerPrivate * priv)
+{
+    GstBuffer * buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstElement * sink = GST_ELEMENT (GST_PAD_PARENT (pad));
+    GstEvent * event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+    GstClock * clock = gst_element_get_clock (sink);
+    GstClockTimeDiff lateness = 0;
+
+    if(event && clock && GST_BUFFER_PTS_IS_VALID (buffer)){
+        const GstSegment * segment;
+        gst_event_parse_segment (event, &segment);
+        GstClockTime running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME, GST_BUFFER_PTS (buffer));
+        if(GST_CLOCK_TIME_IS_VALID (running_time)){
+            lateness = GST_CLOCK_DIFF (running_time, gst_clock_get_time (clock) - gst_element_get_base_time (sink));
+        }
+    }
+    if(event)
+        gst_event_unref (event);
+    if(clock)
+        gst_object_unref (clock);
+
+    P_MUTEX_LOCK(priv->stats_lock);
+    priv->frames++;
+    if(lateness > RTSPPLAYER_LATE_FRAME_MS * GST_MSECOND)
+        priv->late_frames++;
+    P_MUTEX_UNLOCK(priv->stats_lock);
+
+    return GST_PAD_PROBE_OK;
+}
+
 static GstElement*
 GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
     GstElement *vdecoder, *videoconvert, *overlay_comp, *video_bin;
@@ -307,6 +395,10 @@ GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
         C_WARN ("Linking (A)-1 part with part (A)-2 Fail...");
     }
 
+    pad = gst_element_get_static_pad (priv->sink, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) GstRtspPlayerPrivate__sink_probe, priv, NULL);
+    gst_object_unref (pad);
+
     pad = gst_element_get_static_pad (vdecoder, "sink");
     if (!pad) {
         // TODO gst_object_unref 
@@ -392,6 +484,26 @@ GstRtspPlayerPrivate__create_audio_pad(){
     return audio_bin;
 }
 
+//A recycled pipeline keeps the bins of the previous session. rtspsrc removed its pads on stop, leaving them unlinked.
+static GstElement *
+GstRtspPlayerPrivate__find_idle_bin(GstRtspPlayerPrivate * priv, const char * name){
+    GList *node_itr = priv->dynamic_elements;
+    while (node_itr != NULL)
+    {
+        GstElement * bin = (GstElement *) node_itr->data;
+        if(strcmp(GST_OBJECT_NAME(bin),name) == 0){
+            GstPad * pad = gst_element_get_static_pad (bin, "bin_sink");
+            gboolean linked = gst_pad_is_linked(pad);
+            gst_object_unref (pad);
+            if(!linked){
+                return bin;
+            }
+        }
+        node_itr = g_list_next(node_itr);
+    }
+    return NULL;
+}
+
 static void
 GstRtspPlayerPrivate__on_rtsp_pad_added (GstElement *element, GstPad *new_pad, GstRtspPlayerPrivate * priv){
     C_DEBUG ("Received new pad '%s' from '%s':\n", GST_PAD_NAME (new_pad), GST_ELEMENT_NAME (element));
@@ -412,9 +524,12 @@ GstRtspPlayerPrivate__on_rtsp_pad_added (GstElement *element, GstPad *new_pad, G
 
     //TODO perform stream selection by stream codec not payload
     if (g_strrstr(capsName, "video")){
-        GstElement * video_bin = GstRtspPlayerPrivate__create_video_pad(priv);
-
-        gst_bin_add_many (GST_BIN (priv->pipeline), video_bin, NULL);
+        GstElement * video_bin = GstRtspPlayerPrivate__find_idle_bin(priv, "video_bin");
+        int reused = video_bin != NULL;
+        if(!reused){
+            video_bin = GstRtspPlayerPrivate__create_video_pad(priv);
+            gst_bin_add_many (GST_BIN (priv->pipeline), video_bin, NULL);
+        }
 
         sink_pad = gst_element_get_static_pad (video_bin, "bin_sink");
 
@@ -424,12 +539,16 @@ GstRtspPlayerPrivate__on_rtsp_pad_added (GstElement *element, GstPad *new_pad, G
             //TODO Show error on canvas
             goto exit;
         }
-        priv->dynamic_elements = g_list_append(priv->dynamic_elements, video_bin);
+        if(!reused)
+            priv->dynamic_elements = g_list_append(priv->dynamic_elements, video_bin);
         gst_element_sync_state_with_parent(video_bin);
     } else if (g_strrstr(capsName,"audio")){
-        GstElement * audio_bin = GstRtspPlayerPrivate__create_audio_pad();
-
-        gst_bin_add_many (GST_BIN (priv->pipeline), audio_bin, NULL);
+        GstElement * audio_bin = GstRtspPlayerPrivate__find_idle_bin(priv, "audiobin");
+        int reused = audio_bin != NULL;
+        if(!reused){
+            audio_bin = GstRtspPlayerPrivate__create_audio_pad();
+            gst_bin_add_many (GST_BIN (priv->pipeline), audio_bin, NULL);
+        }
 
         sink_pad = gst_element_get_static_pad (audio_bin, "bin_sink");
         pad_ret = gst_pad_link (new_pad, sink_pad);
@@ -437,7 +556,8 @@ GstRtspPlayerPrivate__on_rtsp_pad_added (GstElement *element, GstPad *new_pad, G
             C_ERROR ("failed to link dynamically '%s' to '%s'\n",GST_ELEMENT_NAME(element),GST_ELEMENT_NAME(audio_bin));
             goto exit;
         }
-        priv->dynamic_elements = g_list_append(priv->dynamic_elements, audio_bin);
+        if(!reused)
+            priv->dynamic_elements = g_list_append(priv->dynamic_elements, audio_bin);
         gst_element_sync_state_with_parent(audio_bin);
     } else {
         new_pad_struct = gst_caps_get_structure (new_pad_caps, 0);
@@ -455,28 +575,145 @@ exit:
         gst_object_unref (sink_pad);
 }
 
-static void
-GstRtspPlayerPrivate__setup_pipeline (GstRtspPlayerPrivate * priv)
+//Builds the part of the pipeline that doesn't depend on the player. Signals and the bus are hooked once adopted.
+static GstElement *
+GstRtspPlayer__build_pipeline ()
 {
-    priv->playing = 0;
-
     /* Create the empty pipeline */
-    priv->pipeline = gst_pipeline_new ("onvif-pipeline");
+    GstElement * pipeline = gst_pipeline_new ("onvif-pipeline");
 
     /* Create the elements */
-    priv->src = gst_element_factory_make ("rtspsrc", "rtspsrc");
+    GstElement * src = gst_element_factory_make ("rtspsrc", "rtspsrc");
 
-    if (!priv->pipeline){
+    if (!pipeline){
         C_FATAL("Failed to created pipeline. Check your gstreamer installation...\n");
-        return;
+        return NULL;
     }
-    if (!priv->src){
+    if (!src){
         C_FATAL ("Failed to created rtspsrc. Check your gstreamer installation...\n");
-        return;
+        gst_object_unref (pipeline);
+        return NULL;
     }
 
     // Add Elements to the Bin
-    gst_bin_add_many (GST_BIN (priv->pipeline), priv->src, NULL);
+    gst_bin_add_many (GST_BIN (pipeline), src, NULL);
+
+    // g_object_set (G_OBJECT (src), "buffer-mode", 3, NULL);
+    g_object_set (G_OBJECT (src), "latency", 0, NULL);
+    g_object_set (G_OBJECT (src), "teardown-timeout", 0, NULL); 
+    g_object_set (G_OBJECT (src), "user-agent", "OnvifDeviceManager-Linux-0.0", NULL);
+    g_object_set (G_OBJECT (src), "do-retransmission", TRUE, NULL);
+    g_object_set (G_OBJECT (src), "onvif-mode", FALSE, NULL); //It seems onvif mode can cause segmentation fault with v4l2onvif
+    g_object_set (G_OBJECT (src), "is-live", TRUE, NULL);
+    g_object_set (G_OBJECT (src), "tcp-timeout", 1000000, NULL);
+    g_object_set (G_OBJECT (src), "protocols", GST_RTSP_LOWER_TRANS_TCP, NULL); //TODO Allow changing this via settings
+
+    G_LOCK(pipeline_pool);
+    pipelines_built++;
+    G_UNLOCK(pipeline_pool);
+    return pipeline;
+}
+
+static gboolean
+GstRtspPlayer__refill_pipeline_pool (gpointer user_data)
+{
+    G_LOCK(pipeline_pool);
+    int missing = player_count > 0 ? RTSPPLAYER_PIPELINE_POOL_SIZE - pipeline_pool_count : 0;
+    pipeline_pool_refill = 0;
+    G_UNLOCK(pipeline_pool);
+
+    for(int i=0;i<missing;i++){
+        GstElement * pipeline = GstRtspPlayer__build_pipeline();
+        if(!pipeline){
+            break;
+        }
+        G_LOCK(pipeline_pool);
+        if(pipeline_pool_count < RTSPPLAYER_PIPELINE_POOL_SIZE && player_count > 0){
+            pipeline_pool[pipeline_pool_count++] = pipeline;
+            pipeline = NULL;
+        }
+        G_UNLOCK(pipeline_pool);
+        if(pipeline){
+            gst_object_unref (pipeline);
+        }
+    }
+    return FALSE;
+}
+
+static void
+GstRtspPlayer__clear_pipeline_pool ()
+{
+    G_LOCK(pipeline_pool);
+    //A player may have been created meanwhile
+    if(player_count > 0){
+        G_UNLOCK(pipeline_pool);
+        return;
+    }
+    int count = pipeline_pool_count;
+    GstElement * pipelines[RTSPPLAYER_PIPELINE_POOL_SIZE];
+    memcpy(pipelines, pipeline_pool, sizeof(GstElement *) * count);
+    pipeline_pool_count = 0;
+    if(pipeline_pool_refill){
+        g_source_remove(pipeline_pool_refill);
+        pipeline_pool_refill = 0;
+    }
+    G_UNLOCK(pipeline_pool);
+
+    for(int i=0;i<count;i++){
+        gst_object_unref (pipelines[i]);
+    }
+}
+
+//Takes a spare pipeline, the pool is refilled from the main loop
+static GstElement *
+GstRtspPlayer__take_pipeline ()
+{
+    GstElement * pipeline = NULL;
+    G_LOCK(pipeline_pool);
+    if(pipeline_pool_count > 0){
+        pipeline = pipeline_pool[--pipeline_pool_count];
+    }
+    if(!pipeline_pool_refill){
+        pipeline_pool_refill = g_idle_add(GstRtspPlayer__refill_pipeline_pool, NULL);
+    }
+    G_UNLOCK(pipeline_pool);
+
+    return pipeline ? pipeline : GstRtspPlayer__build_pipeline();
+}
+
+//Emitted by rtpbin from the streaming thread for each stream of the session
+static void
+GstRtspPlayerPrivate__new_jitterbuffer (GstElement * manager, GstElement * jitterbuffer, guint session, guint ssrc, GstRtspPlayerPrivate * priv)
+{
+    P_MUTEX_LOCK(priv->stats_lock);
+    priv->jitterbuffers = g_list_prepend(priv->jitterbuffers, gst_object_ref(jitterbuffer));
+    P_MUTEX_UNLOCK(priv->stats_lock);
+}
+
+static void
+GstRtspPlayerPrivate__new_manager (GstElement * src, GstElement * manager, GstRtspPlayerPrivate * priv)
+{
+    //rtspsrc can be configured with another manager than rtpbin
+    if(g_signal_lookup ("new-jitterbuffer", G_OBJECT_TYPE (manager))){
+        g_signal_connect (manager, "new-jitterbuffer", G_CALLBACK (GstRtspPlayerPrivate__new_jitterbuffer), priv);
+    }
+}
+
+static void
+GstRtspPlayerPrivate__setup_pipeline (GstRtspPlayerPrivate * priv)
+{
+    priv->playing = 0;
+    priv->pipeline_dirty = 0;
+
+    priv->pipeline = GstRtspPlayer__take_pipeline();
+    if (!priv->pipeline){
+        priv->src = NULL;
+        return;
+    }
+
+    //Owned by the pipeline
+    priv->src = gst_bin_get_by_name (GST_BIN (priv->pipeline), "rtspsrc");
+    gst_object_unref (priv->src);
 
     // Dynamic Pad Creation
     if(! g_signal_connect (priv->src, "pad-added", G_CALLBACK (GstRtspPlayerPrivate__on_rtsp_pad_added),priv)){
@@ -487,16 +724,11 @@ GstRtspPlayerPrivate__setup_pipeline (GstRtspPlayerPrivate * priv)
         C_ERROR ("Fail to connect select-stream signal...");
     }
 
-    // g_object_set (G_OBJECT (priv->src), "buffer-mode", 3, NULL);
-    g_object_set (G_OBJECT (priv->src), "latency", 0, NULL);
-    g_object_set (G_OBJECT (priv->src), "teardown-timeout", 0, NULL); 
+    if(!g_signal_connect (priv->src, "new-manager", G_CALLBACK (GstRtspPlayerPrivate__new_manager),priv)){
+        C_ERROR ("Fail to connect new-manager signal...");
+    }
+
     g_object_set (G_OBJECT (priv->src), "backchannel", priv->enable_backchannel, NULL);
-    g_object_set (G_OBJECT (priv->src), "user-agent", "OnvifDeviceManager-Linux-0.0", NULL);
-    g_object_set (G_OBJECT (priv->src), "do-retransmission", TRUE, NULL);
-    g_object_set (G_OBJECT (priv->src), "onvif-mode", FALSE, NULL); //It seems onvif mode can cause segmentation fault with v4l2onvif
-    g_object_set (G_OBJECT (priv->src), "is-live", TRUE, NULL);
-    g_object_set (G_OBJECT (priv->src), "tcp-timeout", 1000000, NULL);
-    g_object_set (G_OBJECT (priv->src), "protocols", GST_RTSP_LOWER_TRANS_TCP, NULL); //TODO Allow changing this via settings
 
     /* set up bus */
     GstBus *bus = gst_element_get_bus (priv->pipeline);
@@ -505,8 +737,42 @@ GstRtspPlayerPrivate__setup_pipeline (GstRtspPlayerPrivate * priv)
     gst_object_unref (bus);
 }
 
+//The pipeline must be in NULL state
+static void
+GstRtspPlayerPrivate__discard_pipeline (GstRtspPlayerPrivate * priv)
+{
+    GstBus *bus = gst_element_get_bus (priv->pipeline);
+    g_signal_handlers_disconnect_by_data (bus, priv);
+    gst_bus_remove_signal_watch (bus);
+    gst_object_unref (bus);
+
+    gst_object_unref (priv->pipeline);
+    priv->pipeline = NULL;
+    priv->src = NULL;
+}
+
 void GstRtspPlayerPrivate__inner_stop(GstRtspPlayerPrivate * priv){
     GstStateChangeReturn ret;
+    gint64 start = g_get_monotonic_time();
+    int recycled = 0;
+
+    //Standby changes only act on a started session, this keeps them off the pipeline from here on.
+    //standby_lock waits for a pause or resume already deciding to touch the pipeline.
+    P_MUTEX_LOCK(priv->standby_lock);
+    P_MUTEX_LOCK(priv->prop_lock);
+    priv->started = 0;
+    priv->standby_paused = 0;
+    P_MUTEX_UNLOCK(priv->prop_lock);
+    P_MUTEX_UNLOCK(priv->standby_lock);
+
+    //rtspsrc creates a new manager for the next session
+    P_MUTEX_LOCK(priv->stats_lock);
+    g_list_free_full(priv->jitterbuffers, gst_object_unref);
+    priv->jitterbuffers = NULL;
+    priv->frames = 0;
+    priv->late_frames = 0;
+    priv->dropped_frames = 0;
+    P_MUTEX_UNLOCK(priv->stats_lock);
 
     //Pause backchannel
     if(!RtspBackchannel__pause(priv->backchannel)){
@@ -522,21 +788,32 @@ void GstRtspPlayerPrivate__inner_stop(GstRtspPlayerPrivate * priv){
         }
     }
 
-    g_list_free(priv->dynamic_elements);
-    priv->dynamic_elements = NULL;
+    if(priv->recycle && !priv->pipeline_dirty && GST_IS_ELEMENT(priv->pipeline)){
+        //rtspsrc drops its session and pads in NULL state, the decoding bins are linked again to the next session's pads.
+        //The NULL state also flushed the bus, messages of the previous session won't be delivered.
+        priv->playing = 0;
+        recycled = 1;
+        G_LOCK(pipeline_pool);
+        pipelines_recycled++;
+        G_UNLOCK(pipeline_pool);
+    } else {
+        g_list_free(priv->dynamic_elements);
+        priv->dynamic_elements = NULL;
 
-    //Destroy old pipeline
-    if(GST_IS_ELEMENT(priv->pipeline))
-        gst_object_unref (priv->pipeline);
+        //Destroy old pipeline
+        if(GST_IS_ELEMENT(priv->pipeline))
+            GstRtspPlayerPrivate__discard_pipeline(priv);
 
-    // Create new pipeline
-    GstRtspPlayerPrivate__setup_pipeline(priv);
+        // Take a new pipeline
+        GstRtspPlayerPrivate__setup_pipeline(priv);
+    }
 
-    //New pipeline causes previous pipe to stop dispatching state change.
+    //A replaced pipeline stops dispatching state change, and a recycled one only does once the next session plays.
     //Force hide the previous stream
     if(GTK_IS_WIDGET (priv->canvas))
         gtk_widget_set_visible(priv->canvas, FALSE);
 
+    C_DEBUG("Pipeline %s in %" G_GINT64_FORMAT " us", recycled ? "recycled" : "replaced", g_get_monotonic_time() - start);
 }
 
 void GstRtspPlayerPrivate__stop(GstRtspPlayerPrivate * priv){
@@ -633,6 +910,11 @@ GstRtspPlayerPrivate__error_msg (GstBus *bus, GstMessage *msg, GstRtspPlayerPriv
 
     gst_message_parse_error (msg, &err, &debug_info);
 
+    //Decoder or sink failures may leave their element unusable, only rtspsrc is known to recover from NULL state
+    if(priv->src && GST_MESSAGE_SRC (msg) != GST_OBJECT (priv->src) && !gst_object_has_as_ancestor (GST_MESSAGE_SRC (msg), GST_OBJECT (priv->src))){
+        priv->pipeline_dirty = 1;
+    }
+
     switch(err->code){
         case GST_RESOURCE_ERROR_SETTINGS:
             C_WARN ("Backchannel unsupported. Downgrading...");
@@ -724,6 +1006,26 @@ GstRtspPlayerPrivate__is_video_bin(GstRtspPlayerPrivate * priv, GstElement * ele
     return FALSE;
 }
 
+//Video elements may be nested in decodebin
+static gboolean
+GstRtspPlayerPrivate__in_video_bin(GstRtspPlayerPrivate * priv, GstObject * object){
+    for(;object;object = GST_OBJECT_PARENT(object)){
+        if(GST_IS_ELEMENT(object) && GstRtspPlayerPrivate__is_video_bin(priv,GST_ELEMENT(object))){
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+//Must hold standby_lock, not prop_lock. The state change goes through rtpbin's lock, which the streaming threads hold while calling back into the player.
+//Pausing a live pipeline doesn't wait for preroll, rtspsrc sends PAUSE from its own task.
+static void
+GstRtspPlayerPrivate__standby_pause (GstRtspPlayerPrivate * priv)
+{
+    C_DEBUG("Pausing standby session %s", priv->location);
+    gst_element_set_state (priv->pipeline, GST_STATE_PAUSED);
+}
+
 /* This function is called when the pipeline changes states. We use it to
  * keep track of the current state. */
 static void
@@ -736,10 +1038,25 @@ GstRtspPlayerPrivate__state_changed_msg (GstBus * bus, GstMessage * msg, GstRtsp
     
     GstElement * element = GST_ELEMENT(GST_MESSAGE_SRC (msg));
     if(GstRtspPlayerPrivate__is_video_bin(priv,element) && new_state != GST_STATE_PLAYING && GTK_IS_WIDGET (priv->canvas)){
-        gtk_widget_set_visible(priv->canvas, FALSE);
+        //A standby pause keeps the last frame on display
+        P_MUTEX_LOCK(priv->prop_lock);
+        if(!priv->standby_paused)
+            gtk_widget_set_visible(priv->canvas, FALSE);
+        P_MUTEX_UNLOCK(priv->prop_lock);
     } else if(GstRtspPlayerPrivate__is_video_bin(priv,element) && new_state == GST_STATE_PLAYING && GTK_IS_WIDGET (priv->canvas)){
         gtk_widget_set_visible(priv->canvas, TRUE);
 
+        P_MUTEX_LOCK(priv->standby_lock);
+        P_MUTEX_LOCK(priv->prop_lock);
+        priv->started = 1;
+        int pause = priv->standby && !priv->standby_paused;
+        if(pause)
+            priv->standby_paused = 1;
+        P_MUTEX_UNLOCK(priv->prop_lock);
+        if(pause)
+            GstRtspPlayerPrivate__standby_pause(priv);
+        P_MUTEX_UNLOCK(priv->standby_lock);
+
         /*
         * Waiting for fix https://gitlab.freedesktop.org/gstreamer/gst-plugins-good/-/issues/245
         * Until This issue is fixed, "no-more-pads" is unreliable to determine if all stream states are ready.
@@ -750,6 +1067,10 @@ GstRtspPlayerPrivate__state_changed_msg (GstBus * bus, GstMessage * msg, GstRtsp
         */
         priv->retry = 0;
         priv->fallback = RTSP_FALLBACK_NONE;
+        if(priv->play_time){
+            C_INFO("Stream started in %" G_GINT64_FORMAT " ms", (g_get_monotonic_time() - priv->play_time) / 1000);
+            priv->play_time = 0;
+        }
         g_signal_emit (priv->owner, signals[STARTED], 0 /* details */);
     }
 
@@ -847,6 +1168,12 @@ GstRtspPlayerPrivate__message_handler (GstBus * bus, GstMessage * message, GstRt
             C_TRACE("msg : GST_MESSAGE_STEP_START\n");
             break;
         case GST_MESSAGE_QOS:
+            //Posted for every buffer an element dropped to catch up
+            if(GstRtspPlayerPrivate__in_video_bin(priv,GST_MESSAGE_SRC(message))){
+                P_MUTEX_LOCK(priv->stats_lock);
+                priv->dropped_frames++;
+                P_MUTEX_UNLOCK(priv->stats_lock);
+            }
             break;
         case GST_MESSAGE_PROGRESS:
             break;
@@ -918,9 +1245,27 @@ GstRtspPlayer__init (GstRtspPlayer * self)
     priv->dynamic_elements = NULL;
     priv->sink = NULL;
     priv->fallback = RTSP_FALLBACK_NONE;
+    priv->recycle = 0;
+    priv->pipeline_dirty = 0;
+    priv->play_time = 0;
+    priv->standby = 0;
+    priv->standby_paused = 0;
+    priv->started = 0;
+    priv->jitterbuffers = NULL;
+    priv->frames = 0;
+    priv->late_frames = 0;
+    priv->dropped_frames = 0;
+    priv->pipeline = NULL;
+    priv->src = NULL;
+
+    G_LOCK(pipeline_pool);
+    player_count++;
+    G_UNLOCK(pipeline_pool);
 
     P_MUTEX_SETUP(priv->prop_lock);
     P_MUTEX_SETUP(priv->player_lock);
+    P_MUTEX_SETUP(priv->standby_lock);
+    P_MUTEX_SETUP(priv->stats_lock);
 
     priv->backchannel = RtspBackchannel__create();
 
@@ -1068,4 +1413,117 @@ void GstRtspPlayer__set_host_fallback(GstRtspPlayer* self, char * host){
     }
     strcpy(priv->host_fallback,host);
     P_MUTEX_UNLOCK(priv->prop_lock);
-}
\ No newline at end of file
+}
+
+void GstRtspPlayer__set_recycle_pipeline(GstRtspPlayer* self, gboolean recycle){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    P_MUTEX_LOCK(priv->player_lock);
+    priv->recycle = recycle;
+    P_MUTEX_UNLOCK(priv->player_lock);
+}
+
+void GstRtspPlayer__set_standby(GstRtspPlayer* self, gboolean standby){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    //standby_lock rather than player_lock, a play or stop may hold the latter for seconds
+    P_MUTEX_LOCK(priv->standby_lock);
+    P_MUTEX_LOCK(priv->prop_lock);
+    priv->standby = standby;
+    int pause = standby && priv->started && !priv->standby_paused;
+    int resume = !standby && priv->standby_paused;
+    if(pause){
+        priv->standby_paused = 1;
+    } else if(resume){
+        priv->standby_paused = 0;
+        priv->play_time = g_get_monotonic_time();
+    }
+    P_MUTEX_UNLOCK(priv->prop_lock);
+
+    if(pause){
+        GstRtspPlayerPrivate__standby_pause(priv);
+    } else if(resume){
+        gst_element_set_state (priv->pipeline, GST_STATE_PLAYING);
+        //The camera kept its GOP going while paused, ask for a keyframe rather than decoding from a stale reference
+        if(GST_IS_ELEMENT(priv->sink))
+            gst_element_send_event (priv->sink, gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE, TRUE, 0));
+    }
+    P_MUTEX_UNLOCK(priv->standby_lock);
+}
+
+gboolean GstRtspPlayer__is_started(GstRtspPlayer* self){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (GST_IS_RTSPPLAYER (self), FALSE);
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    P_MUTEX_LOCK(priv->prop_lock);
+    gboolean ret = priv->started;
+    P_MUTEX_UNLOCK(priv->prop_lock);
+    return ret;
+}
+
+gboolean GstRtspPlayer__get_video_size(GstRtspPlayer* self, int * width, int * height){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (GST_IS_RTSPPLAYER (self), FALSE);
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    gboolean ret = FALSE;
+    P_MUTEX_LOCK(priv->prop_lock);
+    if(priv->started && GST_IS_ELEMENT(priv->sink)){
+        GstPad * pad = gst_element_get_static_pad (priv->sink, "sink");
+        GstCaps * caps = gst_pad_get_current_caps (pad);
+        if(caps){
+            GstStructure * s = gst_caps_get_structure (caps, 0);
+            ret = gst_structure_get_int (s, "width", width) && gst_structure_get_int (s, "height", height);
+            gst_caps_unref (caps);
+        }
+        gst_object_unref (pad);
+    }
+    P_MUTEX_UNLOCK(priv->prop_lock);
+    return ret;
+}
+
+void GstRtspPlayer__get_stats(GstRtspPlayer* self, GstRtspPlayerStats * stats){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    memset(stats, 0, sizeof(GstRtspPlayerStats));
+
+    //Queried outside of stats_lock, the jitterbuffer may wait on rtpbin's lock which is held while adding jitterbuffers
+    P_MUTEX_LOCK(priv->stats_lock);
+    GList * jitterbuffers = g_list_copy_deep(priv->jitterbuffers, (GCopyFunc) gst_object_ref, NULL);
+    stats->frames = priv->frames;
+    stats->late_frames = priv->late_frames;
+    stats->dropped_frames = priv->dropped_frames;
+    P_MUTEX_UNLOCK(priv->stats_lock);
+
+    for(GList * node = jitterbuffers; node; node = node->next){
+        GstStructure * s = NULL;
+        guint64 value;
+        g_object_get (G_OBJECT (node->data), "stats", &s, NULL);
+        if(!s)
+            continue;
+        if(gst_structure_get_uint64 (s, "num-pushed", &value))
+            stats->packets += value;
+        if(gst_structure_get_uint64 (s, "num-lost", &value))
+            stats->lost += value;
+        if(gst_structure_get_uint64 (s, "num-late", &value))
+            stats->late += value;
+        if(gst_structure_get_uint64 (s, "avg-jitter", &value))
+            stats->jitter_us = MAX(stats->jitter_us, value / 1000);
+        gst_structure_free (s);
+    }
+    g_list_free_full(jitterbuffers, gst_object_unref);
+}
+
+void GstRtspPlayer__get_pipeline_stats(unsigned long long * built, unsigned long long * recycled){
+    G_LOCK(pipeline_pool);
+    if(built) *built = pipelines_built;
+    if(recycled) *recycled = pipelines_recycled;
+    G_UNLOCK(pipeline_pool);
+}
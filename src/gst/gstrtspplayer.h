@@ -8,6 +8,17 @@ G_BEGIN_DECLS
 
 typedef struct _GstRtspPlayer GstRtspPlayer;
 
+//Counters of the current session, reset on stop
+typedef struct {
+    guint64 packets; //Pushed by the jitterbuffers
+    guint64 lost;
+    guint64 late; //Packets arriving after their deadline
+    guint64 jitter_us; //Highest average jitter among the streams
+    guint64 frames; //Reached the video sink
+    guint64 late_frames; //Rendered far behind the clock
+    guint64 dropped_frames; //Reported through QoS messages
+} GstRtspPlayerStats;
+
 #define GST_TYPE_RTSPPLAYER GstRtspPlayer__get_type()
 G_DECLARE_FINAL_TYPE (GstRtspPlayer, GstRtspPlayer_, GST, RTSPPLAYER, GObject)
 
@@ -35,6 +46,20 @@ void GstRtspPlayer__mic_mute(GstRtspPlayer* self, gboolean mute);
 void GstRtspPlayer__set_allow_overscale(GstRtspPlayer * self, int allow_overscale);
 void GstRtspPlayer__set_port_fallback(GstRtspPlayer* self, char * port);
 void GstRtspPlayer__set_host_fallback(GstRtspPlayer* self, char * host);
+//Keeps the pipeline between sessions. Stopping only resets it, the next session relinks the existing decoding branch to rtspsrc.
+//The pipeline is still replaced after a failure outside of rtspsrc (decoder, sink).
+void GstRtspPlayer__set_recycle_pipeline(GstRtspPlayer* self, gboolean recycle);
+//Standby players pause their session once the first frame is shown, the session stays negotiated and the last frame on the canvas.
+//Leaving standby resumes it right away.
+void GstRtspPlayer__set_standby(GstRtspPlayer* self, gboolean standby);
+//The video stream reached PLAYING since the last stop
+gboolean GstRtspPlayer__is_started(GstRtspPlayer* self);
+//Decoded video size of the started stream
+gboolean GstRtspPlayer__get_video_size(GstRtspPlayer* self, int * width, int * height);
+//Stream health, sampled to detect a network or decoder that can't keep up
+void GstRtspPlayer__get_stats(GstRtspPlayer* self, GstRtspPlayerStats * stats);
+//Pipelines built and recycled by every player since startup
+void GstRtspPlayer__get_pipeline_stats(unsigned long long * built, unsigned long long * recycled);
 
 G_END_DECLS
 
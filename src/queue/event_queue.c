@@ -3,23 +3,75 @@
 #include <stdio.h>
 #include <unistd.h>
 #include "event_queue.h"
+#include "queue_scope.h"
+#include "queue_timer.h"
+#include "queue_stats.h"
+#include "queue_pool.h"
 #include "clist_ts.h"
 #include "clogger.h"
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+
+#ifndef P_COND_TIMEDWAIT
+#include <pthread.h>
+#define P_COND_TIMEDWAIT(x,y,t) pthread_cond_timedwait(&(x), &(y), t)
+#endif
 
 static const char * EVENTQUEUE_DISPATCHING_STR = "Dispatching";
 static const char * EVENTQUEUE_DISPATCHED_STR = "Dispatched";
 static const char * EVENTQUEUE_CANCELLED_STR = "Cancelled";
 static const char * EVENTQUEUE_STARTED_STR = "Started";
 
+//Elastic pool defaults
+#define EVENTQUEUE_GROW_THRESHOLD_MS 200
+#define EVENTQUEUE_KEEPALIVE_MS 30000
+
+typedef struct {
+    QueueEventList completed; //Futures waiting for their continuation, still indexed by scope
+    void (*wakeup)(void * data);
+    void * wakeup_data;
+    int active;
+} QueueSink;
+
 struct _EventQueue {
     CObject parent;
 
-    CListTS events;
-    CListTS running_events;
+    //Pending and running events are only accessed under pool_lock
+    QueuePool pools[EVENTQUEUE_MAX_POOLS];
+    int pool_count;
+    int pending_count;
+    QueueEventList running_events;
+    QueueScopeTable scopes;
+    QueueTimerHeap timers; //Delayed and periodic events not yet due
+    QueueSink sinks[EVENTQUEUE_MAX_SINKS];
     CListTS threads;
+    QueueStats * stats;
+    unsigned long long finished_count;
+    long long busy_us;
+
+    int shutting_down; //Set by EventQueue__shutdown, new events are rejected
+    int defer_wakeups; //Set while EventQueue__insert_many holds the lock, workers are woken once the batch is in
+    int work_stealing; //Events readied by a worker go to its own deque
 
-    P_COND_TYPE sleep_cond;
+    //Optional bounds on queued events, pending or scheduled. 0 is unbounded.
+    int capacity;
+    EventQueueOverflowPolicy overflow_policy;
+    int scope_capacity;
+    EventQueueOverflowPolicy scope_overflow_policy;
+    int blocked_producers;
+    unsigned long long overflow_count[EVENTQUEUE_OVERFLOW_POLICY_COUNT];
+    P_COND_TYPE space_cond; //Broadcast when queued events leave while producers are blocked
+
+    //Hung task watchdog
+    int watchdog_ms; //Check interval, 0 asks the watchdog thread to exit
+    int watchdog_running;
+    EVENTQUEUE_HUNG_CALLBACK hung_cb;
+    void * hung_data;
+    P_COND_TYPE watchdog_cond;
+
+    P_COND_TYPE finish_cond; //Signaled whenever a worker or the watchdog exits
     P_MUTEX_TYPE pool_lock;
 
     void (*queue_event_cb)(EventQueue * queue, EventQueueType type, void * user_data);
@@ -28,6 +80,47 @@ struct _EventQueue {
 
 void priv_EventQueue__wait_finish(EventQueue* self);
 void priv_EventQueue__destroy(CObject * self);
+QueueEvent * priv_EventQueue__pop_pending(EventQueue * self, QueuePool * pool, QueueDeque * deque);
+QueueDeque * priv_EventQueue__get_local_deque(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__enqueue(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__strand_advance(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__unlink_pending(EventQueue * self, QueueEvent * evt);
+QueueEvent * priv_EventQueue__find_coalesced(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__discard(EventQueue * self, QueueEventList * discarded);
+void priv_EventQueue__unlink_queued(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__track(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__untrack(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__ready(EventQueue * self, QueueEvent * evt);
+QueuePool * priv_EventQueue__get_pool(EventQueue * self, QueueEvent * evt);
+int priv_EventQueue__owns_pending(EventQueue * self, QueueEventList * list);
+int priv_EventQueue__owns_completed(EventQueue * self, QueueEventList * list);
+int priv_EventQueue__post_completion(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__drop_completions(EventQueue * self, QueueSink * sink, QueueEventList * discarded);
+void priv_EventQueue__wake_all(EventQueue * self);
+int priv_EventQueue__should_grow(EventQueue * self, QueuePool * pool);
+void priv_EventQueue__add_thread(EventQueue * self, int pool);
+void priv_EventQueue__stop_pool(EventQueue * self, int pool, int nthread);
+void priv_EventQueue__notify_started(EventQueue * self, int count);
+int priv_EventQueue__promote_timers(EventQueue * self, long long now);
+void priv_EventQueue__timed_wait(EventQueue * self, P_COND_TYPE * cond, long long delay_us);
+int priv_EventQueue__join(EventQueue * self, long long deadline_us);
+void priv_EventQueue__reject(EventQueue * self, QueueEvent * evt);
+int priv_EventQueue__snapshot_task(EventQueueTask * tasks, int index, int max_tasks, QueueEvent * evt, EventQueueTaskState state, long long age_us);
+int priv_EventQueue__schedule(EventQueue * self, QueueEvent * evt, int delay_ms);
+void * priv_EventQueue__watchdog_call(void * data);
+int priv_EventQueue__check_overdue(EventQueue * self, long long now);
+void priv_EventQueue__stop_watchdog(EventQueue * self);
+void priv_EventQueue__hung_returned(EventQueue * self, QueueEvent * evt, long long now);
+int priv_EventQueue__compensate(EventQueue * self, QueueEvent * evt);
+void priv_EventQueue__compensated_returned(EventQueue * self, QueueEvent * evt);
+EventQueueInsertResult priv_EventQueue__make_room(EventQueue * self, QueueEvent * evt, int coalescing, QueueEventList * discarded);
+int priv_EventQueue__is_queued(EventQueue * self, QueueEvent * evt);
+int priv_EventQueue__scope_queued_count(EventQueue * self, QueueScope * record);
+QueueEvent * priv_EventQueue__find_victim(EventQueue * self, QueueScope * record, int newest);
+int priv_EventQueue__is_better_victim(QueueEvent * evt, QueueEvent * victim, int newest);
+void priv_EventQueue__release_space(EventQueue * self);
+EventQueueInsertResult priv_EventQueue__insert_locked(EventQueue * self, QueueEvent * evt, QueueEventList * discarded, QueueEventList * rejected);
+void priv_EventQueue__flush_wakeups(EventQueue * self);
 
 const char * EventQueueType__toString(EventQueueType type){
   switch(type){
@@ -45,15 +138,35 @@ const char * EventQueueType__toString(EventQueueType type){
 }
 
 void priv_EventQueue__wait_finish(EventQueue* self){
-    int val = -1;
-    while((val = EventQueue__get_thread_count(self)) != 0){
-        sleep(0.05);
+    priv_EventQueue__join(self,-1);
+}
+
+//Waits for every worker to exit, or until deadline_us (-1 waits forever). Returns the number of workers left.
+int priv_EventQueue__join(EventQueue * self, long long deadline_us){
+    int count;
+    long long now;
+    P_MUTEX_LOCK(self->pool_lock);
+    //Workers signal under pool_lock after leaving the thread list, so no exit is missed between the check and the wait
+    while((count = EventQueue__get_thread_count(self)) != 0){
+        if(deadline_us < 0){
+            P_COND_WAIT(self->finish_cond, self->pool_lock);
+            continue;
+        }
+        now = QueueEvent__now_us();
+        if(now >= deadline_us){
+            break;
+        }
+        priv_EventQueue__timed_wait(self,&self->finish_cond,deadline_us - now);
     }
+    P_MUTEX_UNLOCK(self->pool_lock);
+    return count;
 }
 
 void priv_EventQueue__destroy(CObject * cobject){
     EventQueue * self = (EventQueue *)cobject;
     if (self) {
+        priv_EventQueue__stop_watchdog(self);
+
         //Thread cleanup
         int tcount = EventQueue__get_thread_count(self);
         if(tcount){
@@ -61,11 +174,18 @@ void priv_EventQueue__destroy(CObject * cobject){
             priv_EventQueue__wait_finish(self);
         }
 
-        CObject__destroy((CObject *)&self->events);
+        EventQueue__clear(self);
         CObject__destroy((CObject *)&self->threads);
-        CObject__destroy((CObject *)&self->running_events);
+        QueueScopeTable__clear(&self->scopes);
+        QueueTimerHeap__clear(&self->timers);
+        QueueStats__destroy(self->stats);
+        for(int i=0;i<self->pool_count;i++){
+            QueuePool__clear(&self->pools[i]);
+        }
 
-        P_COND_CLEANUP(self->sleep_cond);
+        P_COND_CLEANUP(self->finish_cond);
+        P_COND_CLEANUP(self->watchdog_cond);
+        P_COND_CLEANUP(self->space_cond);
         P_MUTEX_CLEANUP(self->pool_lock);
     }
 }
@@ -77,10 +197,16 @@ void EventQueue__init(EventQueue* self) {
     CObject__set_destroy_callback((CObject*)self,priv_EventQueue__destroy);
 
     CListTS__init(&self->threads);
-    CListTS__init(&self->events);
-    CListTS__init(&self->running_events);
+    QueuePool__init(&self->pools[EVENTQUEUE_DEFAULT_POOL],"default",EVENTQUEUE_GROW_THRESHOLD_MS,EVENTQUEUE_KEEPALIVE_MS);
+    self->pool_count = 1;
+    QueueEventList__init(&self->running_events);
+    QueueScopeTable__init(&self->scopes);
+    QueueTimerHeap__init(&self->timers);
+    self->stats = QueueStats__create();
 
-    P_COND_SETUP(self->sleep_cond);
+    P_COND_SETUP(self->finish_cond);
+    P_COND_SETUP(self->watchdog_cond);
+    P_COND_SETUP(self->space_cond);
     P_MUTEX_SETUP(self->pool_lock);
 }
 
@@ -97,24 +223,162 @@ EventQueue* EventQueue__create(void (*queue_event_cb)(EventQueue * queue, EventQ
 int EventQueue__get_running_event_count(EventQueue * self){
     int ret = -1;
     P_MUTEX_LOCK(self->pool_lock);
-    ret = CListTS__get_count(&self->running_events);
+    ret = QueueEventList__get_count(&self->running_events);
     P_MUTEX_UNLOCK(self->pool_lock);
     return ret;
 }
 
 int EventQueue__get_pending_event_count(EventQueue * self){
-    return CListTS__get_count(&self->events);
+    int ret = -1;
+    P_MUTEX_LOCK(self->pool_lock);
+    ret = self->pending_count;
+    P_MUTEX_UNLOCK(self->pool_lock);
+    return ret;
+}
+
+void EventQueue__set_stats_enabled(EventQueue * self, int enabled){
+    QueueStats__set_enabled(self->stats,enabled);
+}
+
+QueueStats * EventQueue__get_stats(EventQueue * self){
+    return self->stats;
+}
+
+int EventQueue__get_scheduled_event_count(EventQueue * self){
+    int ret = -1;
+    P_MUTEX_LOCK(self->pool_lock);
+    ret = QueueTimerHeap__get_count(&self->timers);
+    P_MUTEX_UNLOCK(self->pool_lock);
+    return ret;
 }
 
 int EventQueue__get_thread_count(EventQueue * self){
     return CListTS__get_count(&self->threads);
 }
 
+//Must be called while holding pool_lock.
+int priv_EventQueue__snapshot_task(EventQueueTask * tasks, int index, int max_tasks, QueueEvent * evt, EventQueueTaskState state, long long age_us){
+    if(index >= max_tasks){
+        return index;
+    }
+    tasks[index].scope = QueueEvent__get_scope(evt);
+    tasks[index].callback = QueueEvent__get_callback(evt);
+    tasks[index].name = QueueEvent__get_name(evt);
+    tasks[index].state = state;
+    tasks[index].priority = QueueEvent__get_priority(evt);
+    tasks[index].pool = QueueEvent__get_pool(evt);
+    tasks[index].age_us = age_us;
+    return index+1;
+}
+
+void EventQueue__snapshot(EventQueue * self, EventQueueSnapshot * snapshot, EventQueueTask * tasks, int max_tasks){
+    int i, p;
+    int count = 0;
+    QueueEvent * evt;
+    QueueScope * record;
+    long long now;
+
+    snapshot->thread_count = EventQueue__get_thread_count(self);
+
+    P_MUTEX_LOCK(self->pool_lock);
+    now = QueueEvent__now_us();
+    snapshot->time_us = now;
+    snapshot->running_count = QueueEventList__get_count(&self->running_events);
+    snapshot->pending_count = self->pending_count;
+    snapshot->scheduled_count = QueueTimerHeap__get_count(&self->timers);
+    snapshot->hung_count = 0;
+    snapshot->stolen_count = 0;
+    for(p=0;p<self->pool_count;p++){
+        snapshot->hung_count += self->pools[p].hung_count;
+        snapshot->stolen_count += self->pools[p].stolen_count;
+    }
+    snapshot->finished_count = self->finished_count;
+    snapshot->busy_us = self->busy_us;
+    memcpy(snapshot->overflow_count,self->overflow_count,sizeof(snapshot->overflow_count));
+
+    for(evt = QueueEventList__get_first(&self->running_events); evt; evt = QueueEvent__get_next(evt)){
+        //Popped events don't have a start time until the worker dispatches them
+        long long started = QueueEvent__get_start_time(evt) ? QueueEvent__get_start_time(evt) : now;
+        snapshot->busy_us += now - started;
+        count = priv_EventQueue__snapshot_task(tasks,count,max_tasks,evt,QueueEvent__is_overdue(evt) ? EVENTQUEUE_TASK_HUNG : EVENTQUEUE_TASK_RUNNING,now - started);
+    }
+    for(p=0;p<self->pool_count && count < max_tasks;p++){
+        for(i=0;i<EVENTQUEUE_PRIORITY_COUNT && count < max_tasks;i++){
+            for(evt = QueueEventList__get_first(&self->pools[p].lanes[i]); evt && count < max_tasks; evt = QueueEvent__get_next(evt)){
+                count = priv_EventQueue__snapshot_task(tasks,count,max_tasks,evt,EVENTQUEUE_TASK_PENDING,now - QueueEvent__get_enqueue_time(evt));
+            }
+        }
+        for(QueueDeque * deque = self->pools[p].deques; deque && count < max_tasks; deque = deque->next){
+            for(i=0;i<EVENTQUEUE_PRIORITY_COUNT && count < max_tasks;i++){
+                for(evt = QueueEventList__get_first(&deque->lanes[i]); evt && count < max_tasks; evt = QueueEvent__get_next(evt)){
+                    count = priv_EventQueue__snapshot_task(tasks,count,max_tasks,evt,EVENTQUEUE_TASK_PENDING,now - QueueEvent__get_enqueue_time(evt));
+                }
+            }
+        }
+    }
+    for(i=0;i<self->scopes.size && count < max_tasks;i++){
+        for(record = self->scopes.buckets[i]; record; record = record->next){
+            for(evt = QueueEventList__get_first(&record->strand); evt && count < max_tasks; evt = QueueEvent__get_next(evt)){
+                count = priv_EventQueue__snapshot_task(tasks,count,max_tasks,evt,EVENTQUEUE_TASK_PENDING,now - QueueEvent__get_enqueue_time(evt));
+            }
+        }
+    }
+    for(i=0;i<self->timers.count && count < max_tasks;i++){
+        evt = self->timers.events[i];
+        count = priv_EventQueue__snapshot_task(tasks,count,max_tasks,evt,EVENTQUEUE_TASK_SCHEDULED,now - QueueEvent__get_enqueue_time(evt));
+    }
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    snapshot->task_count = count;
+}
+
 void EventQueue__remove_thread(EventQueue* self, QueueThread * qt){
     CListTS__destroy_record(&self->threads,(CObject*)qt);
+    P_MUTEX_LOCK(self->pool_lock);
+    P_COND_BROADCAST(self->finish_cond);
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+int EventQueue__shutdown(EventQueue * self, int timeout_ms){
+    QueueEvent * evt;
+    long long now;
+    long long deadline_us = QueueEvent__now_us() + (long long) timeout_ms * 1000;
+
+    P_MUTEX_LOCK(self->pool_lock);
+    self->shutting_down = 1;
+    //Blocked producers give up on their insert
+    P_COND_BROADCAST(self->space_cond);
+    //Running events can only be flagged, their callback is expected to check QueueEvent__is_cancelled
+    for(evt = QueueEventList__get_first(&self->running_events); evt; evt = QueueEvent__get_next(evt)){
+        QueueEvent__cancel(evt);
+    }
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    priv_EventQueue__stop_watchdog(self);
+    EventQueue__clear(self);
+    EventQueue__stop(self,EventQueue__get_thread_count(self));
+
+    int remaining = priv_EventQueue__join(self,deadline_us);
+    if(remaining){
+        C_WARN("%d worker(s) still running after %d ms",remaining,timeout_ms);
+        P_MUTEX_LOCK(self->pool_lock);
+        now = QueueEvent__now_us();
+        for(evt = QueueEventList__get_first(&self->running_events); evt; evt = QueueEvent__get_next(evt)){
+            C_WARN("Straggler '%s' running for %lld ms",
+                QueueEvent__get_name(evt) ? QueueEvent__get_name(evt) : "unnamed",
+                QueueEvent__get_start_time(evt) ? (now - QueueEvent__get_start_time(evt)) / 1000 : 0);
+        }
+        P_MUTEX_UNLOCK(self->pool_lock);
+    }
+    return remaining;
 }
 
 void EventQueue__stop(EventQueue* self, int nthread){
+    priv_EventQueue__stop_pool(self,-1,nthread);
+}
+
+//Cancels up to nthread workers of the pool, or of any pool if pool is -1
+void priv_EventQueue__stop_pool(EventQueue * self, int pool, int nthread){
     P_MUTEX_LOCK(self->pool_lock);
     int tcount = EventQueue__get_thread_count(self);
     int cancelled_count = 0;
@@ -123,108 +387,1235 @@ void EventQueue__stop(EventQueue* self, int nthread){
         if(cancelled_count == nthread){
             break;
         }
+        if(pool >= 0 && QueueThread__get_pool(thread) != pool){
+            continue;
+        }
         if(!QueueThread__is_cancelled(thread)){
             QueueThread__cancel(thread);
+            self->pools[QueueThread__get_pool(thread)].worker_count--;
             cancelled_count++;
         };
     }
-    P_COND_BROADCAST(self->sleep_cond);
+    priv_EventQueue__wake_all(self);
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+int EventQueue__add_pool(EventQueue* self, const char * name, int min_threads, int max_threads){
+    int pool;
+    P_MUTEX_LOCK(self->pool_lock);
+    if(self->pool_count >= EVENTQUEUE_MAX_POOLS){
+        P_MUTEX_UNLOCK(self->pool_lock);
+        C_ERROR("Pool limit reached, '%s' not added",name);
+        return -1;
+    }
+    pool = self->pool_count;
+    QueuePool__init(&self->pools[pool],name,
+        self->pools[EVENTQUEUE_DEFAULT_POOL].grow_threshold_ms,
+        self->pools[EVENTQUEUE_DEFAULT_POOL].keepalive_ms);
+    self->pool_count++;
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    EventQueue__set_pool_elastic(self,pool,min_threads,max_threads);
+    return pool;
+}
+
+void EventQueue__set_elastic(EventQueue* self, int min_threads, int max_threads){
+    EventQueue__set_pool_elastic(self,EVENTQUEUE_DEFAULT_POOL,min_threads,max_threads);
+}
+
+void EventQueue__set_pool_elastic(EventQueue* self, int pool, int min_threads, int max_threads){
+    int started = 0;
+    int excess = 0;
+    QueuePool * qp;
+    if(min_threads < 1) min_threads = 1;
+    if(max_threads < min_threads) max_threads = min_threads;
+
+    P_MUTEX_LOCK(self->pool_lock);
+    if(pool < 0 || pool >= self->pool_count){
+        P_MUTEX_UNLOCK(self->pool_lock);
+        return;
+    }
+    qp = &self->pools[pool];
+    C_INFO("Elastic pool '%s' [%d-%d]",qp->name,min_threads,max_threads);
+    qp->min_threads = min_threads;
+    qp->max_threads = max_threads;
+    while(qp->worker_count < min_threads){
+        priv_EventQueue__add_thread(self,pool);
+        started++;
+    }
+    excess = qp->worker_count - max_threads;
+    //Idle workers pick up the new keep-alive policy
+    P_COND_BROADCAST(qp->sleep_cond);
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    if(excess > 0){
+        priv_EventQueue__stop_pool(self,pool,excess);
+    }
+    priv_EventQueue__notify_started(self,started);
+}
+
+void EventQueue__set_elastic_timing(EventQueue* self, int grow_threshold_ms, int keepalive_ms){
+    P_MUTEX_LOCK(self->pool_lock);
+    for(int i=0;i<self->pool_count;i++){
+        self->pools[i].grow_threshold_ms = grow_threshold_ms;
+        self->pools[i].keepalive_ms = keepalive_ms;
+    }
+    priv_EventQueue__wake_all(self);
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+void EventQueue__set_work_stealing(EventQueue* self, int enabled){
+    P_MUTEX_LOCK(self->pool_lock);
+    //Events left in deques are still served and stolen once disabled
+    self->work_stealing = enabled;
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+int EventQueue__get_pool_count(EventQueue * self){
+    int ret;
+    P_MUTEX_LOCK(self->pool_lock);
+    ret = self->pool_count;
+    P_MUTEX_UNLOCK(self->pool_lock);
+    return ret;
+}
+
+void EventQueue__set_pool_deadline(EventQueue* self, int pool, int deadline_ms){
+    P_MUTEX_LOCK(self->pool_lock);
+    if(pool >= 0 && pool < self->pool_count){
+        self->pools[pool].deadline_ms = deadline_ms;
+    }
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+void EventQueue__set_watchdog(EventQueue* self, int interval_ms, EVENTQUEUE_HUNG_CALLBACK callback, void * user_data){
+    P_THREAD_TYPE thread;
+    if(interval_ms <= 0){
+        priv_EventQueue__stop_watchdog(self);
+        return;
+    }
+
+    P_MUTEX_LOCK(self->pool_lock);
+    self->hung_cb = callback;
+    self->hung_data = user_data;
+    self->watchdog_ms = interval_ms;
+    if(!self->watchdog_running && !self->shutting_down){
+        self->watchdog_running = 1;
+        P_THREAD_CREATE(thread, priv_EventQueue__watchdog_call, self);
+        P_THREAD_DETACH(thread);
+    } else {
+        //Running watchdog picks up the new interval
+        P_COND_SIGNAL(self->watchdog_cond);
+    }
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+//Must be called without pool_lock. Returns once the watchdog thread exited.
+void priv_EventQueue__stop_watchdog(EventQueue * self){
+    P_MUTEX_LOCK(self->pool_lock);
+    self->watchdog_ms = 0;
+    P_COND_SIGNAL(self->watchdog_cond);
+    while(self->watchdog_running){
+        P_COND_WAIT(self->finish_cond, self->pool_lock);
+    }
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+void * priv_EventQueue__watchdog_call(void * data){
+    EventQueue * self = (EventQueue *) data;
+    int started;
+    C_DEBUG("Watchdog started...");
+    P_MUTEX_LOCK(self->pool_lock);
+    while(self->watchdog_ms > 0){
+        priv_EventQueue__timed_wait(self,&self->watchdog_cond,(long long) self->watchdog_ms * 1000);
+        if(self->watchdog_ms <= 0){
+            break;
+        }
+        started = priv_EventQueue__check_overdue(self,QueueEvent__now_us());
+        if(started){
+            P_MUTEX_UNLOCK(self->pool_lock);
+            priv_EventQueue__notify_started(self,started);
+            P_MUTEX_LOCK(self->pool_lock);
+        }
+    }
+    self->watchdog_running = 0;
+    P_COND_BROADCAST(self->finish_cond);
+    P_MUTEX_UNLOCK(self->pool_lock);
+    C_DEBUG("Watchdog finished...");
+    P_THREAD_EXIT;
+}
+
+//Must be called while holding pool_lock.
+//Flags running events past their budget and starts a replacement worker for each. Returns the number of workers started.
+int priv_EventQueue__check_overdue(EventQueue * self, long long now){
+    int started = 0;
+    long long budget_us, running_us;
+    QueueEvent * evt;
+    QueuePool * pool;
+    EventQueueTask task;
+
+    for(evt = QueueEventList__get_first(&self->running_events); evt; evt = QueueEvent__get_next(evt)){
+        pool = priv_EventQueue__get_pool(self,evt);
+        budget_us = (long long)(QueueEvent__get_deadline(evt) ? QueueEvent__get_deadline(evt) : pool->deadline_ms) * 1000;
+        running_us = QueueEvent__get_start_time(evt) ? now - QueueEvent__get_start_time(evt) : 0;
+        if(budget_us <= 0 || QueueEvent__is_overdue(evt) || running_us <= budget_us){
+            continue;
+        }
+
+        //A callback blocked in I/O only notices once it returns, its result is then dropped
+        QueueEvent__set_overdue(evt);
+        QueueEvent__cancel(evt);
+        pool->hung_count++;
+
+        priv_EventQueue__snapshot_task(&task,0,1,evt,EVENTQUEUE_TASK_HUNG,running_us);
+        C_WARN("Task '%s' (0x%" PRIxPTR ") hung for %lld ms in pool '%s'",
+            task.name ? task.name : "unnamed", (uintptr_t) task.callback, running_us / 1000, pool->name);
+        if(self->hung_cb){
+            self->hung_cb(self,&task,self->hung_data);
+        }
+
+        started += priv_EventQueue__compensate(self,evt);
+    }
+    return started;
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__hung_returned(EventQueue * self, QueueEvent * evt, long long now){
+    QueuePool * pool = priv_EventQueue__get_pool(self,evt);
+    pool->hung_count--;
+    C_INFO("Hung task '%s' returned after %lld ms",
+        QueueEvent__get_name(evt) ? QueueEvent__get_name(evt) : "unnamed",
+        QueueEvent__get_start_time(evt) ? (now - QueueEvent__get_start_time(evt)) / 1000 : 0);
+}
+
+//Must be called while holding pool_lock.
+//Starts a temporary worker in place of the one stuck on a running event. Returns 1 if a worker was started.
+int priv_EventQueue__compensate(EventQueue * self, QueueEvent * evt){
+    QueuePool * pool = priv_EventQueue__get_pool(self,evt);
+    if(QueueEvent__is_compensated(evt) || pool->compensated >= EVENTQUEUE_MAX_COMPENSATION || self->shutting_down){
+        return 0;
+    }
+
+    priv_EventQueue__add_thread(self,QueueEvent__get_pool(evt));
+    QueueEvent__set_compensated(evt);
+    pool->compensated++;
+    return 1;
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__compensated_returned(EventQueue * self, QueueEvent * evt){
+    QueuePool * pool = priv_EventQueue__get_pool(self,evt);
+    pool->compensated--;
+    pool->retire_count++;
+    P_COND_SIGNAL(pool->sleep_cond);
+}
+
+//Pool names are never freed while the queue is alive
+const char * EventQueue__get_pool_name(EventQueue * self, int pool){
+    const char * ret = NULL;
+    P_MUTEX_LOCK(self->pool_lock);
+    if(pool >= 0 && pool < self->pool_count){
+        ret = self->pools[pool].name;
+    }
     P_MUTEX_UNLOCK(self->pool_lock);
+    return ret;
 }
 
 void EventQueue__clear(EventQueue* self){
-    //TODO Invoke cancellation and cleanup
-    CListTS__clear(&self->events);
+    QueueEvent * evt;
+    QueueEventList discarded;
+    QueueEventList__init(&discarded);
+
+    P_MUTEX_LOCK(self->pool_lock);
+    //Strand events parked behind a running event would otherwise be promoted once it finishes
+    for(int i=0;i<self->scopes.size;i++){
+        //The records stay alive, their strand is still active
+        for(QueueScope * record = self->scopes.buckets[i]; record; record = record->next){
+            while((evt = QueueEventList__pop(&record->strand))){
+                self->pending_count--;
+                priv_EventQueue__untrack(self,evt);
+                QueueEventList__append(&discarded,evt);
+            }
+        }
+    }
+    while((evt = priv_EventQueue__pop_pending(self,NULL,NULL))){
+        priv_EventQueue__strand_advance(self,evt);
+        priv_EventQueue__untrack(self,evt);
+        QueueEventList__append(&discarded,evt);
+    }
+    while((evt = QueueTimerHeap__pop(&self->timers))){
+        priv_EventQueue__untrack(self,evt);
+        QueueEventList__append(&discarded,evt);
+    }
+    for(int i=0;i<EVENTQUEUE_MAX_SINKS;i++){
+        priv_EventQueue__drop_completions(self,&self->sinks[i],&discarded);
+    }
+    priv_EventQueue__release_space(self);
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    priv_EventQueue__discard(self,&discarded);
 }
 
-void EventQueue__insert(EventQueue* queue, void * scope, void (*callback)(void * user_data), void * user_data){
+EventQueueInsertResult EventQueue__insert_event(EventQueue* queue, QueueEvent * record){
     if(!CObject__is_valid((CObject*)queue)){
-        return;//Stop accepting events
+        QueueEvent__cleanup(record);
+        CObject__destroy((CObject*)record);
+        return EVENTQUEUE_INSERT_REJECTED;//Stop accepting events
     }
     
+    int grow = 0;
+    EventQueueInsertResult ret;
+    QueueEventList discarded;
+    QueueEventList__init(&discarded);
+
     P_MUTEX_LOCK(queue->pool_lock);
+    priv_EventQueue__promote_timers(queue,QueueEvent__now_us());
+    ret = priv_EventQueue__insert_locked(queue,record,&discarded,NULL);
+    if(ret != EVENTQUEUE_INSERT_REJECTED){
+        grow = priv_EventQueue__should_grow(queue,priv_EventQueue__get_pool(queue,record));
+        if(grow){
+            priv_EventQueue__add_thread(queue,QueueEvent__get_pool(record));
+        }
+    }
+    P_MUTEX_UNLOCK(queue->pool_lock);
 
-    /* TODO Implement cleanup mechaism before uncommenting */
-    // if(!QueueEvent__is_cancelled(QueueEvent__get_current())){
-        QueueEvent * record = QueueEvent__create(scope, callback,user_data);
-        CListTS__add(&queue->events,(CObject*)record);
-    // } else {
-    //     C_WARN("Ignoring event dispatched from cancelled event...");
-    // }
+    priv_EventQueue__notify_started(queue,grow);
+    priv_EventQueue__discard(queue,&discarded);
+    if(ret == EVENTQUEUE_INSERT_REJECTED){
+        priv_EventQueue__reject(queue,record);
+    }
+    return ret;
+}
 
+int EventQueue__insert_many(EventQueue* queue, QueueEvent ** evts, int count){
+    QueueEvent * evt;
+    int queued = 0;
+    int grow = 0;
+    QueueEventList discarded;
+    QueueEventList rejected;
+    QueueEventList__init(&discarded);
+    QueueEventList__init(&rejected);
+
+    if(!CObject__is_valid((CObject*)queue)){
+        for(int i=0;i<count;i++){
+            QueueEvent__cleanup(evts[i]);
+            CObject__destroy((CObject*)evts[i]);
+        }
+        return 0;//Stop accepting events
+    }
+
+    P_MUTEX_LOCK(queue->pool_lock);
+    priv_EventQueue__promote_timers(queue,QueueEvent__now_us());
+    queue->defer_wakeups = 1;
+    for(int i=0;i<count;i++){
+        if(priv_EventQueue__insert_locked(queue,evts[i],&discarded,&rejected) != EVENTQUEUE_INSERT_REJECTED){
+            queued++;
+        }
+    }
+    queue->defer_wakeups = 0;
+    priv_EventQueue__flush_wakeups(queue);
+
+    //Growth is checked once per pool against the whole burst
+    for(int i=0;i<queue->pool_count;i++){
+        if(priv_EventQueue__should_grow(queue,&queue->pools[i])){
+            priv_EventQueue__add_thread(queue,i);
+            grow++;
+        }
+    }
     P_MUTEX_UNLOCK(queue->pool_lock);
-    P_COND_SIGNAL(queue->sleep_cond);
+
+    C_TRACE("Batch inserted %d of %d events",queued,count);
+    priv_EventQueue__notify_started(queue,grow);
+    priv_EventQueue__discard(queue,&discarded);
+    while((evt = QueueEventList__pop(&rejected))){
+        priv_EventQueue__reject(queue,evt);
+    }
+    return queued;
 }
 
-void EventQueue__cancel_scopes(EventQueue * self, void ** scopes, int count){
+//Must be called while holding pool_lock, released while a producer is blocked.
+//Superseded and dropped events are appended to discarded. A rejected event is appended to rejected, if provided.
+EventQueueInsertResult priv_EventQueue__insert_locked(EventQueue * self, QueueEvent * evt, QueueEventList * discarded, QueueEventList * rejected){
+    QueueEvent * superseded;
+    EventQueueInsertResult ret;
+    QueueEvent * current = QueueEvent__get_current();
+    //Follow-ups of a cancelled event would outlive the cancellation of its scope
+    if(current && QueueEvent__is_cancelled(current)){
+        C_WARN("Ignoring event dispatched from cancelled event...");
+        ret = EVENTQUEUE_INSERT_REJECTED;
+    } else {
+        ret = priv_EventQueue__make_room(self,evt,1,discarded);
+    }
+    if(ret == EVENTQUEUE_INSERT_REJECTED){
+        if(rejected){
+            QueueEventList__append(rejected,evt);
+        }
+        return ret;
+    }
+
+    //A newer event replaces the older pending one with the same key
+    superseded = priv_EventQueue__find_coalesced(self,evt);
+    if(superseded){
+        C_TRACE("Coalescing superseded event...");
+        priv_EventQueue__unlink_pending(self,superseded);
+        priv_EventQueue__untrack(self,superseded);
+        QueueEventList__append(discarded,superseded);
+    }
+
+    priv_EventQueue__track(self,evt);
+    priv_EventQueue__enqueue(self,evt);
+    return ret;
+}
+
+EventQueueInsertResult EventQueue__insert_with_priority(EventQueue* queue, EventQueuePriority priority, void * scope, void (*callback)(void * user_data), void * user_data){
+    if(!CObject__is_valid((CObject*)queue)){
+        return EVENTQUEUE_INSERT_REJECTED;//Stop accepting events
+    }
+    QueueEvent * record = QueueEvent__create(scope, callback,user_data);
+    QueueEvent__set_priority(record,priority);
+    return EventQueue__insert_event(queue,record);
+}
+
+EventQueueInsertResult EventQueue__insert_strand(EventQueue* queue, EventQueuePriority priority, void * scope, void (*callback)(void * user_data), void * user_data){
+    if(!CObject__is_valid((CObject*)queue)){
+        return EVENTQUEUE_INSERT_REJECTED;//Stop accepting events
+    }
+    QueueEvent * record = QueueEvent__create(scope, callback,user_data);
+    QueueEvent__set_priority(record,priority);
+    QueueEvent__set_strand(record,1);
+    return EventQueue__insert_event(queue,record);
+}
+
+EventQueueInsertResult EventQueue__insert_coalesced(EventQueue* queue, EventQueuePriority priority, void * scope, void * key, void (*callback)(void * user_data), void * user_data, void (*cleanup)(void * user_data)){
+    QueueEvent * record = QueueEvent__create(scope, callback,user_data);
+    QueueEvent__set_priority(record,priority);
+    QueueEvent__set_coalesce(record,key);
+    QueueEvent__set_cleanup_callback(record,cleanup);
+    return EventQueue__insert_event(queue,record);
+}
+
+EventQueueInsertResult EventQueue__insert_copy(EventQueue* queue, EventQueuePriority priority, void * scope, void (*callback)(void * user_data), const void * data, size_t size, void (*cleanup)(void * user_data)){
+    QueueEvent * record = QueueEvent__create_copy(scope, callback, data, size);
+    QueueEvent__set_priority(record,priority);
+    QueueEvent__set_cleanup_callback(record,cleanup);
+    return EventQueue__insert_event(queue,record);
+}
+
+EventQueueInsertResult EventQueue__schedule_event(EventQueue* queue, QueueEvent * record, int delay_ms){
+    EventQueueInsertResult ret;
+    QueueEventList discarded;
+    QueueEventList__init(&discarded);
+
+    if(!CObject__is_valid((CObject*)queue)){
+        QueueEvent__cleanup(record);
+        CObject__destroy((CObject*)record);
+        return EVENTQUEUE_INSERT_REJECTED;//Stop accepting events
+    }
+
+    P_MUTEX_LOCK(queue->pool_lock);
+    ret = priv_EventQueue__make_room(queue,record,0,&discarded);
+    if(ret == EVENTQUEUE_INSERT_REJECTED){
+        P_MUTEX_UNLOCK(queue->pool_lock);
+        priv_EventQueue__discard(queue,&discarded);
+        priv_EventQueue__reject(queue,record);
+        return ret;
+    }
+    priv_EventQueue__track(queue,record);
+    //Idle workers need to shorten their wait
+    if(priv_EventQueue__schedule(queue,record,delay_ms)){
+        priv_EventQueue__wake_all(queue);
+    }
+    P_MUTEX_UNLOCK(queue->pool_lock);
+
+    priv_EventQueue__discard(queue,&discarded);
+    return ret;
+}
+
+EventQueueInsertResult EventQueue__insert_delayed(EventQueue* queue, EventQueuePriority priority, void * scope, int delay_ms, void (*callback)(void * user_data), void * user_data){
+    QueueEvent * record = QueueEvent__create(scope, callback,user_data);
+    QueueEvent__set_priority(record,priority);
+    return EventQueue__schedule_event(queue,record,delay_ms);
+}
+
+EventQueueInsertResult EventQueue__insert_periodic(EventQueue* queue, EventQueuePriority priority, void * scope, int period_ms, void (*callback)(void * user_data), void * user_data){
+    QueueEvent * record = QueueEvent__create(scope, callback,user_data);
+    QueueEvent__set_priority(record,priority);
+    QueueEvent__set_period(record,period_ms);
+    return EventQueue__schedule_event(queue,record,period_ms);
+}
+
+EventQueueInsertResult EventQueue__insert(EventQueue* queue, void * scope, void (*callback)(void * user_data), void * user_data){
+    return EventQueue__insert_with_priority(queue, EVENTQUEUE_PRIORITY_NORMAL, scope, callback, user_data);
+}
+
+void EventQueue__set_capacity(EventQueue* self, int capacity, EventQueueOverflowPolicy policy){
     P_MUTEX_LOCK(self->pool_lock);
-    int i, a, evtcount;
-    
-    //Clean up pending events
-    evtcount = CListTS__get_count(&self->events);
-    for(i=0;i<evtcount;i++){
-        QueueEvent * evt = (QueueEvent *) CListTS__get(&self->events, i);
-        for(a=0;a<count;a++){
-            void * scope_to_cancel = scopes[a];
-            if(scope_to_cancel == QueueEvent__get_scope(evt)){
-                C_INFO("Removing from queue...");
-                CListTS__remove_record(&self->events,(CObject*)evt);
-                i--;
-                evtcount--;
-                if(self->queue_event_cb){
-                    self->queue_event_cb(self,EVENTQUEUE_CANCELLED,self->user_data);
+    self->capacity = capacity > 0 ? capacity : 0;
+    self->overflow_policy = policy;
+    //Producers blocked on the previous bound check again
+    P_COND_BROADCAST(self->space_cond);
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+void EventQueue__set_scope_capacity(EventQueue* self, int capacity, EventQueueOverflowPolicy policy){
+    P_MUTEX_LOCK(self->pool_lock);
+    self->scope_capacity = capacity > 0 ? capacity : 0;
+    self->scope_overflow_policy = policy;
+    P_COND_BROADCAST(self->space_cond);
+    P_MUTEX_UNLOCK(self->pool_lock);
+}
+
+//Must be called while holding pool_lock, released while a producer is blocked.
+//Applies the overflow policy until evt fits in both the queue and its scope. Dropped events are appended to discarded.
+EventQueueInsertResult priv_EventQueue__make_room(EventQueue * self, QueueEvent * evt, int coalescing, QueueEventList * discarded){
+    EventQueueInsertResult ret = EVENTQUEUE_INSERT_OK;
+    EventQueueOverflowPolicy policy;
+    QueueScope * record;
+    QueueEvent * victim;
+    QueueThread * current = QueueThread__get_current();
+    int blocked = 0;
+    int deferring;
+
+    while(!self->shutting_down){
+        record = NULL;
+        if(self->capacity && self->pending_count + QueueTimerHeap__get_count(&self->timers) >= self->capacity){
+            policy = self->overflow_policy;
+        } else if(self->scope_capacity && QueueEvent__get_scope(evt)
+                    && (record = QueueScopeTable__get(&self->scopes,QueueEvent__get_scope(evt)))
+                    && priv_EventQueue__scope_queued_count(self,record) >= self->scope_capacity){
+            policy = self->scope_overflow_policy;
+        } else {
+            return ret;
+        }
+
+        //A coalesced event takes the place of the one it supersedes
+        if(coalescing && priv_EventQueue__find_coalesced(self,evt)){
+            return ret;
+        }
+
+        //A worker waiting on its own queue could end up waiting on itself
+        if(policy == EVENTQUEUE_OVERFLOW_BLOCK && current && QueueThread__get_queue(current) == self){
+            policy = EVENTQUEUE_OVERFLOW_REJECT;
+        }
+
+        if(!blocked){
+            self->overflow_count[policy]++;
+        }
+
+        switch(policy){
+            case EVENTQUEUE_OVERFLOW_BLOCK:
+                blocked = 1;
+                //Events already batched must reach the workers, they are the ones making room
+                deferring = self->defer_wakeups;
+                self->defer_wakeups = 0;
+                priv_EventQueue__flush_wakeups(self);
+                self->blocked_producers++;
+                P_COND_WAIT(self->space_cond, self->pool_lock);
+                self->blocked_producers--;
+                self->defer_wakeups = deferring;
+                break;
+            case EVENTQUEUE_OVERFLOW_DROP_OLDEST:
+            case EVENTQUEUE_OVERFLOW_DROP_NEWEST:
+                victim = priv_EventQueue__find_victim(self,record,policy == EVENTQUEUE_OVERFLOW_DROP_NEWEST);
+                if(!victim){
+                    return EVENTQUEUE_INSERT_REJECTED;
+                }
+                C_DEBUG("Queue full, dropping '%s'...",QueueEvent__get_name(victim) ? QueueEvent__get_name(victim) : "unnamed");
+                priv_EventQueue__unlink_queued(self,victim);
+                priv_EventQueue__untrack(self,victim);
+                QueueEventList__append(discarded,victim);
+                ret = EVENTQUEUE_INSERT_DROPPED;
+                break;
+            case EVENTQUEUE_OVERFLOW_REJECT:
+            default:
+                C_DEBUG("Queue full, rejecting '%s'...",QueueEvent__get_name(evt) ? QueueEvent__get_name(evt) : "unnamed");
+                return EVENTQUEUE_INSERT_REJECTED;
+        }
+    }
+    return EVENTQUEUE_INSERT_REJECTED;
+}
+
+//Must be called while holding pool_lock.
+//Pending (runnable or parked) and scheduled events count against the capacity, running and completed ones don't.
+int priv_EventQueue__is_queued(EventQueue * self, QueueEvent * evt){
+    QueueEventList * list = QueueEvent__get_list(evt);
+    if(QueueEvent__get_timer_index(evt) >= 0){
+        return 1;
+    }
+    return list && list != &self->running_events && !priv_EventQueue__owns_completed(self,list);
+}
+
+//Must be called while holding pool_lock.
+int priv_EventQueue__scope_queued_count(EventQueue * self, QueueScope * record){
+    int count = 0;
+    for(QueueEvent * evt = record->events; evt; evt = QueueEvent__get_scope_next(evt)){
+        count += priv_EventQueue__is_queued(self,evt);
+    }
+    return count;
+}
+
+int priv_EventQueue__is_better_victim(QueueEvent * evt, QueueEvent * victim, int newest){
+    if(!victim){
+        return 1;
+    }
+    return newest ? QueueEvent__get_enqueue_time(evt) > QueueEvent__get_enqueue_time(victim)
+                  : QueueEvent__get_enqueue_time(evt) < QueueEvent__get_enqueue_time(victim);
+}
+
+//Must be called while holding pool_lock.
+//Returns the oldest (or newest) queued event of the scope, or of the whole queue if record is NULL.
+QueueEvent * priv_EventQueue__find_victim(EventQueue * self, QueueScope * record, int newest){
+    int i, p;
+    QueueEvent * evt;
+    QueueEvent * victim = NULL;
+    QueueEventList * lane;
+
+    if(record){
+        for(evt = record->events; evt; evt = QueueEvent__get_scope_next(evt)){
+            if(priv_EventQueue__is_queued(self,evt) && priv_EventQueue__is_better_victim(evt,victim,newest)){
+                victim = evt;
+            }
+        }
+        return victim;
+    }
+
+    //Lanes are in insertion order, only their ends need checking
+    for(p=0;p<self->pool_count;p++){
+        for(i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+            lane = &self->pools[p].lanes[i];
+            evt = newest ? lane->tail : lane->head;
+            if(evt && priv_EventQueue__is_better_victim(evt,victim,newest)){
+                victim = evt;
+            }
+        }
+        for(QueueDeque * deque = self->pools[p].deques; deque; deque = deque->next){
+            for(i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+                evt = newest ? deque->lanes[i].tail : deque->lanes[i].head;
+                if(evt && priv_EventQueue__is_better_victim(evt,victim,newest)){
+                    victim = evt;
                 }
-                CObject__destroy((CObject*)evt);
             }
         }
     }
+    for(i=0;i<self->scopes.size;i++){
+        for(QueueScope * scope = self->scopes.buckets[i]; scope; scope = scope->next){
+            evt = newest ? scope->strand.tail : scope->strand.head;
+            if(evt && priv_EventQueue__is_better_victim(evt,victim,newest)){
+                victim = evt;
+            }
+        }
+    }
+    for(i=0;i<self->timers.count;i++){
+        if(priv_EventQueue__is_better_victim(self->timers.events[i],victim,newest)){
+            victim = self->timers.events[i];
+        }
+    }
+    return victim;
+}
+
+//Must be called while holding pool_lock.
+//Invoked whenever queued events leave the queue.
+void priv_EventQueue__release_space(EventQueue * self){
+    if(self->blocked_producers){
+        P_COND_BROADCAST(self->space_cond);
+    }
+}
+
+void EventQueue__cancel_scopes(EventQueue * self, void ** scopes, int count){
+    int a;
+    int started = 0;
+    QueueEvent * evt;
+    QueueEvent * next;
+    QueueScope * record;
+    QueueEventList cancelled;
+    QueueEventList__init(&cancelled);
+
+    P_MUTEX_LOCK(self->pool_lock);
+    for(a=0;a<count;a++){
+        record = QueueScopeTable__get(&self->scopes,scopes[a]);
+        if(!record){
+            continue;
+        }
 
-    //Cancellation request for running event
-    evtcount = CListTS__get_count(&self->running_events);
-    for(i=0;i<evtcount;i++){
-        QueueEvent * evt = (QueueEvent *) CListTS__get(&self->running_events, i);
-        for(a=0;a<count;a++){
-            void * scope_to_cancel = scopes[a];
-            if(scope_to_cancel == QueueEvent__get_scope(evt)){
-                C_INFO("Cancelling running event...");
+        for(evt = record->events; evt; evt = next){
+            next = QueueEvent__get_scope_next(evt);
+            if(QueueEvent__get_list(evt) == &self->running_events){
+                //Cancellation request for running event, aborting its blocking call if it registered one
                 QueueEvent__cancel(evt);
+                //Otherwise its worker stays busy until the call returns on its own
+                if(!QueueEvent__has_abort_callback(evt)){
+                    started += priv_EventQueue__compensate(self,evt);
+                }
+                continue;
             }
+            priv_EventQueue__unlink_queued(self,evt);
+            QueueScope__remove_event(record,evt);
+            QueueEventList__append(&cancelled,evt);
         }
+        QueueScopeTable__release(&self->scopes,record);
     }
     P_MUTEX_UNLOCK(self->pool_lock);
+
+    priv_EventQueue__notify_started(self,started);
+    C_DEBUG("Cancelled %d events...",QueueEventList__get_count(&cancelled));
+    priv_EventQueue__discard(self,&cancelled);
+}
+
+//Must be called without pool_lock since the callbacks may query or insert into the queue
+void priv_EventQueue__discard(EventQueue * self, QueueEventList * discarded){
+    QueueEvent * evt;
+    while((evt = QueueEventList__pop(discarded))){
+        QueueEvent__cleanup(evt);
+        if(self->queue_event_cb){
+            self->queue_event_cb(self,EVENTQUEUE_CANCELLED,self->user_data);
+        }
+        CObject__destroy((CObject*)evt);
+    }
+}
+
+//Must be called without pool_lock. Disposes of an event refused after shutdown, for lack of room or inserted from a cancelled event.
+void priv_EventQueue__reject(EventQueue * self, QueueEvent * evt){
+    C_TRACE("Rejecting event...");
+    QueueEvent__cleanup(evt);
+    CObject__destroy((CObject*)evt);
+}
+
+//Must be called while holding pool_lock.
+//Removes a pending event from either its lane or its scope's parked strand list.
+void priv_EventQueue__unlink_pending(EventQueue * self, QueueEvent * evt){
+    QueueEventList * list = QueueEvent__get_list(evt);
+    int in_lane = priv_EventQueue__owns_pending(self,list);
+
+    QueueEventList__remove(list,evt);
+    self->pending_count--;
+    priv_EventQueue__release_space(self);
+    if(in_lane){
+        //Only the active event of a strand sits in a lane
+        priv_EventQueue__strand_advance(self,evt);
+    }
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__unlink_queued(EventQueue * self, QueueEvent * evt){
+    if(QueueEvent__get_timer_index(evt) >= 0){
+        QueueTimerHeap__remove(&self->timers,evt);
+        priv_EventQueue__release_space(self);
+    } else if(priv_EventQueue__owns_completed(self,QueueEvent__get_list(evt))){
+        QueueEventList__remove(QueueEvent__get_list(evt),evt);
+    } else {
+        priv_EventQueue__unlink_pending(self,evt);
+    }
+}
+
+//Must be called while holding pool_lock.
+//Adds the event to its scope index until it leaves the queue.
+void priv_EventQueue__track(EventQueue * self, QueueEvent * evt){
+    void * scope = QueueEvent__get_scope(evt);
+    QueueEvent__set_enqueue_time(evt,QueueEvent__now_us());
+    if(scope){
+        QueueScope__add_event(QueueScopeTable__get_or_create(&self->scopes,scope),evt);
+    }
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__untrack(EventQueue * self, QueueEvent * evt){
+    void * scope = QueueEvent__get_scope(evt);
+    if(!scope){
+        return;
+    }
+    QueueScope * record = QueueScopeTable__get(&self->scopes,scope);
+    if(record){
+        QueueScope__remove_event(record,evt);
+        QueueScopeTable__release(&self->scopes,record);
+    }
+}
+
+//Must be called while holding pool_lock.
+QueueEvent * priv_EventQueue__find_coalesced(EventQueue * self, QueueEvent * evt){
+    int i, p;
+    QueueEvent * pending;
+    QueueScope * record;
+
+    if(!QueueEvent__coalesces_with(evt,evt)){
+        return NULL;
+    }
+
+    //Events coalescing on (scope, callback) are found through the scope index
+    if(!QueueEvent__get_coalesce_key(evt) && QueueEvent__get_scope(evt)){
+        record = QueueScopeTable__get(&self->scopes,QueueEvent__get_scope(evt));
+        for(pending = record ? record->events : NULL; pending; pending = QueueEvent__get_scope_next(pending)){
+            if(QueueEvent__get_list(pending) != &self->running_events
+                    && QueueEvent__get_timer_index(pending) < 0
+                    && !priv_EventQueue__owns_completed(self,QueueEvent__get_list(pending))
+                    && QueueEvent__coalesces_with(evt,pending)){
+                return pending;
+            }
+        }
+        return NULL;
+    }
+
+    for(p=0;p<self->pool_count;p++){
+        for(i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+            for(pending = QueueEventList__get_first(&self->pools[p].lanes[i]); pending; pending = QueueEvent__get_next(pending)){
+                if(QueueEvent__coalesces_with(evt,pending)){
+                    return pending;
+                }
+            }
+        }
+        for(QueueDeque * deque = self->pools[p].deques; deque; deque = deque->next){
+            for(i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+                for(pending = QueueEventList__get_first(&deque->lanes[i]); pending; pending = QueueEvent__get_next(pending)){
+                    if(QueueEvent__coalesces_with(evt,pending)){
+                        return pending;
+                    }
+                }
+            }
+        }
+    }
+
+    //Parked strand events
+    for(i=0;i<self->scopes.size;i++){
+        for(record = self->scopes.buckets[i]; record; record = record->next){
+            for(pending = QueueEventList__get_first(&record->strand); pending; pending = QueueEvent__get_next(pending)){
+                if(QueueEvent__coalesces_with(evt,pending)){
+                    return pending;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+//Must be called while holding pool_lock.
+//Strand events are parked on their scope while another strand event of the same scope is pending or running.
+void priv_EventQueue__enqueue(EventQueue * self, QueueEvent * evt){
+    void * scope = QueueEvent__get_scope(evt);
+    if(QueueEvent__is_strand(evt) && scope){
+        QueueScope * record = QueueScopeTable__get_or_create(&self->scopes,scope);
+        if(record->strand_active){
+            QueueEventList__append(&record->strand,evt);
+            self->pending_count++;
+            return;
+        }
+        record->strand_active = 1;
+    }
+    priv_EventQueue__ready(self,evt);
+    self->pending_count++;
+}
+
+//Must be called while holding pool_lock.
+//Makes the event runnable and wakes a worker of its pool. The event may belong to another pool than the caller's worker.
+void priv_EventQueue__ready(EventQueue * self, QueueEvent * evt){
+    QueuePool * pool = priv_EventQueue__get_pool(self,evt);
+    QueueDeque * deque = priv_EventQueue__get_local_deque(self,evt);
+    QueueEvent * current = deque ? QueueEvent__get_current() : NULL;
+    long long now = QueueEvent__now_us();
+    QueueEvent__set_ready_time(evt,now);
+    if(deque){
+        //Served by this worker once its callback returns, unless an idle one steals it first.
+        //Follow-ups are as old as the work they continue, the worker finishes it before taking newer lane events.
+        QueueEvent__set_origin_time(evt,current && QueueEvent__get_origin_time(current) ? QueueEvent__get_origin_time(current) : now);
+        QueueDeque__push(deque,evt);
+    } else {
+        QueueEvent__set_origin_time(evt,now);
+        QueuePool__push(pool,evt);
+    }
+    if(self->defer_wakeups){
+        pool->deferred_wakeups++;
+    } else {
+        P_COND_SIGNAL(pool->sleep_cond);
+    }
+}
+
+//Must be called while holding pool_lock.
+//Signals one idle worker per event readied during the batch. Busy workers pick up the rest once they return.
+void priv_EventQueue__flush_wakeups(EventQueue * self){
+    for(int i=0;i<self->pool_count;i++){
+        QueuePool * pool = &self->pools[i];
+        int wakeups = pool->deferred_wakeups < pool->idle_count ? pool->deferred_wakeups : pool->idle_count;
+        for(int j=0;j<wakeups;j++){
+            P_COND_SIGNAL(pool->sleep_cond);
+        }
+        pool->deferred_wakeups = 0;
+    }
+}
+
+//Must be called while holding pool_lock.
+//Returns the deque of the calling worker if it serves the event's pool, NULL otherwise.
+QueueDeque * priv_EventQueue__get_local_deque(EventQueue * self, QueueEvent * evt){
+    QueueThread * current;
+    if(!self->work_stealing){
+        return NULL;
+    }
+    current = QueueThread__get_current();
+    if(!current || QueueThread__get_queue(current) != self || QueueThread__get_pool(current) != QueueEvent__get_pool(evt)){
+        return NULL;
+    }
+    return QueueThread__get_deque(current);
+}
+
+//Must be called while holding pool_lock.
+QueuePool * priv_EventQueue__get_pool(EventQueue * self, QueueEvent * evt){
+    int pool = QueueEvent__get_pool(evt);
+    if(pool < 0 || pool >= self->pool_count){
+        QueueEvent__set_pool(evt,EVENTQUEUE_DEFAULT_POOL);
+        pool = EVENTQUEUE_DEFAULT_POOL;
+    }
+    return &self->pools[pool];
+}
+
+//Must be called while holding pool_lock.
+int priv_EventQueue__owns_pending(EventQueue * self, QueueEventList * list){
+    for(int i=0;i<self->pool_count;i++){
+        if(QueuePool__owns(&self->pools[i],list)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//Must be called while holding pool_lock.
+int priv_EventQueue__owns_completed(EventQueue * self, QueueEventList * list){
+    return list >= &self->sinks[0].completed && list <= &self->sinks[EVENTQUEUE_MAX_SINKS-1].completed;
+}
+
+//Must be called while holding pool_lock.
+//Hands a dispatched future over to its sink. Returns 0 if it has no active sink.
+int priv_EventQueue__post_completion(EventQueue * self, QueueEvent * evt){
+    int id = QueueEvent__get_sink(evt);
+    if(id < 0 || id >= EVENTQUEUE_MAX_SINKS || !self->sinks[id].active){
+        return 0;
+    }
+
+    QueueSink * sink = &self->sinks[id];
+    QueueEventList__append(&sink->completed,evt);
+    if(QueueEventList__get_count(&sink->completed) == 1 && sink->wakeup){
+        sink->wakeup(sink->wakeup_data);
+    }
+    return 1;
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__drop_completions(EventQueue * self, QueueSink * sink, QueueEventList * discarded){
+    QueueEvent * evt;
+    while((evt = QueueEventList__pop(&sink->completed))){
+        priv_EventQueue__untrack(self,evt);
+        QueueEventList__append(discarded,evt);
+    }
+}
+
+int EventQueue__add_sink(EventQueue * self, void (*wakeup)(void * data), void * data){
+    int ret = -1;
+    P_MUTEX_LOCK(self->pool_lock);
+    for(int i=0;i<EVENTQUEUE_MAX_SINKS;i++){
+        if(!self->sinks[i].active){
+            QueueEventList__init(&self->sinks[i].completed);
+            self->sinks[i].wakeup = wakeup;
+            self->sinks[i].wakeup_data = data;
+            self->sinks[i].active = 1;
+            ret = i;
+            break;
+        }
+    }
+    P_MUTEX_UNLOCK(self->pool_lock);
+    return ret;
+}
+
+void EventQueue__remove_sink(EventQueue * self, int sink){
+    QueueEventList discarded;
+    QueueEventList__init(&discarded);
+    if(sink < 0 || sink >= EVENTQUEUE_MAX_SINKS){
+        return;
+    }
+
+    P_MUTEX_LOCK(self->pool_lock);
+    priv_EventQueue__drop_completions(self,&self->sinks[sink],&discarded);
+    self->sinks[sink].active = 0;
+    self->sinks[sink].wakeup = NULL;
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    priv_EventQueue__discard(self,&discarded);
+}
+
+int EventQueue__complete(EventQueue * self, int sink, int max){
+    int left;
+    QueueEvent * evt;
+    QueueEventList ready;
+    QueueEventList__init(&ready);
+    if(sink < 0 || sink >= EVENTQUEUE_MAX_SINKS){
+        return 0;
+    }
+
+    P_MUTEX_LOCK(self->pool_lock);
+    while(QueueEventList__get_count(&ready) < max && (evt = QueueEventList__pop(&self->sinks[sink].completed))){
+        priv_EventQueue__untrack(self,evt);
+        QueueEventList__append(&ready,evt);
+    }
+    left = QueueEventList__get_count(&self->sinks[sink].completed);
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    //Continuations may insert new events
+    while((evt = QueueEventList__pop(&ready))){
+        QueueEvent__complete(evt);
+        CObject__destroy((CObject*)evt);
+    }
+    return left;
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__wake_all(EventQueue * self){
+    for(int i=0;i<self->pool_count;i++){
+        P_COND_BROADCAST(self->pools[i].sleep_cond);
+    }
+}
+
+//Must be called while holding pool_lock.
+//Invoked once the active strand event of a scope leaves the queue, either finished or discarded.
+void priv_EventQueue__strand_advance(EventQueue * self, QueueEvent * evt){
+    void * scope = QueueEvent__get_scope(evt);
+    if(!QueueEvent__is_strand(evt) || !scope){
+        return;
+    }
+
+    QueueScope * record = QueueScopeTable__get(&self->scopes,scope);
+    if(!record){
+        return;
+    }
+
+    QueueEvent * next = QueueEventList__pop(&record->strand);
+    if(next){
+        //Already accounted for in pending_count
+        priv_EventQueue__ready(self,next);
+    } else {
+        record->strand_active = 0;
+        QueueScopeTable__release(&self->scopes,record);
+    }
+}
+
+//Must be called while holding pool_lock.
+//Pops from the given pool, or from every pool in order if pool is NULL. deque is the calling worker's own.
+QueueEvent * priv_EventQueue__pop_pending(EventQueue * self, QueuePool * pool, QueueDeque * deque){
+    QueueEvent * evt = NULL;
+    if(!self->pending_count){
+        return NULL;
+    }
+
+    if(pool){
+        evt = QueuePool__pop_worker(pool,deque);
+    } else {
+        for(int i=0;i<self->pool_count && !evt;i++){
+            evt = QueuePool__pop_worker(&self->pools[i],NULL);
+        }
+    }
+
+    //Remaining pending events are parked behind a running strand event
+    if(evt){
+        self->pending_count--;
+        priv_EventQueue__release_space(self);
+    }
+    return evt;
 }
 
 QueueEvent * EventQueue__pop(EventQueue* self){
     P_MUTEX_LOCK(self->pool_lock);
-    QueueEvent * qe = (QueueEvent*) CListTS__pop(&self->events);
-    CListTS__add(&self->running_events,(CObject*)qe);
+    QueueEvent * qe = priv_EventQueue__pop_pending(self,NULL,NULL);
+    if(qe){
+        QueueEventList__append(&self->running_events,qe);
+    }
     P_MUTEX_UNLOCK(self->pool_lock);
     return qe;
 }
 
-void EventQueue__start(EventQueue* self){
+QueueEvent * EventQueue__wait_pop(EventQueue* self, QueueThread * qt){
+    QueueEvent * qe = NULL;
+    QueueEvent * timer;
+    long long now, wake_us;
+    long long idle_since = -1;
+    int grow = 0;
     P_MUTEX_LOCK(self->pool_lock);
-    QueueThread * qt = QueueThread__create(self);
-    CListTS__add(&self->threads,(CObject*)qt);
+    QueuePool * pool = &self->pools[QueueThread__get_pool(qt)];
+    //Cancellation and insertion both happen under pool_lock, so no wakeup is lost between the check and the wait
+    while(!QueueThread__is_cancelled(qt)){
+        if(pool->retire_count){
+            pool->retire_count--;
+            //Elastic pools may already have shrunk back to their minimum
+            if(pool->worker_count > pool->min_threads){
+                //A hung event returned, its replacement is no longer needed
+                C_DEBUG("Retiring '%s' compensation worker...",pool->name);
+                QueueThread__cancel(qt);
+                pool->worker_count--;
+                break;
+            }
+        }
+
+        now = QueueEvent__now_us();
+        priv_EventQueue__promote_timers(self,now);
+        qe = priv_EventQueue__pop_pending(self,pool,QueueThread__get_deque(qt));
+        if(qe){
+            QueueEventList__append(&self->running_events,qe);
+            //Events left behind may already be starving
+            grow = priv_EventQueue__should_grow(self,pool);
+            if(grow){
+                priv_EventQueue__add_thread(self,QueueThread__get_pool(qt));
+            }
+            break;
+        }
+
+        if(idle_since < 0){
+            idle_since = now;
+        } else if(pool->max_threads && now - idle_since >= (long long) pool->keepalive_ms * 1000){
+            if(pool->worker_count > pool->min_threads){
+                //Idle past keep-alive, retire this worker
+                C_DEBUG("Retiring idle '%s' worker...",pool->name);
+                QueueThread__cancel(qt);
+                pool->worker_count--;
+                break;
+            }
+            idle_since = now; //Pool is at its minimum, keep waiting
+        }
+
+        //Sleep until the keep-alive expires or the next scheduled event is due
+        wake_us = pool->max_threads ? idle_since + (long long) pool->keepalive_ms * 1000 : -1;
+        timer = QueueTimerHeap__peek(&self->timers);
+        if(timer && (wake_us < 0 || QueueEvent__get_due_time(timer) < wake_us)){
+            wake_us = QueueEvent__get_due_time(timer);
+        }
+
+        pool->idle_count++;
+        if(wake_us < 0){
+            P_COND_WAIT(pool->sleep_cond, self->pool_lock);
+        } else if(wake_us > now){
+            priv_EventQueue__timed_wait(self,&pool->sleep_cond,wake_us - now);
+        }
+        pool->idle_count--;
+    }
+    //The worker is exiting, its remaining events go back to the pool
+    if(!qe && QueuePool__remove_deque(pool,QueueThread__get_deque(qt))){
+        P_COND_BROADCAST(pool->sleep_cond);
+    }
     P_MUTEX_UNLOCK(self->pool_lock);
 
-    if(self->queue_event_cb){
+    priv_EventQueue__notify_started(self,grow);
+    return qe;
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__timed_wait(EventQueue * self, P_COND_TYPE * cond, long long delay_us){
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += delay_us / 1000000;
+    deadline.tv_nsec += (long)(delay_us % 1000000) * 1000;
+    if(deadline.tv_nsec >= 1000000000){
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    P_COND_TIMEDWAIT(*cond, self->pool_lock, &deadline);
+}
+
+//Must be called while holding pool_lock.
+//Returns 1 if the event is now the next one due.
+int priv_EventQueue__schedule(EventQueue * self, QueueEvent * evt, int delay_ms){
+    QueueEvent__set_due_time(evt,QueueEvent__now_us() + (long long) delay_ms * 1000);
+    QueueTimerHeap__push(&self->timers,evt);
+    return QueueTimerHeap__peek(&self->timers) == evt;
+}
+
+//Must be called while holding pool_lock.
+int priv_EventQueue__promote_timers(EventQueue * self, long long now){
+    int count = 0;
+    QueueEvent * timer;
+    while((timer = QueueTimerHeap__peek(&self->timers)) && QueueEvent__get_due_time(timer) <= now){
+        QueueTimerHeap__pop(&self->timers);
+        priv_EventQueue__enqueue(self,timer);
+        count++;
+    }
+    return count;
+}
+
+//Must be called while holding pool_lock.
+int priv_EventQueue__should_grow(EventQueue * self, QueuePool * pool){
+    long long oldest;
+
+    if(!pool->max_threads || pool->idle_count || pool->worker_count >= pool->max_threads){
+        return 0;
+    }
+
+    oldest = QueuePool__get_oldest_ready_time(pool);
+    return oldest >= 0 && QueueEvent__now_us() - oldest >= (long long) pool->grow_threshold_ms * 1000;
+}
+
+//Must be called while holding pool_lock.
+void priv_EventQueue__add_thread(EventQueue * self, int pool){
+    QueueThread * qt = QueueThread__create(self,pool);
+    CListTS__add(&self->threads,(CObject*)qt);
+    //The worker can't pop before pool_lock is released, its deque is registered first
+    QueuePool__add_deque(&self->pools[pool],QueueThread__get_deque(qt));
+    self->pools[pool].worker_count++;
+}
+
+void priv_EventQueue__notify_started(EventQueue * self, int count){
+    int i;
+    if(!self->queue_event_cb){
+        return;
+    }
+    for(i=0;i<count;i++){
         self->queue_event_cb(self,EVENTQUEUE_STARTED,self->user_data);
     }
 }
 
+void EventQueue__start(EventQueue* self){
+    P_MUTEX_LOCK(self->pool_lock);
+    priv_EventQueue__add_thread(self,EVENTQUEUE_DEFAULT_POOL);
+    P_MUTEX_UNLOCK(self->pool_lock);
+
+    priv_EventQueue__notify_started(self,1);
+}
+
 void EventQueue__wait_condition(EventQueue * self, P_MUTEX_TYPE lock){
-    P_COND_WAIT(self->sleep_cond, lock);
+    P_COND_WAIT(self->pools[EVENTQUEUE_DEFAULT_POOL].sleep_cond, lock);
 }
 
-void EventQueue_notify(EventQueue * self, EventQueueType type){
+int EventQueue_notify(EventQueue * self, EventQueueType type){
     C_TRACE("event notify...");
+    int retained = 0;
     if(type == EVENTQUEUE_DISPATCHED || type == EVENTQUEUE_CANCELLED){
+        QueueEvent * current = QueueEvent__get_current();
+        long long started = QueueEvent__get_start_time(current);
+        long long now = QueueEvent__now_us();
         P_MUTEX_LOCK(self->pool_lock);
-        CListTS__remove_record(&self->running_events,(CObject*)QueueEvent__get_current());
+        QueueEventList__remove(&self->running_events,current);
+        self->finished_count++;
+        if(started){
+            self->busy_us += now - started;
+        }
+        if(QueueEvent__is_overdue(current)){
+            priv_EventQueue__hung_returned(self,current,now);
+        }
+        if(QueueEvent__is_compensated(current)){
+            priv_EventQueue__compensated_returned(self,current);
+        }
+        priv_EventQueue__strand_advance(self,current);
+        //Completed futures stay indexed by scope until their continuation runs, so cancel_scopes can still drop them
+        if(type == EVENTQUEUE_DISPATCHED && QueueEvent__is_future(current) && !self->shutting_down && priv_EventQueue__post_completion(self,current)){
+            retained = 1;
+        //Periodic events go back to the timers under the same lock, so cancel_scopes can't miss them
+        } else if(type == EVENTQUEUE_DISPATCHED && QueueEvent__get_period(current) && !QueueEvent__is_cancelled(current) && !self->shutting_down){
+            QueueEvent__set_start_time(current,0);
+            if(priv_EventQueue__schedule(self,current,QueueEvent__get_period(current))){
+                priv_EventQueue__wake_all(self);
+            }
+            retained = 1;
+        } else {
+            priv_EventQueue__untrack(self,current);
+        }
         P_MUTEX_UNLOCK(self->pool_lock);
+
+        if(!retained && (QueueEvent__get_period(current) || QueueEvent__is_future(current))){
+            //The periodic series ends with its cancellation, and dropped futures never reach their continuation
+            QueueEvent__cleanup(current);
+        }
     }
     if(self->queue_event_cb){
         self->queue_event_cb(self,type,self->user_data);
     }
+    return retained;
 }
@@ -7,6 +7,7 @@ typedef struct _EventQueue EventQueue;
 
 #include "queue_thread.h"
 #include "queue_event.h"
+#include "queue_stats.h"
 #include "portable_thread.h"
 
 typedef enum {
@@ -19,19 +20,144 @@ typedef enum {
 
 const char * EventQueueType__toString(EventQueueType type);
 
+//Each pool has its own lanes and workers, so long blocking tasks can't hold up the workers of another pool
+#define EVENTQUEUE_MAX_POOLS 8
+#define EVENTQUEUE_DEFAULT_POOL 0
+//Threads (or main loops) receiving future completions
+#define EVENTQUEUE_MAX_SINKS 4
+//Extra workers a pool may start to make up for hung or cancelled events still blocking theirs
+#define EVENTQUEUE_MAX_COMPENSATION 4
+
+typedef enum {
+  EVENTQUEUE_TASK_RUNNING           = 0,
+  EVENTQUEUE_TASK_PENDING           = 1,
+  EVENTQUEUE_TASK_SCHEDULED         = 2,
+  EVENTQUEUE_TASK_HUNG              = 3  //Running past its deadline, flagged by the watchdog
+} EventQueueTaskState;
+
+//Applied to an insert once the queue, or the event's scope, holds its capacity of queued events (see EventQueue__set_capacity)
+typedef enum {
+  EVENTQUEUE_OVERFLOW_BLOCK         = 0, //Producer waits for room. Inserts from the queue's own workers are rejected instead.
+  EVENTQUEUE_OVERFLOW_REJECT        = 1, //New event is discarded
+  EVENTQUEUE_OVERFLOW_DROP_OLDEST   = 2, //Longest queued event is discarded to make room
+  EVENTQUEUE_OVERFLOW_DROP_NEWEST   = 3  //Most recently queued event is discarded to make room
+} EventQueueOverflowPolicy;
+
+#define EVENTQUEUE_OVERFLOW_POLICY_COUNT 4
+
+typedef enum {
+  EVENTQUEUE_INSERT_OK              = 0,
+  EVENTQUEUE_INSERT_DROPPED         = 1, //Queued, in place of an event discarded by the overflow policy
+  EVENTQUEUE_INSERT_REJECTED        = -1 //Discarded, its cleanup callback was invoked. The queue is full, shutting down, or the inserting event was cancelled.
+} EventQueueInsertResult;
+
+//Copy of a queued event. scope is only meant to identify the owner, it may be released once the snapshot returns.
+typedef struct {
+    void * scope;
+    QUEUE_CALLBACK callback;
+    const char * name;
+    EventQueueTaskState state;
+    EventQueuePriority priority;
+    int pool;
+    long long age_us; //Since started while running, since inserted otherwise
+} EventQueueTask;
+
+typedef struct {
+    long long time_us;
+    int thread_count;
+    int running_count;
+    int pending_count;
+    int scheduled_count;
+    int hung_count;
+    unsigned long long finished_count; //Events dispatched or cancelled while running, since creation
+    long long busy_us; //Cumulative time workers spent in callbacks, including the ones still running
+    unsigned long long overflow_count[EVENTQUEUE_OVERFLOW_POLICY_COUNT]; //Inserts exceeding a capacity, by policy applied
+    unsigned long long stolen_count; //Events taken from another worker's deque
+    int task_count; //Entries filled in the task array
+} EventQueueSnapshot;
+
+//Invoked by the watchdog under the queue lock, it must not call into the queue. task->age_us is the time spent running.
+typedef void (*EVENTQUEUE_HUNG_CALLBACK)(EventQueue * queue, const EventQueueTask * task, void * user_data);
+
 EventQueue* EventQueue__create(void (*queue_event_cb)(EventQueue * self, EventQueueType type,void * user_data),void * user_data); 
 
-void EventQueue__insert(EventQueue* queue, void * scope, void (*callback)(void * user_data), void * user_data);
+//Inserts return EVENTQUEUE_INSERT_REJECTED when the event was discarded (see EventQueueInsertResult)
+EventQueueInsertResult EventQueue__insert(EventQueue* queue, void * scope, void (*callback)(void * user_data), void * user_data);
+EventQueueInsertResult EventQueue__insert_with_priority(EventQueue* queue, EventQueuePriority priority, void * scope, void (*callback)(void * user_data), void * user_data);
+//Events sharing a scope run one at a time in insertion order. Different scopes still run in parallel.
+EventQueueInsertResult EventQueue__insert_strand(EventQueue* queue, EventQueuePriority priority, void * scope, void (*callback)(void * user_data), void * user_data);
+//Takes ownership of the event
+EventQueueInsertResult EventQueue__insert_event(EventQueue* queue, QueueEvent * evt);
+//Inserts a burst of events under a single lock, in array order, then wakes at most one idle worker per runnable event.
+//Takes ownership of every event. Returns the number of events queued, rejected ones are discarded as with EventQueue__insert_event.
+int EventQueue__insert_many(EventQueue* queue, QueueEvent ** evts, int count);
+//Replaces the older pending event with the same key (NULL key matches on scope and callback). cleanup is invoked with user_data if the event is discarded without being dispatched.
+EventQueueInsertResult EventQueue__insert_coalesced(EventQueue* queue, EventQueuePriority priority, void * scope, void * key, void (*callback)(void * user_data), void * user_data, void (*cleanup)(void * user_data));
+//Copies size bytes of data with the event, small payloads need no allocation. The copy is released along with the event.
+EventQueueInsertResult EventQueue__insert_copy(EventQueue* queue, EventQueuePriority priority, void * scope, void (*callback)(void * user_data), const void * data, size_t size, void (*cleanup)(void * user_data));
+//Runs the event once delay_ms elapsed, or every period_ms. Scheduled events are cancelled along with their scope.
+EventQueueInsertResult EventQueue__insert_delayed(EventQueue* queue, EventQueuePriority priority, void * scope, int delay_ms, void (*callback)(void * user_data), void * user_data);
+EventQueueInsertResult EventQueue__insert_periodic(EventQueue* queue, EventQueuePriority priority, void * scope, int period_ms, void (*callback)(void * user_data), void * user_data);
+//Takes ownership of the event. The cleanup callback of a periodic event is invoked once its series ends.
+EventQueueInsertResult EventQueue__schedule_event(EventQueue* queue, QueueEvent * evt, int delay_ms);
+//Bounds the events waiting in the queue, pending or scheduled, to capacity. 0 (default) leaves the queue unbounded.
+//Coalesced inserts replacing a queued event always fit
+void EventQueue__set_capacity(EventQueue* self, int capacity, EventQueueOverflowPolicy policy);
+//Same bound applied separately to the events waiting in each scope
+void EventQueue__set_scope_capacity(EventQueue* self, int capacity, EventQueueOverflowPolicy policy);
 QueueEvent * EventQueue__pop(EventQueue* self);
+//Blocks until an event is available or until the thread is cancelled. (Returns NULL on cancellation)
+QueueEvent * EventQueue__wait_pop(EventQueue* self, QueueThread * qt);
 void EventQueue__clear(EventQueue * self);
 void EventQueue__start(EventQueue* self);
 void EventQueue__stop(EventQueue* self, int nthread);
+//Stops intake, discards pending and scheduled events, flags running ones as cancelled and joins every worker.
+//Returns the number of workers still busy once timeout_ms elapsed. Those are logged along with their event.
+int EventQueue__shutdown(EventQueue * self, int timeout_ms);
+//Switches the pool to elastic mode. Starts workers up to min_threads and stops those above max_threads.
+//Workers are added while runnable events wait longer than the grow threshold, and idle workers above min_threads exit after the keep-alive.
+void EventQueue__set_elastic(EventQueue* self, int min_threads, int max_threads);
+//Applies to every pool
+void EventQueue__set_elastic_timing(EventQueue* self, int grow_threshold_ms, int keepalive_ms);
+//Adds an elastic pool of min_threads to max_threads workers. Returns the pool id, or -1 once EVENTQUEUE_MAX_POOLS is reached.
+//Events are routed with QueueEvent__set_pool. EventQueue__set_elastic and EventQueue__start only apply to the default pool.
+int EventQueue__add_pool(EventQueue* self, const char * name, int min_threads, int max_threads);
+void EventQueue__set_pool_elastic(EventQueue* self, int pool, int min_threads, int max_threads);
+int EventQueue__get_pool_count(EventQueue * self);
+//Events readied from a worker (its inserts, next strand event...) go to that worker's own deque. The worker serves it
+//along with the pool's lanes under the same priority and starvation rules, newest first unless the lane holds an older
+//event. Its own follow-ups may then run out of insertion order, strands keep theirs. Idle workers steal the oldest
+//event of the fullest deque. Other producers still use the lanes.
+void EventQueue__set_work_stealing(EventQueue* self, int enabled);
+//Execution budget of the pool's events without their own deadline. 0 (default) disables the watchdog check.
+void EventQueue__set_pool_deadline(EventQueue* self, int pool, int deadline_ms);
+//Starts a watchdog thread checking running events every interval_ms, 0 stops it. Overdue events are cancelled and
+//a temporary worker is added to their pool (at most EVENTQUEUE_MAX_COMPENSATION per pool), retired once they return.
+void EventQueue__set_watchdog(EventQueue* self, int interval_ms, EVENTQUEUE_HUNG_CALLBACK callback, void * user_data);
+const char * EventQueue__get_pool_name(EventQueue * self, int pool);
 int EventQueue__get_running_event_count(EventQueue * self);
 int EventQueue__get_pending_event_count(EventQueue * self);
+int EventQueue__get_scheduled_event_count(EventQueue * self);
+//Per-callback queue wait and run time histograms. Disabled by default, workers then skip the extra timestamp.
+void EventQueue__set_stats_enabled(EventQueue * self, int enabled);
+QueueStats * EventQueue__get_stats(EventQueue * self);
 int EventQueue__get_thread_count(EventQueue * self);
+//Samples the queue state in a single lock. Running events are listed first, then pending and scheduled ones, up to max_tasks.
+void EventQueue__snapshot(EventQueue * self, EventQueueSnapshot * snapshot, EventQueueTask * tasks, int max_tasks);
+//Registers a sink holding completed futures until EventQueue__complete runs them. Returns the sink id, or -1.
+//wakeup is invoked under the queue lock when the sink stops being empty. It must not call into the queue.
+int EventQueue__add_sink(EventQueue * self, void (*wakeup)(void * data), void * data);
+//Drops the pending completions. Futures completing afterwards are dropped as well.
+void EventQueue__remove_sink(EventQueue * self, int sink);
+//Runs up to max continuations of the sink on the calling thread. Returns the number of completions left.
+int EventQueue__complete(EventQueue * self, int sink, int max);
 void EventQueue__wait_condition(EventQueue * self, P_MUTEX_TYPE lock);
-void EventQueue_notify(EventQueue * self, EventQueueType type);
+//Returns 1 if the queue kept the current event (periodic events are scheduled again after dispatch)
+int EventQueue_notify(EventQueue * self, EventQueueType type);
 void EventQueue__remove_thread(EventQueue* self, QueueThread * qt);
+//Discards the scopes' pending events. Running ones are cancelled, aborting their blocking call if they registered one
+//(see QueueEvent__set_abort_callback). Otherwise a temporary worker takes their place until they return.
+//Events inserted by a cancelled event are rejected.
 void EventQueue__cancel_scopes(EventQueue * self, void ** scopes, int count);
 
 #endif
\ No newline at end of file
@@ -1,29 +1,242 @@
 #include "queue_event.h"
 #include "cobject.h"
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//Records are recycled instead of freed. Each thread keeps a small cache, refilled from and flushed to a shared free list in batches.
+#define QUEUEEVENT_CACHE_SIZE 32
+//Records beyond this count are freed instead of pooled
+#define QUEUEEVENT_POOL_MAX 4096
 
 struct _QueueEvent {
     CObject parent;
     int cancelled;
+    EventQueuePriority priority;
+    int strand;
+    int coalesce;
+    void * coalesce_key;
+    void (*cleanup)(void * user_data);
+    const char * name; //Optional task name, used by statistics
+    long long enqueued_us; //Monotonic time at which the event was inserted
+    long long ready_us; //Monotonic time at which the event became runnable
+    long long origin_us; //Ready time of the lane event its worker's deque descends from, see QueuePool__pop_worker
+    long long started_us; //Monotonic time at which a worker started dispatching it
+    long long due_us; //Monotonic time at which a scheduled event becomes runnable
+    int period_ms;
+    int timer_index; //Position in QueueTimerHeap
+    int pool; //EventQueue worker pool serving the event
+    int deadline_ms; //Execution budget checked by the EventQueue watchdog, 0 uses the pool default
+    int overdue; //Flagged by the watchdog once the budget is exceeded
+    int compensated; //A temporary worker was started in place of the one stuck dispatching this event
+    void (*abort)(void * data); //Interrupts the blocking call in progress, invoked by QueueEvent__cancel
+    void * abort_data;
+    int future; //callback is a QUEUE_TASK
+    int sink; //EventQueue sink receiving the completion, -1 if none
+    QUEUE_CONTINUATION done;
+    void (*free_result)(void * result);
+    void * result;
     P_MUTEX_TYPE cancel_lock;
     void * scope;
     void * user_data;
     void (*callback)();
+
+    //QueueEventList links
+    QueueEventList * list;
+    QueueEvent * prev;
+    QueueEvent * next;
+
+    //QueueScope index links
+    QueueEvent * scope_prev;
+    QueueEvent * scope_next;
+
+    int pooled; //Returned to the pool on destruction instead of being freed
+    void * heap_payload; //Copy of a payload too large for the inline area
+    union {
+        max_align_t align;
+        unsigned char data[QUEUEEVENT_INLINE_SIZE];
+    } payload;
 };
 
+typedef struct {
+    QueueEvent * head; //Linked through QueueEvent->next
+    int count;
+} QueueEventCache;
+
+static _Thread_local QueueEventCache thread_cache;
+//Shared free list. Only held for a few pointer updates, so a spin lock avoids any setup.
+static atomic_flag pool_lock = ATOMIC_FLAG_INIT;
+static QueueEventCache pool;
+static atomic_ullong pool_allocations;
+static atomic_ullong pool_recycled;
+
+static void priv_QueueEvent__pool_lock(){
+    while(atomic_flag_test_and_set_explicit(&pool_lock, memory_order_acquire)){
+        //Spin
+    }
+}
+
+static void priv_QueueEvent__pool_unlock(){
+    atomic_flag_clear_explicit(&pool_lock, memory_order_release);
+}
+
+//Moves the whole thread cache to the shared pool. Records above QUEUEEVENT_POOL_MAX are freed.
+static void priv_QueueEvent__flush_cache(){
+    QueueEvent * evt;
+    QueueEvent * overflow = NULL;
+
+    priv_QueueEvent__pool_lock();
+    while((evt = thread_cache.head)){
+        thread_cache.head = evt->next;
+        if(pool.count < QUEUEEVENT_POOL_MAX){
+            evt->next = pool.head;
+            pool.head = evt;
+            pool.count++;
+        } else {
+            evt->next = overflow;
+            overflow = evt;
+        }
+    }
+    thread_cache.count = 0;
+    priv_QueueEvent__pool_unlock();
+
+    while((evt = overflow)){
+        overflow = evt->next;
+        free(evt);
+    }
+}
+
+static QueueEvent * priv_QueueEvent__alloc(){
+    QueueEvent * evt;
+    if(!thread_cache.head){
+        //Refill a batch from the shared pool
+        priv_QueueEvent__pool_lock();
+        while(pool.head && thread_cache.count < QUEUEEVENT_CACHE_SIZE){
+            evt = pool.head;
+            pool.head = evt->next;
+            pool.count--;
+            evt->next = thread_cache.head;
+            thread_cache.head = evt;
+            thread_cache.count++;
+        }
+        priv_QueueEvent__pool_unlock();
+    }
+
+    evt = thread_cache.head;
+    if(evt){
+        thread_cache.head = evt->next;
+        thread_cache.count--;
+        atomic_fetch_add_explicit(&pool_recycled, 1, memory_order_relaxed);
+        return evt;
+    }
+
+    atomic_fetch_add_explicit(&pool_allocations, 1, memory_order_relaxed);
+    return malloc(sizeof(QueueEvent));
+}
+
+//The record is only pushed on the current thread's cache, so nothing can reuse it before CObject__destroy returns.
+//A full cache is flushed first, which only moves records already fully destroyed.
+static void priv_QueueEvent__release(QueueEvent * self){
+    if(thread_cache.count >= QUEUEEVENT_CACHE_SIZE){
+        priv_QueueEvent__flush_cache();
+    }
+    self->next = thread_cache.head;
+    thread_cache.head = self;
+    thread_cache.count++;
+}
+
 void priv_QueueEvent__destroy(CObject * cobject){
     QueueEvent * self = (QueueEvent *)cobject;
     P_MUTEX_CLEANUP(self->cancel_lock);
+    if(self->result && self->free_result){
+        self->free_result(self->result);
+    }
+    self->result = NULL;
+    free(self->heap_payload);
+    self->heap_payload = NULL;
+    if(self->pooled){
+        priv_QueueEvent__release(self);
+    }
 }
 
 
 QueueEvent * QueueEvent__create(void * scope, void (*callback)(void * user_data), void * user_data){
-    QueueEvent * self = malloc(sizeof(QueueEvent));
+    QueueEvent * self = priv_QueueEvent__alloc();
     QueueEvent__init(self, scope, callback, user_data);
-    CObject__set_allocated((CObject *)self);
+    //Pooled records aren't flagged as allocated, CObject__destroy leaves them to the destroy callback
+    self->pooled = 1;
+    return self;
+}
+
+QueueEvent * QueueEvent__create_copy(void * scope, void (*callback)(void * user_data), const void * data, size_t size){
+    QueueEvent * self = QueueEvent__create(scope, callback, NULL);
+    if(size <= QUEUEEVENT_INLINE_SIZE){
+        self->user_data = self->payload.data;
+    } else {
+        atomic_fetch_add_explicit(&pool_allocations, 1, memory_order_relaxed);
+        self->heap_payload = malloc(size);
+        self->user_data = self->heap_payload;
+    }
+    memcpy(self->user_data, data, size);
+    return self;
+}
+
+QueueEvent * QueueEvent__create_future(void * scope, QUEUE_TASK task, void * user_data){
+    //Only called back through its own type, see QueueEvent__dispatch
+    QueueEvent * self = QueueEvent__create(scope, (QUEUE_CALLBACK)(void (*)(void)) task, user_data);
+    self->future = 1;
     return self;
 }
 
+QueueEvent * QueueEvent__create_future_copy(void * scope, QUEUE_TASK task, const void * data, size_t size){
+    QueueEvent * self = QueueEvent__create_copy(scope, (QUEUE_CALLBACK)(void (*)(void)) task, data, size);
+    self->future = 1;
+    return self;
+}
+
+void QueueEvent__set_continuation(QueueEvent * self, int sink, QUEUE_CONTINUATION done, void (*free_result)(void * result)){
+    self->sink = sink;
+    self->done = done;
+    self->free_result = free_result;
+}
+
+int QueueEvent__is_future(QueueEvent * self){
+    return self->future;
+}
+
+int QueueEvent__get_sink(QueueEvent * self){
+    return self->done ? self->sink : -1;
+}
+
+void QueueEvent__dispatch(QueueEvent * self){
+    if(self->future){
+        self->result = ((QUEUE_TASK)(void (*)(void)) self->callback)(self->user_data);
+    } else {
+        self->callback(self->user_data);
+    }
+}
+
+void QueueEvent__complete(QueueEvent * self){
+    if(self->done){
+        self->done(self->result, self->user_data);
+    }
+}
+
+void QueueEvent__release_thread_cache(){
+    priv_QueueEvent__flush_cache();
+}
+
+void QueueEvent__get_pool_stats(unsigned long long * allocations, unsigned long long * recycled){
+    if(allocations){
+        *allocations = atomic_load_explicit(&pool_allocations, memory_order_relaxed);
+    }
+    if(recycled){
+        *recycled = atomic_load_explicit(&pool_recycled, memory_order_relaxed);
+    }
+}
+
 void QueueEvent__init(QueueEvent * self, void * scope, void (*callback)(void * user_data), void * user_data){
     CObject__init((CObject*)self);
     CObject__set_destroy_callback((CObject*)self,priv_QueueEvent__destroy);
@@ -31,15 +244,85 @@ void QueueEvent__init(QueueEvent * self, void * scope, void (*callback)(void * u
     self->callback = callback;
     self->scope = scope;
     self->cancelled = 0;
+    self->priority = EVENTQUEUE_PRIORITY_NORMAL;
+    self->strand = 0;
+    self->coalesce = 0;
+    self->coalesce_key = NULL;
+    self->cleanup = NULL;
+    self->name = NULL;
+    self->enqueued_us = 0;
+    self->ready_us = 0;
+    self->origin_us = 0;
+    self->started_us = 0;
+    self->due_us = 0;
+    self->period_ms = 0;
+    self->timer_index = -1;
+    self->pool = 0;
+    self->deadline_ms = 0;
+    self->overdue = 0;
+    self->compensated = 0;
+    self->abort = NULL;
+    self->abort_data = NULL;
+    self->future = 0;
+    self->sink = -1;
+    self->done = NULL;
+    self->free_result = NULL;
+    self->result = NULL;
+    self->list = NULL;
+    self->prev = NULL;
+    self->next = NULL;
+    self->scope_prev = NULL;
+    self->scope_next = NULL;
+    self->pooled = 0;
+    self->heap_payload = NULL;
     P_MUTEX_SETUP(self->cancel_lock);
 }
 
 void QueueEvent__cancel(QueueEvent * self){
     P_MUTEX_LOCK(self->cancel_lock);
+    if(!self->cancelled && self->abort){
+        self->abort(self->abort_data);
+    }
     self->cancelled = 1;
     P_MUTEX_UNLOCK(self->cancel_lock);
 }
 
+int QueueEvent__set_abort_callback(QueueEvent * self, void (*abort)(void * data), void * data){
+    int ret;
+    if(!self){
+        return 0;
+    }
+    P_MUTEX_LOCK(self->cancel_lock);
+    ret = self->cancelled;
+    if(ret){
+        //Cancelled before the call started, it is aborted right away
+        abort(data);
+    } else {
+        self->abort = abort;
+        self->abort_data = data;
+    }
+    P_MUTEX_UNLOCK(self->cancel_lock);
+    return ret;
+}
+
+void QueueEvent__clear_abort_callback(QueueEvent * self){
+    if(!self){
+        return;
+    }
+    P_MUTEX_LOCK(self->cancel_lock);
+    self->abort = NULL;
+    self->abort_data = NULL;
+    P_MUTEX_UNLOCK(self->cancel_lock);
+}
+
+int QueueEvent__has_abort_callback(QueueEvent * self){
+    int ret;
+    P_MUTEX_LOCK(self->cancel_lock);
+    ret = self->abort != NULL;
+    P_MUTEX_UNLOCK(self->cancel_lock);
+    return ret;
+}
+
 int QueueEvent__is_cancelled(QueueEvent * self){
     if(!self){
         return 0;
@@ -68,4 +351,241 @@ void * QueueEvent__get_userdata(QueueEvent * self){
 
 void * QueueEvent__get_scope(QueueEvent * self){
     return self->scope;
-}
\ No newline at end of file
+}
+
+void QueueEvent__set_priority(QueueEvent * self, EventQueuePriority priority){
+    self->priority = priority;
+}
+
+EventQueuePriority QueueEvent__get_priority(QueueEvent * self){
+    return self->priority;
+}
+
+void QueueEvent__set_strand(QueueEvent * self, int strand){
+    self->strand = strand;
+}
+
+int QueueEvent__is_strand(QueueEvent * self){
+    return self->strand;
+}
+
+void QueueEvent__set_coalesce(QueueEvent * self, void * key){
+    self->coalesce = 1;
+    self->coalesce_key = key;
+}
+
+int QueueEvent__coalesces_with(QueueEvent * self, QueueEvent * other){
+    if(!self->coalesce || !other->coalesce){
+        return 0;
+    }
+    if(self->coalesce_key || other->coalesce_key){
+        return self->coalesce_key == other->coalesce_key;
+    }
+    return self->scope == other->scope && self->callback == other->callback;
+}
+
+void * QueueEvent__get_coalesce_key(QueueEvent * self){
+    return self->coalesce_key;
+}
+
+void QueueEvent__set_cleanup_callback(QueueEvent * self, void (*cleanup)(void * user_data)){
+    self->cleanup = cleanup;
+}
+
+void QueueEvent__cleanup(QueueEvent * self){
+    if(self->cleanup){
+        self->cleanup(self->user_data);
+        self->cleanup = NULL;
+    }
+}
+
+long long QueueEvent__now_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void QueueEvent__set_name(QueueEvent * self, const char * name){
+    self->name = name;
+}
+
+const char * QueueEvent__get_name(QueueEvent * self){
+    return self->name;
+}
+
+void QueueEvent__set_enqueue_time(QueueEvent * self, long long enqueued_us){
+    self->enqueued_us = enqueued_us;
+}
+
+long long QueueEvent__get_enqueue_time(QueueEvent * self){
+    return self->enqueued_us;
+}
+
+void QueueEvent__set_start_time(QueueEvent * self, long long started_us){
+    self->started_us = started_us;
+}
+
+long long QueueEvent__get_start_time(QueueEvent * self){
+    return self->started_us;
+}
+
+void QueueEvent__set_ready_time(QueueEvent * self, long long ready_us){
+    self->ready_us = ready_us;
+}
+
+long long QueueEvent__get_ready_time(QueueEvent * self){
+    return self->ready_us;
+}
+
+void QueueEvent__set_origin_time(QueueEvent * self, long long origin_us){
+    self->origin_us = origin_us;
+}
+
+long long QueueEvent__get_origin_time(QueueEvent * self){
+    return self->origin_us;
+}
+
+void QueueEvent__set_due_time(QueueEvent * self, long long due_us){
+    self->due_us = due_us;
+}
+
+long long QueueEvent__get_due_time(QueueEvent * self){
+    return self->due_us;
+}
+
+void QueueEvent__set_period(QueueEvent * self, int period_ms){
+    self->period_ms = period_ms;
+}
+
+int QueueEvent__get_period(QueueEvent * self){
+    return self->period_ms;
+}
+
+void QueueEvent__set_timer_index(QueueEvent * self, int index){
+    self->timer_index = index;
+}
+
+int QueueEvent__get_timer_index(QueueEvent * self){
+    return self->timer_index;
+}
+
+void QueueEvent__set_pool(QueueEvent * self, int pool){
+    self->pool = pool;
+}
+
+int QueueEvent__get_pool(QueueEvent * self){
+    return self->pool;
+}
+
+void QueueEvent__set_deadline(QueueEvent * self, int deadline_ms){
+    self->deadline_ms = deadline_ms;
+}
+
+int QueueEvent__get_deadline(QueueEvent * self){
+    return self->deadline_ms;
+}
+
+void QueueEvent__set_overdue(QueueEvent * self){
+    self->overdue = 1;
+}
+
+int QueueEvent__is_overdue(QueueEvent * self){
+    return self->overdue;
+}
+
+void QueueEvent__set_compensated(QueueEvent * self){
+    self->compensated = 1;
+}
+
+int QueueEvent__is_compensated(QueueEvent * self){
+    return self->compensated;
+}
+
+QueueEventList * QueueEvent__get_list(QueueEvent * self){
+    return self->list;
+}
+
+QueueEvent * QueueEvent__get_next(QueueEvent * self){
+    if(!self){
+        return NULL;
+    }
+    return self->next;
+}
+
+void QueueEventList__init(QueueEventList * self){
+    self->head = NULL;
+    self->tail = NULL;
+    self->count = 0;
+}
+
+void QueueEvent__scope_link(QueueEvent ** head, QueueEvent * evt){
+    evt->scope_prev = NULL;
+    evt->scope_next = *head;
+    if(*head){
+        (*head)->scope_prev = evt;
+    }
+    *head = evt;
+}
+
+void QueueEvent__scope_unlink(QueueEvent ** head, QueueEvent * evt){
+    if(evt->scope_prev){
+        evt->scope_prev->scope_next = evt->scope_next;
+    } else if(*head == evt){
+        *head = evt->scope_next;
+    }
+    if(evt->scope_next){
+        evt->scope_next->scope_prev = evt->scope_prev;
+    }
+    evt->scope_prev = NULL;
+    evt->scope_next = NULL;
+}
+
+QueueEvent * QueueEvent__get_scope_next(QueueEvent * self){
+    return self->scope_next;
+}
+
+void QueueEventList__append(QueueEventList * self, QueueEvent * evt){
+    evt->list = self;
+    evt->next = NULL;
+    evt->prev = self->tail;
+    if(self->tail){
+        self->tail->next = evt;
+    } else {
+        self->head = evt;
+    }
+    self->tail = evt;
+    self->count++;
+}
+
+void QueueEventList__remove(QueueEventList * self, QueueEvent * evt){
+    if(evt->prev){
+        evt->prev->next = evt->next;
+    } else {
+        self->head = evt->next;
+    }
+    if(evt->next){
+        evt->next->prev = evt->prev;
+    } else {
+        self->tail = evt->prev;
+    }
+    evt->list = NULL;
+    evt->prev = NULL;
+    evt->next = NULL;
+    self->count--;
+}
+
+QueueEvent * QueueEventList__pop(QueueEventList * self){
+    QueueEvent * evt = self->head;
+    if(evt){
+        QueueEventList__remove(self,evt);
+    }
+    return evt;
+}
+
+QueueEvent * QueueEventList__get_first(QueueEventList * self){
+    return self->head;
+}
+
+int QueueEventList__get_count(QueueEventList * self){
+    return self->count;
+}
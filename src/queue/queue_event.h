@@ -1,18 +1,129 @@
 #ifndef QUEUE_EVENT_H_ 
 #define QUEUE_EVENT_H_
 
+#include <stddef.h>
+
 typedef struct _QueueEvent  QueueEvent;
 
-#include "queue_thread.h"
+//Workers always drain higher lanes first. Lower lanes are still served periodically to avoid starvation.
+typedef enum {
+  EVENTQUEUE_PRIORITY_INTERACTIVE   = 0, //User is actively waiting on the result (stream start, dialogs)
+  EVENTQUEUE_PRIORITY_NORMAL        = 1,
+  EVENTQUEUE_PRIORITY_BACKGROUND    = 2  //Bulk work (discovery, thumbnails)
+} EventQueuePriority;
+
+#define EVENTQUEUE_PRIORITY_COUNT 3
+
+//Payload bytes stored inside the event by QueueEvent__create_copy
+#define QUEUEEVENT_INLINE_SIZE 64
 
 typedef void (*QUEUE_CALLBACK)(void * user_data);
+//Future tasks return a result, later handed to their continuation on the thread draining the sink (see EventQueue__add_sink)
+typedef void * (*QUEUE_TASK)(void * user_data);
+typedef void (*QUEUE_CONTINUATION)(void * result, void * user_data);
+
+#include "queue_thread.h"
+
+//Intrusive list of QueueEvent. Events hold their own links so append, pop and unlink are O(1).
+//An event can only belong to one list at a time. The list isn't thread-safe, the owner must hold its own lock.
+typedef struct _QueueEventList {
+    QueueEvent * head;
+    QueueEvent * tail;
+    int count;
+} QueueEventList;
+
+void QueueEventList__init(QueueEventList * self);
+void QueueEventList__append(QueueEventList * self, QueueEvent * evt);
+void QueueEventList__remove(QueueEventList * self, QueueEvent * evt);
+QueueEvent * QueueEventList__pop(QueueEventList * self);
+QueueEvent * QueueEventList__get_first(QueueEventList * self);
+int QueueEventList__get_count(QueueEventList * self);
 
+//Records come from a pool with per-thread caches, so steady-state creation doesn't reach malloc
 QueueEvent * QueueEvent__create(void * scope, void (*callback)(void * user_data), void * user_data); 
+//Copies size bytes of data along with the event and passes the copy as user_data. The copy lives until the event is destroyed.
+//Payloads up to QUEUEEVENT_INLINE_SIZE are stored inside the record without any allocation.
+QueueEvent * QueueEvent__create_copy(void * scope, void (*callback)(void * user_data), const void * data, size_t size);
+//The task's result goes to the continuation set with QueueEvent__set_continuation, unless the event is cancelled.
+//Without a continuation the result is simply released. The cleanup callback is invoked if the continuation doesn't run.
+QueueEvent * QueueEvent__create_future(void * scope, QUEUE_TASK task, void * user_data);
+QueueEvent * QueueEvent__create_future_copy(void * scope, QUEUE_TASK task, const void * data, size_t size);
+//free_result releases the result once the continuation returned, or when the event is dropped
+void QueueEvent__set_continuation(QueueEvent * self, int sink, QUEUE_CONTINUATION done, void (*free_result)(void * result));
+int QueueEvent__is_future(QueueEvent * self);
+int QueueEvent__get_sink(QueueEvent * self);
+//Invokes the callback, or the task, storing its result
+void QueueEvent__dispatch(QueueEvent * self);
+//Invokes the continuation with the stored result
+void QueueEvent__complete(QueueEvent * self);
+//Returns the calling thread's cached records to the shared pool. Workers call it before they exit, other threads
+//creating or destroying events should too, otherwise their cached records are lost.
+void QueueEvent__release_thread_cache();
+//Number of records (and oversized payloads) obtained from malloc, and of records reused from the pool
+void QueueEvent__get_pool_stats(unsigned long long * allocations, unsigned long long * recycled);
 void QueueEvent__init(QueueEvent * self,void * scope, void (*callback)(void * user_data), void * user_data);
 QUEUE_CALLBACK QueueEvent__get_callback(QueueEvent * self);
 void * QueueEvent__get_userdata(QueueEvent * self);
 void * QueueEvent__get_scope(QueueEvent * evt);
+//Flags the event as cancelled and aborts the blocking call registered with QueueEvent__set_abort_callback, if any
 void QueueEvent__cancel(QueueEvent * self);
 int QueueEvent__is_cancelled(QueueEvent * self);
+//The running event is the task's cancellation token (see QueueEvent__get_current). Around a blocking call, a task can
+//register a callback interrupting it (e.g. shutting down its socket). The callback is invoked from the cancelling thread
+//under the event's lock, it must not block or call back into the event. Returns 1 if the event was already cancelled,
+//in which case the callback was invoked before returning.
+int QueueEvent__set_abort_callback(QueueEvent * self, void (*abort)(void * data), void * data);
+//Once cleared, the callback is guaranteed not to run anymore
+void QueueEvent__clear_abort_callback(QueueEvent * self);
+int QueueEvent__has_abort_callback(QueueEvent * self);
+void QueueEvent__set_priority(QueueEvent * self, EventQueuePriority priority);
+EventQueuePriority QueueEvent__get_priority(QueueEvent * self);
+void QueueEvent__set_strand(QueueEvent * self, int strand);
+int QueueEvent__is_strand(QueueEvent * self);
+//A newer pending event with the same key replaces this one. A NULL key matches on (scope, callback).
+void QueueEvent__set_coalesce(QueueEvent * self, void * key);
+void * QueueEvent__get_coalesce_key(QueueEvent * self);
+int QueueEvent__coalesces_with(QueueEvent * self, QueueEvent * other);
+//Invoked with user_data when the event is discarded without being dispatched
+void QueueEvent__set_cleanup_callback(QueueEvent * self, void (*cleanup)(void * user_data));
+void QueueEvent__cleanup(QueueEvent * self);
+QueueEventList * QueueEvent__get_list(QueueEvent * self);
+//Second set of links used by the per-scope index (see QueueScope). Independent of the QueueEventList links.
+void QueueEvent__scope_link(QueueEvent ** head, QueueEvent * evt);
+void QueueEvent__scope_unlink(QueueEvent ** head, QueueEvent * evt);
+QueueEvent * QueueEvent__get_scope_next(QueueEvent * self);
+//Monotonic clock in microseconds used for every QueueEvent timestamp
+long long QueueEvent__now_us();
+//Static string identifying the task in statistics. Events without a name are reported by callback address.
+void QueueEvent__set_name(QueueEvent * self, const char * name);
+const char * QueueEvent__get_name(QueueEvent * self);
+void QueueEvent__set_enqueue_time(QueueEvent * self, long long enqueued_us);
+long long QueueEvent__get_enqueue_time(QueueEvent * self);
+void QueueEvent__set_start_time(QueueEvent * self, long long started_us);
+long long QueueEvent__get_start_time(QueueEvent * self);
+void QueueEvent__set_ready_time(QueueEvent * self, long long ready_us);
+long long QueueEvent__get_ready_time(QueueEvent * self);
+//Work readied from a worker inherits the origin of the event that readied it, events readied elsewhere start their own
+void QueueEvent__set_origin_time(QueueEvent * self, long long origin_us);
+long long QueueEvent__get_origin_time(QueueEvent * self);
+void QueueEvent__set_due_time(QueueEvent * self, long long due_us);
+long long QueueEvent__get_due_time(QueueEvent * self);
+//Periodic events are scheduled again period_ms after each dispatch
+void QueueEvent__set_period(QueueEvent * self, int period_ms);
+int QueueEvent__get_period(QueueEvent * self);
+//Worker pool dispatching the event (see EventQueue__add_pool). Unknown pools fall back to the default one.
+void QueueEvent__set_pool(QueueEvent * self, int pool);
+int QueueEvent__get_pool(QueueEvent * self);
+//Running longer than deadline_ms gets the event cancelled by the watchdog (see EventQueue__set_watchdog)
+void QueueEvent__set_deadline(QueueEvent * self, int deadline_ms);
+int QueueEvent__get_deadline(QueueEvent * self);
+void QueueEvent__set_overdue(QueueEvent * self);
+int QueueEvent__is_overdue(QueueEvent * self);
+//A temporary worker took over the event's pool slot while it is stuck, retired once the event returns
+void QueueEvent__set_compensated(QueueEvent * self);
+int QueueEvent__is_compensated(QueueEvent * self);
+void QueueEvent__set_timer_index(QueueEvent * self, int index);
+int QueueEvent__get_timer_index(QueueEvent * self);
+QueueEvent * QueueEvent__get_next(QueueEvent * self);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "queue_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Number of times a non-empty lane can be passed over before it is served ahead of higher lanes
+#define EVENTQUEUE_STARVATION_LIMIT 8
+
+void QueueDeque__init(QueueDeque * self){
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        QueueEventList__init(&self->lanes[i]);
+    }
+    self->next = NULL;
+}
+
+void QueueDeque__push(QueueDeque * self, QueueEvent * evt){
+    QueueEventList__append(&self->lanes[QueueEvent__get_priority(evt)],evt);
+}
+
+int QueueDeque__get_count(QueueDeque * self){
+    int count = 0;
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        count += QueueEventList__get_count(&self->lanes[i]);
+    }
+    return count;
+}
+
+void QueuePool__init(QueuePool * self, const char * name, int grow_threshold_ms, int keepalive_ms){
+    memset(self, 0, sizeof(QueuePool));
+    self->name = strdup(name);
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        QueueEventList__init(&self->lanes[i]);
+    }
+    self->grow_threshold_ms = grow_threshold_ms;
+    self->keepalive_ms = keepalive_ms;
+    P_COND_SETUP(self->sleep_cond);
+}
+
+void QueuePool__clear(QueuePool * self){
+    free(self->name);
+    self->name = NULL;
+    P_COND_CLEANUP(self->sleep_cond);
+}
+
+void QueuePool__push(QueuePool * self, QueueEvent * evt){
+    QueueEventList__append(&self->lanes[QueueEvent__get_priority(evt)],evt);
+}
+
+//The worker's own deque takes part in the lane accounting, as if its events were queued in the pool's lanes
+static int priv_QueuePool__has_lane(QueuePool * self, QueueDeque * deque, EventQueuePriority lane){
+    return QueueEventList__get_count(&self->lanes[lane]) || (deque && QueueEventList__get_count(&deque->lanes[lane]));
+}
+
+//Returns the lane to serve next, -1 if the lanes and the deque are empty
+static int priv_QueuePool__select_lane(QueuePool * self, QueueDeque * deque){
+    int i;
+    int lane = -1;
+
+    for(i=EVENTQUEUE_PRIORITY_COUNT-1;i>0;i--){
+        if(self->skipped[i] >= EVENTQUEUE_STARVATION_LIMIT && priv_QueuePool__has_lane(self,deque,i)){
+            lane = i;
+            break;
+        }
+    }
+
+    if(lane < 0){
+        for(i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+            if(priv_QueuePool__has_lane(self,deque,i)){
+                lane = i;
+                break;
+            }
+        }
+    }
+
+    if(lane < 0){
+        return -1;
+    }
+
+    for(i=lane+1;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        if(priv_QueuePool__has_lane(self,deque,i)){
+            self->skipped[i]++;
+        }
+    }
+    self->skipped[lane] = 0;
+    return lane;
+}
+
+QueueEvent * QueuePool__pop(QueuePool * self){
+    int lane = priv_QueuePool__select_lane(self,NULL);
+    return lane < 0 ? NULL : QueueEventList__pop(&self->lanes[lane]);
+}
+
+void QueuePool__add_deque(QueuePool * self, QueueDeque * deque){
+    deque->next = self->deques;
+    self->deques = deque;
+}
+
+int QueuePool__remove_deque(QueuePool * self, QueueDeque * deque){
+    QueueEvent * evt;
+    int count = 0;
+    for(QueueDeque ** link = &self->deques; *link; link = &(*link)->next){
+        if(*link == deque){
+            *link = deque->next;
+            break;
+        }
+    }
+    deque->next = NULL;
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        while((evt = QueueEventList__pop(&deque->lanes[i]))){
+            QueuePool__push(self,evt);
+            count++;
+        }
+    }
+    return count;
+}
+
+QueueEvent * QueuePool__pop_worker(QueuePool * self, QueueDeque * deque){
+    QueueDeque * victim = NULL;
+    int victim_count = 0;
+    int lane = priv_QueuePool__select_lane(self,deque);
+
+    if(lane >= 0){
+        QueueEvent * local = deque ? QueueEventList__get_first(&deque->lanes[lane]) : NULL;
+        QueueEvent * shared = QueueEventList__get_first(&self->lanes[lane]);
+        //The lane goes first once it holds an event older than the work the deque continues, a worker refilling its
+        //deque can't hold it back. The owner then serves its newest event, still warm from the callback that readied it.
+        if(local && (!shared || QueueEvent__get_origin_time(local) <= QueueEvent__get_origin_time(shared))){
+            local = deque->lanes[lane].tail;
+            QueueEventList__remove(&deque->lanes[lane],local);
+            return local;
+        }
+        return QueueEventList__pop(&self->lanes[lane]);
+    }
+
+    for(QueueDeque * other = self->deques; other; other = other->next){
+        int count = other != deque ? QueueDeque__get_count(other) : 0;
+        if(count > victim_count){
+            victim = other;
+            victim_count = count;
+        }
+    }
+    if(!victim){
+        return NULL;
+    }
+    if(deque){
+        self->stolen_count++;
+    }
+    //Thieves take the oldest event of the most urgent lane
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        if(QueueEventList__get_count(&victim->lanes[i])){
+            return QueueEventList__pop(&victim->lanes[i]);
+        }
+    }
+    return NULL;
+}
+
+int QueuePool__owns(QueuePool * self, QueueEventList * list){
+    if(list >= &self->lanes[0] && list < &self->lanes[EVENTQUEUE_PRIORITY_COUNT]){
+        return 1;
+    }
+    for(QueueDeque * deque = self->deques; deque; deque = deque->next){
+        if(list >= &deque->lanes[0] && list < &deque->lanes[EVENTQUEUE_PRIORITY_COUNT]){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int QueuePool__get_count(QueuePool * self){
+    int count = 0;
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        count += QueueEventList__get_count(&self->lanes[i]);
+    }
+    for(QueueDeque * deque = self->deques; deque; deque = deque->next){
+        count += QueueDeque__get_count(deque);
+    }
+    return count;
+}
+
+long long QueuePool__get_oldest_ready_time(QueuePool * self){
+    long long oldest = -1;
+    QueueEvent * head;
+    for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+        head = QueueEventList__get_first(&self->lanes[i]);
+        if(head && (oldest < 0 || QueueEvent__get_ready_time(head) < oldest)){
+            oldest = QueueEvent__get_ready_time(head);
+        }
+    }
+    for(QueueDeque * deque = self->deques; deque; deque = deque->next){
+        for(int i=0;i<EVENTQUEUE_PRIORITY_COUNT;i++){
+            head = QueueEventList__get_first(&deque->lanes[i]);
+            if(head && (oldest < 0 || QueueEvent__get_ready_time(head) < oldest)){
+                oldest = QueueEvent__get_ready_time(head);
+            }
+        }
+    }
+    return oldest;
+}
@@ -0,0 +1,67 @@
+#ifndef QUEUE_POOL_H_ 
+#define QUEUE_POOL_H_
+
+typedef struct _QueuePool QueuePool;
+typedef struct _QueueDeque QueueDeque;
+
+#include "queue_event.h"
+#include "portable_thread.h"
+
+//Runnable events readied by one worker (see EventQueue__set_work_stealing), one list per priority like the pool's lanes.
+//Its owner serves the newest event first, idle workers of the pool steal the oldest. Guarded by the EventQueue lock.
+struct _QueueDeque {
+    QueueEventList lanes[EVENTQUEUE_PRIORITY_COUNT];
+    QueueDeque * next;
+};
+
+void QueueDeque__init(QueueDeque * self);
+void QueueDeque__push(QueueDeque * self, QueueEvent * evt);
+int QueueDeque__get_count(QueueDeque * self);
+
+//Runnable events served by a dedicated group of workers, so that blocking tasks of one pool can't starve another.
+//Not thread-safe, the owning EventQueue guards every pool with its own lock.
+struct _QueuePool {
+    char * name;
+    QueueEventList lanes[EVENTQUEUE_PRIORITY_COUNT];
+    int skipped[EVENTQUEUE_PRIORITY_COUNT];
+    QueueDeque * deques; //One per worker of the pool
+    unsigned long long stolen_count;
+
+    //Elastic sizing. Fixed size while max_threads is 0
+    int min_threads;
+    int max_threads;
+    int grow_threshold_ms;
+    int keepalive_ms;
+    int worker_count; //Workers not cancelled
+    int idle_count; //Workers waiting in EventQueue__wait_pop
+    int deferred_wakeups; //Runnable events pushed during a batch insert, not signaled yet
+
+    //Watchdog
+    int deadline_ms; //Default execution budget of the pool's events, 0 disables the check
+    int hung_count; //Running events past their budget
+    int compensated; //Extra workers started for hung events
+    int retire_count; //Extra workers to stop once their hung event returned
+
+    P_COND_TYPE sleep_cond;
+};
+
+void QueuePool__init(QueuePool * self, const char * name, int grow_threshold_ms, int keepalive_ms);
+void QueuePool__clear(QueuePool * self);
+void QueuePool__push(QueuePool * self, QueueEvent * evt);
+//Higher lanes are always drained first, unless a lower lane was passed over EVENTQUEUE_STARVATION_LIMIT times.
+QueueEvent * QueuePool__pop(QueuePool * self);
+void QueuePool__add_deque(QueuePool * self, QueueDeque * deque);
+//Moves the deque's events back to the lanes. Returns the number of events moved.
+int QueuePool__remove_deque(QueuePool * self, QueueDeque * deque);
+//Picks the lane as QueuePool__pop does, counting the worker's deque along with the pool's lanes. Within that lane, the
+//deque is served (newest first) unless the pool's lane holds an event older than the deque's origin (see
+//QueueEvent__get_origin_time). Only both heads are compared.
+//Then steals the oldest event of the fullest deque. A NULL deque pops the lanes, then steals.
+QueueEvent * QueuePool__pop_worker(QueuePool * self, QueueDeque * deque);
+//Returns 1 if the list is one of the pool's lanes or deques
+int QueuePool__owns(QueuePool * self, QueueEventList * list);
+int QueuePool__get_count(QueuePool * self);
+//Ready time of the longest waiting event, -1 if the pool is empty
+long long QueuePool__get_oldest_ready_time(QueuePool * self);
+
+#endif
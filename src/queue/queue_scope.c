@@ -0,0 +1,111 @@
+#include "queue_scope.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+#define QUEUE_SCOPE_TABLE_INITIAL_SIZE 64
+
+static unsigned int priv_QueueScopeTable__hash(QueueScopeTable * self, void * scope){
+    uintptr_t key = (uintptr_t) scope;
+    key ^= key >> 17;
+    key *= 0x9E3779B1u;
+    return (unsigned int)(key ^ (key >> 15)) & (self->size - 1);
+}
+
+static void priv_QueueScopeTable__grow(QueueScopeTable * self){
+    int old_size = self->size;
+    QueueScope ** old_buckets = self->buckets;
+
+    self->size = old_size * 2;
+    self->buckets = calloc(self->size, sizeof(QueueScope *));
+    for(int i=0;i<old_size;i++){
+        QueueScope * record = old_buckets[i];
+        while(record){
+            QueueScope * next = record->next;
+            unsigned int index = priv_QueueScopeTable__hash(self,record->scope);
+            record->next = self->buckets[index];
+            self->buckets[index] = record;
+            record = next;
+        }
+    }
+    free(old_buckets);
+}
+
+void QueueScopeTable__init(QueueScopeTable * self){
+    self->size = QUEUE_SCOPE_TABLE_INITIAL_SIZE;
+    self->count = 0;
+    self->buckets = calloc(self->size, sizeof(QueueScope *));
+}
+
+void QueueScopeTable__clear(QueueScopeTable * self){
+    for(int i=0;i<self->size;i++){
+        QueueScope * record = self->buckets[i];
+        while(record){
+            QueueScope * next = record->next;
+            free(record);
+            record = next;
+        }
+    }
+    free(self->buckets);
+    self->buckets = NULL;
+    self->size = 0;
+    self->count = 0;
+}
+
+QueueScope * QueueScopeTable__get(QueueScopeTable * self, void * scope){
+    QueueScope * record = self->buckets[priv_QueueScopeTable__hash(self,scope)];
+    while(record && record->scope != scope){
+        record = record->next;
+    }
+    return record;
+}
+
+QueueScope * QueueScopeTable__get_or_create(QueueScopeTable * self, void * scope){
+    QueueScope * record = QueueScopeTable__get(self,scope);
+    if(record){
+        return record;
+    }
+
+    if(self->count >= self->size){
+        priv_QueueScopeTable__grow(self);
+    }
+
+    record = calloc(1,sizeof(QueueScope));
+    record->scope = scope;
+    QueueEventList__init(&record->strand);
+
+    unsigned int index = priv_QueueScopeTable__hash(self,scope);
+    record->next = self->buckets[index];
+    self->buckets[index] = record;
+    self->count++;
+    return record;
+}
+
+int QueueScope__is_unused(QueueScope * self){
+    return !self->strand_active && !QueueEventList__get_count(&self->strand) && !self->event_count;
+}
+
+void QueueScope__add_event(QueueScope * self, QueueEvent * evt){
+    QueueEvent__scope_link(&self->events,evt);
+    self->event_count++;
+}
+
+void QueueScope__remove_event(QueueScope * self, QueueEvent * evt){
+    QueueEvent__scope_unlink(&self->events,evt);
+    self->event_count--;
+}
+
+void QueueScopeTable__release(QueueScopeTable * self, QueueScope * record){
+    if(!record || !QueueScope__is_unused(record)){
+        return;
+    }
+
+    QueueScope ** link = &self->buckets[priv_QueueScopeTable__hash(self,record->scope)];
+    while(*link && *link != record){
+        link = &(*link)->next;
+    }
+    if(*link){
+        *link = record->next;
+        self->count--;
+        free(record);
+    }
+}
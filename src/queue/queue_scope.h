@@ -0,0 +1,41 @@
+#ifndef QUEUE_SCOPE_H_ 
+#define QUEUE_SCOPE_H_
+
+typedef struct _QueueScope QueueScope;
+typedef struct _QueueScopeTable QueueScopeTable;
+
+#include "queue_event.h"
+
+//Per-scope bookkeeping of an EventQueue. Records are created on demand and released once unused.
+struct _QueueScope {
+    void * scope;
+    QueueScope * next; //Hash bucket chain
+
+    //Strand events waiting for the active strand event of this scope to finish
+    QueueEventList strand;
+    //Set while a strand event of this scope is pending in a lane or running
+    int strand_active;
+
+    //Index of every pending, parked, scheduled or running event of this scope
+    QueueEvent * events;
+    int event_count;
+};
+
+//Hash table of QueueScope keyed by scope pointer. Not thread-safe, the owner must hold its own lock.
+struct _QueueScopeTable {
+    QueueScope ** buckets;
+    int size;
+    int count;
+};
+
+void QueueScopeTable__init(QueueScopeTable * self);
+void QueueScopeTable__clear(QueueScopeTable * self);
+QueueScope * QueueScopeTable__get(QueueScopeTable * self, void * scope);
+QueueScope * QueueScopeTable__get_or_create(QueueScopeTable * self, void * scope);
+int QueueScope__is_unused(QueueScope * self);
+void QueueScope__add_event(QueueScope * self, QueueEvent * evt);
+void QueueScope__remove_event(QueueScope * self, QueueEvent * evt);
+//Release the record if nothing references it anymore
+void QueueScopeTable__release(QueueScopeTable * self, QueueScope * record);
+
+#endif
@@ -0,0 +1,306 @@
+#include "queue_stats.h"
+#include "portable_thread.h"
+#include "clogger.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Distinct callbacks tracked per worker block. Samples of additional callbacks are dropped.
+#define QUEUESTATS_MAX_CALLBACKS 32
+//Distinct callbacks reported after merging all blocks
+#define QUEUESTATS_MAX_SUMMARIES 64
+
+#define QUEUESTATS_SUB_COUNT (1 << QUEUE_HISTOGRAM_SUB_BITS)
+
+typedef struct {
+    _Atomic unsigned long long counts[QUEUE_HISTOGRAM_BUCKETS];
+    _Atomic unsigned long long max;
+} QueueHistogram;
+
+typedef struct {
+    _Atomic(QUEUE_CALLBACK) callback; //Published last, once name is set
+    _Atomic(const char *) name;
+    _Atomic unsigned long long count;
+    QueueHistogram wait;
+    QueueHistogram run;
+} QueueStatsEntry;
+
+typedef struct _QueueStatsBlock QueueStatsBlock;
+struct _QueueStatsBlock {
+    QueueStatsEntry entries[QUEUESTATS_MAX_CALLBACKS];
+    _Atomic unsigned long long dropped;
+    QueueStatsBlock * next; //Every block ever allocated
+    QueueStatsBlock * next_free;
+};
+
+struct _QueueStats {
+    atomic_int enabled;
+    //Only guards the block lists. Recording never takes it once a worker owns a block.
+    P_MUTEX_TYPE lock;
+    QueueStatsBlock * blocks;
+    QueueStatsBlock * free_blocks;
+};
+
+//Block owned by the current worker. A worker only ever records into a single QueueStats.
+static _Thread_local QueueStatsBlock * thread_block;
+
+//Only the owning worker writes, so a relaxed load/store is enough and readers never see torn values
+#define QUEUESTATS_INC(x,v) atomic_store_explicit(&(x), atomic_load_explicit(&(x), memory_order_relaxed) + (v), memory_order_relaxed)
+#define QUEUESTATS_GET(x) atomic_load_explicit(&(x), memory_order_relaxed)
+
+static int priv_QueueHistogram__index(unsigned long long value){
+    if(value < QUEUESTATS_SUB_COUNT){
+        return (int) value;
+    }
+    if(value >> 32){
+        return QUEUE_HISTOGRAM_BUCKETS - 1;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - QUEUE_HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << QUEUE_HISTOGRAM_SUB_BITS) + (int)((value >> shift) & (QUEUESTATS_SUB_COUNT - 1));
+}
+
+//Highest value falling in the bucket
+static unsigned long long priv_QueueHistogram__value(int index){
+    if(index < QUEUESTATS_SUB_COUNT){
+        return index;
+    }
+    int shift = (index >> QUEUE_HISTOGRAM_SUB_BITS) - 1;
+    unsigned long long lower = (unsigned long long)(QUEUESTATS_SUB_COUNT + (index & (QUEUESTATS_SUB_COUNT - 1))) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+static void priv_QueueHistogram__add(QueueHistogram * self, long long value){
+    if(value < 0){
+        value = 0;
+    }
+    QUEUESTATS_INC(self->counts[priv_QueueHistogram__index(value)],1);
+    if((unsigned long long) value > QUEUESTATS_GET(self->max)){
+        atomic_store_explicit(&self->max, value, memory_order_relaxed);
+    }
+}
+
+static QueueStatsEntry * priv_QueueStatsBlock__get_entry(QueueStatsBlock * self, QUEUE_CALLBACK callback, const char * name){
+    unsigned int index = (unsigned int)(((uintptr_t) callback >> 4) % QUEUESTATS_MAX_CALLBACKS);
+    for(int i=0;i<QUEUESTATS_MAX_CALLBACKS;i++){
+        QueueStatsEntry * entry = &self->entries[(index + i) % QUEUESTATS_MAX_CALLBACKS];
+        QUEUE_CALLBACK current = atomic_load_explicit(&entry->callback, memory_order_relaxed);
+        if(current == callback){
+            if(name && !QUEUESTATS_GET(entry->name)){
+                atomic_store_explicit(&entry->name, name, memory_order_relaxed);
+            }
+            return entry;
+        }
+        if(!current){
+            atomic_store_explicit(&entry->name, name, memory_order_relaxed);
+            atomic_store_explicit(&entry->callback, callback, memory_order_release);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static QueueStatsBlock * priv_QueueStats__acquire(QueueStats * self){
+    QueueStatsBlock * block;
+    P_MUTEX_LOCK(self->lock);
+    block = self->free_blocks;
+    if(block){
+        self->free_blocks = block->next_free;
+    } else {
+        block = calloc(1,sizeof(QueueStatsBlock));
+        block->next = self->blocks;
+        self->blocks = block;
+    }
+    P_MUTEX_UNLOCK(self->lock);
+    thread_block = block;
+    return block;
+}
+
+QueueStats * QueueStats__create(){
+    QueueStats * self = malloc(sizeof(QueueStats));
+    atomic_init(&self->enabled,0);
+    self->blocks = NULL;
+    self->free_blocks = NULL;
+    P_MUTEX_SETUP(self->lock);
+    return self;
+}
+
+void QueueStats__destroy(QueueStats * self){
+    if(!self){
+        return;
+    }
+    QueueStatsBlock * block = self->blocks;
+    while(block){
+        QueueStatsBlock * next = block->next;
+        free(block);
+        block = next;
+    }
+    P_MUTEX_CLEANUP(self->lock);
+    free(self);
+}
+
+void QueueStats__set_enabled(QueueStats * self, int enabled){
+    atomic_store(&self->enabled,enabled);
+}
+
+int QueueStats__is_enabled(QueueStats * self){
+    return atomic_load_explicit(&self->enabled, memory_order_relaxed);
+}
+
+void QueueStats__record(QueueStats * self, QueueEvent * evt, long long finished_us){
+    QueueStatsBlock * block = thread_block ? thread_block : priv_QueueStats__acquire(self);
+    QueueStatsEntry * entry = priv_QueueStatsBlock__get_entry(block,QueueEvent__get_callback(evt),QueueEvent__get_name(evt));
+    if(!entry){
+        QUEUESTATS_INC(block->dropped,1);
+        return;
+    }
+
+    long long started_us = QueueEvent__get_start_time(evt);
+    priv_QueueHistogram__add(&entry->wait, started_us - QueueEvent__get_ready_time(evt));
+    priv_QueueHistogram__add(&entry->run, finished_us - started_us);
+    QUEUESTATS_INC(entry->count,1);
+}
+
+void QueueStats__release_thread(QueueStats * self){
+    QueueStatsBlock * block = thread_block;
+    if(!block){
+        return;
+    }
+    thread_block = NULL;
+    P_MUTEX_LOCK(self->lock);
+    block->next_free = self->free_blocks;
+    self->free_blocks = block;
+    P_MUTEX_UNLOCK(self->lock);
+}
+
+typedef struct {
+    QUEUE_CALLBACK callback;
+    const char * name;
+    unsigned long long count;
+    unsigned long long wait[QUEUE_HISTOGRAM_BUCKETS];
+    unsigned long long wait_max;
+    unsigned long long run[QUEUE_HISTOGRAM_BUCKETS];
+    unsigned long long run_max;
+} QueueStatsMerge;
+
+static void priv_QueueStats__percentiles(unsigned long long * counts, unsigned long long max, unsigned long long total, unsigned long long * out){
+    static const double ranks[] = { 0.50, 0.90, 0.99 };
+    unsigned long long seen = 0;
+    int p = 0;
+    for(int i=0;i<QUEUE_HISTOGRAM_BUCKETS && p < QUEUESTATS_MAX;i++){
+        seen += counts[i];
+        while(p < QUEUESTATS_MAX && seen && seen >= ranks[p] * total){
+            out[p++] = priv_QueueHistogram__value(i) < max ? priv_QueueHistogram__value(i) : max;
+        }
+    }
+    while(p < QUEUESTATS_MAX){
+        out[p++] = max;
+    }
+    out[QUEUESTATS_MAX] = max;
+}
+
+int QueueStats__get_summary(QueueStats * self, QueueStatsSummary * summaries, int max){
+    int count = 0;
+    unsigned long long dropped = 0;
+    QueueStatsMerge * merged = calloc(QUEUESTATS_MAX_SUMMARIES,sizeof(QueueStatsMerge));
+
+    P_MUTEX_LOCK(self->lock);
+    for(QueueStatsBlock * block = self->blocks; block; block = block->next){
+        dropped += QUEUESTATS_GET(block->dropped);
+        for(int i=0;i<QUEUESTATS_MAX_CALLBACKS;i++){
+            QueueStatsEntry * entry = &block->entries[i];
+            QUEUE_CALLBACK callback = atomic_load_explicit(&entry->callback, memory_order_acquire);
+            if(!callback){
+                continue;
+            }
+
+            int m;
+            for(m=0;m<count && merged[m].callback != callback;m++);
+            if(m == count){
+                if(count == QUEUESTATS_MAX_SUMMARIES){
+                    continue;
+                }
+                merged[count++].callback = callback;
+            }
+
+            QueueStatsMerge * merge = &merged[m];
+            if(!merge->name){
+                merge->name = QUEUESTATS_GET(entry->name);
+            }
+            merge->count += QUEUESTATS_GET(entry->count);
+            for(int b=0;b<QUEUE_HISTOGRAM_BUCKETS;b++){
+                merge->wait[b] += QUEUESTATS_GET(entry->wait.counts[b]);
+                merge->run[b] += QUEUESTATS_GET(entry->run.counts[b]);
+            }
+            if(QUEUESTATS_GET(entry->wait.max) > merge->wait_max) merge->wait_max = QUEUESTATS_GET(entry->wait.max);
+            if(QUEUESTATS_GET(entry->run.max) > merge->run_max) merge->run_max = QUEUESTATS_GET(entry->run.max);
+        }
+    }
+    P_MUTEX_UNLOCK(self->lock);
+
+    if(dropped){
+        C_WARN("QueueStats dropped %llu samples. (Too many callbacks)",dropped);
+    }
+
+    for(int m=0;m<count && m<max;m++){
+        summaries[m].callback = merged[m].callback;
+        summaries[m].name = merged[m].name;
+        summaries[m].count = merged[m].count;
+        priv_QueueStats__percentiles(merged[m].wait, merged[m].wait_max, merged[m].count, summaries[m].wait_us);
+        priv_QueueStats__percentiles(merged[m].run, merged[m].run_max, merged[m].count, summaries[m].run_us);
+    }
+    free(merged);
+    return count;
+}
+
+char * QueueStats__to_json(QueueStats * self){
+    QueueStatsSummary summaries[QUEUESTATS_MAX_SUMMARIES];
+    int count = QueueStats__get_summary(self,summaries,QUEUESTATS_MAX_SUMMARIES);
+    if(count > QUEUESTATS_MAX_SUMMARIES){
+        count = QUEUESTATS_MAX_SUMMARIES;
+    }
+
+    size_t size = 3;
+    for(int i=0;i<count;i++){
+        size += 320 + (summaries[i].name ? strlen(summaries[i].name) : 0);
+    }
+
+    char * json = malloc(size);
+    size_t len = 0;
+    len += snprintf(json + len, size - len, "[");
+    for(int i=0;i<count;i++){
+        QueueStatsSummary * s = &summaries[i];
+        char name[32];
+        if(!s->name){
+            snprintf(name,sizeof(name),"0x%" PRIxPTR,(uintptr_t) s->callback);
+        }
+        len += snprintf(json + len, size - len,
+            "%s{\"name\":\"%s\",\"count\":%llu,"
+            "\"wait_us\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu},"
+            "\"run_us\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}}",
+            i ? "," : "", s->name ? s->name : name, s->count,
+            s->wait_us[QUEUESTATS_P50], s->wait_us[QUEUESTATS_P90], s->wait_us[QUEUESTATS_P99], s->wait_us[QUEUESTATS_MAX],
+            s->run_us[QUEUESTATS_P50], s->run_us[QUEUESTATS_P90], s->run_us[QUEUESTATS_P99], s->run_us[QUEUESTATS_MAX]);
+    }
+    snprintf(json + len, size - len, "]");
+    return json;
+}
+
+void QueueStats__log(QueueStats * self){
+    QueueStatsSummary summaries[QUEUESTATS_MAX_SUMMARIES];
+    int count = QueueStats__get_summary(self,summaries,QUEUESTATS_MAX_SUMMARIES);
+    if(count > QUEUESTATS_MAX_SUMMARIES){
+        count = QUEUESTATS_MAX_SUMMARIES;
+    }
+    C_INFO("EventQueue statistics (us) : %d callbacks",count);
+    for(int i=0;i<count;i++){
+        QueueStatsSummary * s = &summaries[i];
+        C_INFO("\t%-24s count %8llu wait p50 %8llu p99 %8llu max %8llu | run p50 %8llu p99 %8llu max %8llu",
+            s->name ? s->name : "(unnamed)", s->count,
+            s->wait_us[QUEUESTATS_P50], s->wait_us[QUEUESTATS_P99], s->wait_us[QUEUESTATS_MAX],
+            s->run_us[QUEUESTATS_P50], s->run_us[QUEUESTATS_P99], s->run_us[QUEUESTATS_MAX]);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef QUEUE_STATS_H_
+#define QUEUE_STATS_H_
+
+typedef struct _QueueStats QueueStats;
+
+#include "queue_event.h"
+
+//Log-linear histogram buckets in microseconds. Each power of two is split in 4, so values are within 25%.
+#define QUEUE_HISTOGRAM_SUB_BITS 2
+#define QUEUE_HISTOGRAM_BUCKETS ((32 - QUEUE_HISTOGRAM_SUB_BITS + 1) << QUEUE_HISTOGRAM_SUB_BITS)
+
+//Percentiles reported in QueueStatsSummary
+typedef enum {
+  QUEUESTATS_P50    = 0,
+  QUEUESTATS_P90    = 1,
+  QUEUESTATS_P99    = 2,
+  QUEUESTATS_MAX    = 3
+} QueueStatsPercentile;
+
+#define QUEUESTATS_PERCENTILE_COUNT 4
+
+//Aggregate of every worker for a single callback
+typedef struct {
+    QUEUE_CALLBACK callback;
+    const char * name;
+    unsigned long long count;
+    unsigned long long wait_us[QUEUESTATS_PERCENTILE_COUNT]; //Runnable until started
+    unsigned long long run_us[QUEUESTATS_PERCENTILE_COUNT]; //Started until finished
+} QueueStatsSummary;
+
+//Per-callback queue wait and run time histograms.
+//Each worker records in its own block without locking. Blocks are recycled when workers exit, so no sample is lost.
+QueueStats * QueueStats__create();
+void QueueStats__destroy(QueueStats * self);
+void QueueStats__set_enabled(QueueStats * self, int enabled);
+int QueueStats__is_enabled(QueueStats * self);
+//Called by the worker thread after dispatching the event
+void QueueStats__record(QueueStats * self, QueueEvent * evt, long long finished_us);
+//Returns the worker block to the pool. Called by the worker thread before it exits.
+void QueueStats__release_thread(QueueStats * self);
+//Fills up to max summaries, returns the number of callbacks recorded
+int QueueStats__get_summary(QueueStats * self, QueueStatsSummary * summaries, int max);
+//Returns a JSON array of summaries. The caller is responsible to free it.
+char * QueueStats__to_json(QueueStats * self);
+void QueueStats__log(QueueStats * self);
+
+#endif
@@ -1,5 +1,6 @@
 #include "queue_thread.h"
 #include "queue_event.h"
+#include "queue_pool.h"
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
@@ -11,14 +12,14 @@ struct _QueueThread {
     CObject parent;
     P_THREAD_TYPE pthread;
     EventQueue * queue;
-    P_MUTEX_TYPE sleep_lock;
+    int pool;
+    QueueDeque deque;
     P_MUTEX_TYPE cancel_lock;
     int cancelled;
 };
 
 void priv_QueueThread__destroy(CObject * cobject){
     QueueThread * self = (QueueThread *)cobject;
-    P_MUTEX_CLEANUP(self->sleep_lock);
     P_MUTEX_CLEANUP(self->cancel_lock);
 }
 
@@ -37,64 +38,61 @@ void * priv_QueueThread_call(void * data){
     C_DEBUG("Started...");
     queue_thread = (QueueThread*) data;
     while (1){
-        if(QueueThread__is_cancelled(queue_thread)){
-            goto exit;
-        }
-        if(EventQueue__get_pending_event_count(queue_thread->queue) <= 0){
-            P_MUTEX_LOCK(queue_thread->sleep_lock);
-            if(QueueThread__is_cancelled(queue_thread)){
-                P_MUTEX_UNLOCK(queue_thread->sleep_lock);
-                goto exit;
-            }
-            EventQueue__wait_condition(queue_thread->queue,queue_thread->sleep_lock);
-            P_MUTEX_UNLOCK(queue_thread->sleep_lock);
-        }
-        if(QueueThread__is_cancelled(queue_thread)){
+        event_queue = EventQueue__wait_pop(queue_thread->queue,queue_thread);
+        if(!event_queue){ //Only happens when the thread is cancelled
             goto exit;
         }
 
-        event_queue = EventQueue__pop(queue_thread->queue);
-        QUEUE_CALLBACK callback = QueueEvent__get_callback(event_queue);
-        if(!callback){ //Happens if pop happens simultaniously at 0. Continue to wait on condition call
-            continue;
-        }
+        QueueStats * stats = EventQueue__get_stats(queue_thread->queue);
 
         EventQueue_notify(queue_thread->queue,EVENTQUEUE_DISPATCHING);
-        (*(callback))(QueueEvent__get_userdata(event_queue));
+        QueueEvent__set_start_time(event_queue,QueueEvent__now_us());
+        QueueEvent__dispatch(event_queue);
+        //The task's abort data may not outlive its call
+        QueueEvent__clear_abort_callback(event_queue);
+        if(QueueStats__is_enabled(stats)){
+            QueueStats__record(stats,event_queue,QueueEvent__now_us());
+        }
+        int retained;
         if(QueueEvent__is_cancelled(event_queue)){
-            EventQueue_notify(queue_thread->queue,EVENTQUEUE_CANCELLED);
+            retained = EventQueue_notify(queue_thread->queue,EVENTQUEUE_CANCELLED);
         } else {
-            EventQueue_notify(queue_thread->queue,EVENTQUEUE_DISPATCHED);
+            retained = EventQueue_notify(queue_thread->queue,EVENTQUEUE_DISPATCHED);
+        }
+        if(!retained){
+            CObject__destroy((CObject*)event_queue);
         }
-        CObject__destroy((CObject*)event_queue);
     }
 
 exit:
+    QueueStats__release_thread(EventQueue__get_stats(queue_thread->queue));
+    QueueEvent__release_thread_cache();
     CObject__unref((CObject*)queue_thread);
     EventQueue__remove_thread(queue_thread->queue,queue_thread);
     C_INFO("Finished...");
     P_THREAD_EXIT;
 }
 
-void QueueThread__init(QueueThread * self, EventQueue* queue){
+void QueueThread__init(QueueThread * self, EventQueue* queue, int pool){
     memset (self, 0, sizeof (QueueThread));
 
     self->queue = queue;
+    self->pool = pool;
+    QueueDeque__init(&self->deque);
     CObject__init((CObject *)self);
     CObject__set_destroy_callback((CObject*)self,priv_QueueThread__destroy);
     //CObject starts with 1 reference count which is associated to the caller (CListTS will destroy child uppon destruction).
     //QueueThread needs another reference to allow finishing its run.
     CObject__addref((CObject*)self);
     
-    P_MUTEX_SETUP(self->sleep_lock);
     P_MUTEX_SETUP(self->cancel_lock);
     P_THREAD_CREATE(self->pthread, priv_QueueThread_call, self);
     P_THREAD_DETACH(self->pthread);
 }
 
-QueueThread * QueueThread__create(EventQueue* queue){
+QueueThread * QueueThread__create(EventQueue* queue, int pool){
     QueueThread * qt = malloc(sizeof(QueueThread));
-    QueueThread__init(qt,queue);
+    QueueThread__init(qt,queue,pool);
     CObject__set_allocated((CObject *) qt);
     return qt;
 }
@@ -115,4 +113,12 @@ int QueueThread__is_cancelled(QueueThread* self){
 
 EventQueue* QueueThread__get_queue(QueueThread* self){
     return self->queue;
-}
\ No newline at end of file
+}
+
+int QueueThread__get_pool(QueueThread* self){
+    return self->pool;
+}
+
+QueueDeque * QueueThread__get_deque(QueueThread* self){
+    return &self->deque;
+}
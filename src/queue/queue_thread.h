@@ -4,14 +4,19 @@
 #include <stdlib.h>
 
 typedef struct _QueueThread QueueThread;
+typedef struct _QueueDeque QueueDeque;
 #include "event_queue.h"
 #include "queue_event.h"
 
-QueueThread * QueueThread__create(EventQueue* queue); 
-void QueueThread__init(QueueThread * self, EventQueue* queue);
+//Workers only dispatch events of their pool
+QueueThread * QueueThread__create(EventQueue* queue, int pool); 
+void QueueThread__init(QueueThread * self, EventQueue* queue, int pool);
 void QueueThread__cancel(QueueThread* self);
 int QueueThread__is_cancelled(QueueThread* self);
 EventQueue* QueueThread__get_queue(QueueThread* self);
+int QueueThread__get_pool(QueueThread* self);
+//Events readied by the worker while work stealing is enabled (see EventQueue__set_work_stealing)
+QueueDeque * QueueThread__get_deque(QueueThread* self);
 
 //Thread-local function returning the current context pointers
 //Designed to be used within background events
@@ -0,0 +1,103 @@
+#include "queue_timer.h"
+#include <stdlib.h>
+
+#define QUEUE_TIMER_HEAP_INITIAL_SIZE 16
+
+static void priv_QueueTimerHeap__set(QueueTimerHeap * self, int index, QueueEvent * evt){
+    self->events[index] = evt;
+    QueueEvent__set_timer_index(evt,index);
+}
+
+static void priv_QueueTimerHeap__sift_up(QueueTimerHeap * self, int index){
+    QueueEvent * evt = self->events[index];
+    long long due = QueueEvent__get_due_time(evt);
+    while(index > 0){
+        int parent = (index - 1) / 2;
+        if(QueueEvent__get_due_time(self->events[parent]) <= due){
+            break;
+        }
+        priv_QueueTimerHeap__set(self,index,self->events[parent]);
+        index = parent;
+    }
+    priv_QueueTimerHeap__set(self,index,evt);
+}
+
+static void priv_QueueTimerHeap__sift_down(QueueTimerHeap * self, int index){
+    QueueEvent * evt = self->events[index];
+    long long due = QueueEvent__get_due_time(evt);
+    while(1){
+        int child = index * 2 + 1;
+        if(child >= self->count){
+            break;
+        }
+        if(child + 1 < self->count && QueueEvent__get_due_time(self->events[child + 1]) < QueueEvent__get_due_time(self->events[child])){
+            child++;
+        }
+        if(due <= QueueEvent__get_due_time(self->events[child])){
+            break;
+        }
+        priv_QueueTimerHeap__set(self,index,self->events[child]);
+        index = child;
+    }
+    priv_QueueTimerHeap__set(self,index,evt);
+}
+
+void QueueTimerHeap__init(QueueTimerHeap * self){
+    self->count = 0;
+    self->size = QUEUE_TIMER_HEAP_INITIAL_SIZE;
+    self->events = malloc(self->size * sizeof(QueueEvent *));
+}
+
+void QueueTimerHeap__clear(QueueTimerHeap * self){
+    free(self->events);
+    self->events = NULL;
+    self->count = 0;
+    self->size = 0;
+}
+
+void QueueTimerHeap__push(QueueTimerHeap * self, QueueEvent * evt){
+    if(self->count == self->size){
+        self->size *= 2;
+        self->events = realloc(self->events, self->size * sizeof(QueueEvent *));
+    }
+    self->events[self->count] = evt;
+    priv_QueueTimerHeap__sift_up(self,self->count++);
+}
+
+QueueEvent * QueueTimerHeap__peek(QueueTimerHeap * self){
+    return self->count ? self->events[0] : NULL;
+}
+
+QueueEvent * QueueTimerHeap__pop(QueueTimerHeap * self){
+    QueueEvent * evt = QueueTimerHeap__peek(self);
+    if(evt){
+        QueueTimerHeap__remove(self,evt);
+    }
+    return evt;
+}
+
+void QueueTimerHeap__remove(QueueTimerHeap * self, QueueEvent * evt){
+    int index = QueueEvent__get_timer_index(evt);
+    if(index < 0 || index >= self->count || self->events[index] != evt){
+        return;
+    }
+
+    QueueEvent__set_timer_index(evt,-1);
+    self->count--;
+    if(index == self->count){
+        return;
+    }
+
+    //Fill the hole with the last event and restore the heap order
+    QueueEvent * moved = self->events[self->count];
+    priv_QueueTimerHeap__set(self,index,moved);
+    if(index > 0 && QueueEvent__get_due_time(moved) < QueueEvent__get_due_time(self->events[(index - 1) / 2])){
+        priv_QueueTimerHeap__sift_up(self,index);
+    } else {
+        priv_QueueTimerHeap__sift_down(self,index);
+    }
+}
+
+int QueueTimerHeap__get_count(QueueTimerHeap * self){
+    return self->count;
+}
@@ -0,0 +1,24 @@
+#ifndef QUEUE_TIMER_H_ 
+#define QUEUE_TIMER_H_
+
+typedef struct _QueueTimerHeap QueueTimerHeap;
+
+#include "queue_event.h"
+
+//Binary min-heap of scheduled QueueEvent ordered by due time.
+//Events keep their heap index so they can be removed in O(log n). Not thread-safe, the owner must hold its own lock.
+struct _QueueTimerHeap {
+    QueueEvent ** events;
+    int count;
+    int size;
+};
+
+void QueueTimerHeap__init(QueueTimerHeap * self);
+void QueueTimerHeap__clear(QueueTimerHeap * self);
+void QueueTimerHeap__push(QueueTimerHeap * self, QueueEvent * evt);
+QueueEvent * QueueTimerHeap__peek(QueueTimerHeap * self);
+QueueEvent * QueueTimerHeap__pop(QueueTimerHeap * self);
+void QueueTimerHeap__remove(QueueTimerHeap * self, QueueEvent * evt);
+int QueueTimerHeap__get_count(QueueTimerHeap * self);
+
+#endif